@@ -12,23 +12,40 @@ BindingPopulation::BindingPopulation(FA_Global* pFA, GB_Global* pGB, VC_Global*
 
 void BindingPopulation::add_BindingMode(BindingMode& mode)
 {
-	for(std::vector<Pose>::iterator pose = mode.Poses.begin(); pose != mode.Poses.end(); ++pose)
+	this->PartitionFunction += mode.weightSum;
+	mode.set_energy();
+	
+	// cached energies are refreshed in O(1) per BindingMode since the PartitionFunction changed
+	// the new BindingMode is inserted at its sorted position unless the former order no longer holds
+	if(this->update_energies())
+	{
+		std::vector<BindingMode>::iterator it = std::upper_bound(this->BindingModes.begin(), this->BindingModes.end(), mode, BindingPopulation::EnergyComparator());
+		this->BindingModes.insert(it, mode);
+	}
+	else
 	{
-		this->PartitionFunction += pose->boltzmann_weight;
+		this->BindingModes.push_back(mode);
+		this->Entropize();
 	}
-    mode.set_energy();
-	this->BindingModes.push_back(mode);
-	this->Entropize();
 }
 
 
-void BindingPopulation::Entropize()
+bool BindingPopulation::update_energies()
 {
+	bool sorted = true;
 	for(std::vector<BindingMode>::iterator it = this->BindingModes.begin(); it != this->BindingModes.end(); ++it)
 	{
 		it->set_energy();
+		if(it != this->BindingModes.begin() && it->energy < (it-1)->energy) sorted = false;
 	}
-	std::sort(this->BindingModes.begin(), this->BindingModes.end(), BindingPopulation::EnergyComparator::EnergyComparator());
+	return sorted;
+}
+
+
+void BindingPopulation::Entropize()
+{
+	this->update_energies();
+	std::sort(this->BindingModes.begin(), this->BindingModes.end(), BindingPopulation::EnergyComparator());
 }
 
 
@@ -58,7 +75,7 @@ void BindingPopulation::output_Population(int nResults, char* end_strfile, char*
 \*****************************************/
 
 // public constructor *non-overloadable*
-BindingMode::BindingMode(BindingPopulation* pop) : Population(pop), energy(0.0)
+BindingMode::BindingMode(BindingPopulation* pop) : Population(pop), weightSum(0.0), enthalpySum(0.0), entropySum(0.0), energy(0.0)
 {
 }
 
@@ -67,31 +84,24 @@ BindingMode::BindingMode(BindingPopulation* pop) : Population(pop), energy(0.0)
 void BindingMode::add_Pose(Pose& pose)
 {
 	this->Poses.push_back(pose);
+	this->weightSum += pose.boltzmann_weight;
+	this->enthalpySum += pose.boltzmann_weight * pose.CF;
+	if(pose.boltzmann_weight > 0.0) this->entropySum += pose.boltzmann_weight * log(pose.boltzmann_weight);
 }
 
 
 double BindingMode::compute_enthalpy() const
 {
-	double enthalpy = 0.0;
-	// compute enthalpy
-	for(std::vector<Pose>::const_iterator pose = this->Poses.begin(); pose != this->Poses.end(); ++pose)
-	{
-		double boltzmann_prob = pose->boltzmann_weight / this->Population->PartitionFunction;
-		enthalpy += boltzmann_prob * pose->CF;
-	}
-	return enthalpy;
+	// sum(p * CF) with p = w / Z
+	return this->enthalpySum / this->Population->PartitionFunction;
 }
 
 
 double BindingMode::compute_entropy() const
 { 
-	double entropy = 0.0;
-	// compute entropy
-	for(std::vector<Pose>::const_iterator pose = this->Poses.begin(); pose != this->Poses.end(); ++pose)
-	{
-		double boltzmann_prob = pose->boltzmann_weight / this->Population->PartitionFunction;
-		entropy += boltzmann_prob * log(boltzmann_prob);
-	}
+	// sum(p * log(p)) with p = w / Z expands to (sum(w * log(w)) - sum(w) * log(Z)) / Z
+	double Z = this->Population->PartitionFunction;
+	double entropy = (this->entropySum - this->weightSum * log(Z)) / Z;
 	return -entropy; // returning a S value instead of ∆S value. Rendering it negative as in Shannon Entropy (no reference state)
 }
 
@@ -105,7 +115,12 @@ double BindingMode::compute_energy() const
 int BindingMode::get_BindingMode_size() const { return this->Poses.size(); }
 
 
-void BindingMode::clear_Poses() { this->Poses.clear(); }
+void BindingMode::clear_Poses()
+{
+	this->Poses.clear();
+	this->weightSum = this->enthalpySum = this->entropySum = 0.0;
+	this->energy = 0.0;
+}
 
 
 void BindingMode::set_energy()
@@ -306,14 +321,14 @@ std::vector<Pose>::const_iterator BindingMode::elect_Representative(bool useOPTI
 }
 
 
-inline bool const BindingMode::operator< (const BindingMode& rhs) { return (this->compute_energy() < rhs.compute_energy()); }
+inline bool const BindingMode::operator< (const BindingMode& rhs) { return (this->energy < rhs.energy); }
 
 
 /*****************************************\
 				  Pose
 \*****************************************/
 // public constructor for Pose *non-overloadable*
-Pose::Pose(chromosome* chrom, int index, int iorder, float dist, uint temperature, std::vector<float> vec) : chrom(chrom), order(iorder), chrom_index(index), reachDist(dist), CF(chrom->app_evalue), vPose(vec)
+Pose::Pose(chromosome* chrom, int index, int iorder, float dist, uint temperature, const PoseCoordinates* coor) : chrom_index(index), order(iorder), reachDist(dist), chrom(chrom), CF(chrom->app_evalue), coordinates(coor)
 {
 	this->boltzmann_weight = pow( E, ((-1.0) * (1/static_cast<double>(temperature)) * chrom->app_evalue) );
 }
@@ -9,6 +9,8 @@
 #define isUndefinedDist(a) ((a - UNDEFINED_DIST) <= FLT_EPSILON)
 
 class BindingPopulation; // forward-declaration in order to access BindingPopulation* Population pointer
+// vectorized chromosomes shared by Poses (FastOPTICS::points), indexed by Pose::chrom_index
+typedef std::vector< std::pair<chromosome*,std::vector<float> > > PoseCoordinates;
 /*****************************************\
 				  Pose
 \*****************************************/
@@ -17,7 +19,7 @@ struct Pose
 	// friend class BindingPopulation;
 	
 	// public constructor :
-	Pose(chromosome* chrom, int chrom_index, int order, float dist, uint temperature, std::vector<float>);
+	Pose(chromosome* chrom, int chrom_index, int order, float dist, uint temperature, const PoseCoordinates* coordinates);
 	~Pose();
 	// public (default behavior when struct is used instead of class)
 	int chrom_index;
@@ -26,7 +28,8 @@ struct Pose
 	chromosome* chrom;
 	double CF;
 	double boltzmann_weight;
-	std::vector<float> vPose;
+	const PoseCoordinates* coordinates;	// shared buffer (not owned)
+	const std::vector<float>& get_vPose() const { return (*this->coordinates)[this->chrom_index].second; }
 	inline bool const operator< (const Pose& rhs);
 };
 
@@ -72,6 +75,11 @@ class BindingMode // aggregation of poses (Cluster)
 		void	set_energy();
 
 	private:
+		// Boltzmann sums over Poses (updated by add_Pose) so that energy terms are O(1) for any PartitionFunction
+		double weightSum;		// sum of boltzmann_weight
+		double enthalpySum;		// sum of boltzmann_weight * CF
+		double entropySum;		// sum of boltzmann_weight * log(boltzmann_weight)
+
 		void 	output_BindingMode(int num_result, char* end_strfile, char* tmp_end_strfile, char* dockinp, char* gainp, int minPoints);
 		void	output_dynamic_BindingMode(int nBindingMode, char* end_strfile, char* tmp_end_strfile, char* dockinp, char* gainp, int minPoints);
 		double energy;
@@ -115,12 +123,13 @@ class BindingPopulation
 		std::vector< BindingMode > 	BindingModes;	// BindingMode container
 		
 		void 						Entropize(); 	// Sort BindinModes according to their observation frequency
+		bool						update_energies();	// refresh cached energies, returns false if BindingModes are no longer sorted
 		
 		struct EnergyComparator
 		{
-			inline bool operator() ( const BindingMode& BindingMode1, const BindingMode& BindingMode2 )
+			inline bool operator() ( const BindingMode& BindingMode1, const BindingMode& BindingMode2 ) const
 			{
-				return (BindingMode1.compute_energy() < BindingMode2.compute_energy());
+				return (BindingMode1.energy < BindingMode2.energy);
 			}
 		};
 };
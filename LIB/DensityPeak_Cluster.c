@@ -11,12 +11,17 @@
 #define EXCLUDE_HALO false
 #define OUTPUT_CLUSTER_CENTER false
 
+// vantage-point tree parameters : pruning tolerance on RMSD bounds (in Angstroms) and number of bisection steps for DC quantiles
+#define VPTREE_TOLERANCE 1e-5f
+#define VPTREE_MAX_BISECTION 64
+
 void DensityPeak_cluster(FA_Global* FA, GB_Global* GB, VC_Global* VC, chromosome* chrom, genlim* gene_lim, atom* atoms, resid* residue, gridpoint* cleftgrid, int num_chrom, char* end_strfile, char* tmp_end_strfile, char* dockinp, char* gainp)
 {
 	// Density Peak Clustering variables declaration
 	int i,j,k;
 	bool Hungarian = false;
-	int sizeChrom =  ((num_chrom * num_chrom)-num_chrom)*0.5; // sizeChrom is defined to be the size of the upper-triangular matrix without the main diagonale
+	long sizeChrom =  ((long)num_chrom * (long)(num_chrom-1))/2; // sizeChrom is defined to be the number of distinct pairs of chromosomes (upper-triangular matrix without the main diagonale)
+	long nSimilar = 0;
 	bool Entropic = ( FA->temperature > 0 ? true : false );
 	float DC = 0.0f;
 	const int nAtoms = residue[atoms[FA->map_par[0].atm].ofres].latm[0] - residue[atoms[FA->map_par[0].atm].ofres].fatm[0] + 1;
@@ -25,7 +30,9 @@ void DensityPeak_cluster(FA_Global* FA, GB_Global* GB, VC_Global* VC, chromosome
 	int nResults;
 	int nClusters = 0;
 	float maxDist, minDist;
-	float* RMSD;
+	int* DPindex;
+	int* slot;
+	DPvptree Tree;
 	double Pi;
 	double partition_function;
 	ClusterChrom* Chrom;
@@ -45,7 +52,9 @@ void DensityPeak_cluster(FA_Global* FA, GB_Global* GB, VC_Global* VC, chromosome
 
 	//  dynamically allocated memory check-up
 	Chrom = (ClusterChrom*) malloc(num_chrom * sizeof(ClusterChrom));
-	if(Chrom == NULL)
+	DPindex = (int*) malloc(num_chrom * sizeof(int));
+	slot = (int*) malloc(num_chrom * sizeof(int));
+	if(Chrom == NULL || DPindex == NULL || slot == NULL)
 	{
 		fprintf(stderr,"ERROR: memory allocation error for ChromClusters data structures.\n");
 		Terminate(2);
@@ -81,14 +90,6 @@ void DensityPeak_cluster(FA_Global* FA, GB_Global* GB, VC_Global* VC, chromosome
 		Terminate(2);
 	}
 
-	// RMSD matrix memory allocation && initialization with memset()
-	RMSD = (float*) malloc(sizeChrom * sizeof(float));
-	if(RMSD == NULL)
-	{
-		fprintf(stderr,"ERROR: memory allocation error for RMSD matrix.\n");
-		Terminate(2);
-	}
-	memset(RMSD, 0.0, sizeChrom);
 	// (1) Build Chromosome Cartesian Coordinates
 	for(i = 0; i < num_chrom; ++i)
 	{
@@ -97,7 +98,7 @@ void DensityPeak_cluster(FA_Global* FA, GB_Global* GB, VC_Global* VC, chromosome
         else calc_rmsd_chrom(FA,GB,chrom,gene_lim,atoms,residue,cleftgrid,GB->num_genes,i,i+1, pChrom->Coord, (pChrom++)->Coord, false);
 	}
 
-	// (2) Build RMSD Matrix
+	// (2) Compute CF values and index Chromosome coordinates in a vantage-point tree (replaces the num_chrom x num_chrom RMSD matrix)
 	for(i = 0, Pi = 0.0, iChrom=NULL; i < num_chrom; ++i)
 	{
 		iChrom = &Chrom[i];
@@ -107,57 +108,34 @@ void DensityPeak_cluster(FA_Global* FA, GB_Global* GB, VC_Global* VC, chromosome
 			iChrom->CF = (double) ( Pi * iChrom->Chromosome->app_evalue) + (FA->temperature * Pi * log(Pi));
 		}
 		else iChrom->CF = iChrom->Chromosome->app_evalue;
-		
-		for(j = i+1; j < num_chrom; ++j)
-		{
-			jChrom = &Chrom[j];
-			for(k = 0, minDist=0.0; k < nAtoms; ++k) minDist += sqrdist(&iChrom->Coord[3*k], &jChrom->Coord[3*k]);
-			RMSD[K(i,j,num_chrom)] = sqrtf(minDist/(float)nAtoms);
-		}
 	}
+	build_DensityPeak_vptree(&Tree, Chrom, num_chrom, nAtoms);
     
 	// (*) Determine Distance
-	DC = getDistanceCutoff(RMSD, sizeChrom);
+	DC = getDistanceCutoff(&Tree, sizeChrom);
 	// DC = FA->cluster_rmsd;
 	printf("DC:%g\n",DC);
 
-	// (3) Build Local Density Matrix
+	// (3) Build Local Density : range count of chromosomes within DC, Chi(x) summed over all j != i
 	for(i = 0; i < num_chrom; ++i)
 	{
 		iChrom = &Chrom[i];
-		for(j = i+1; j < num_chrom; ++j)
-		{
-			jChrom	= &Chrom[j];
-			if(jChrom != iChrom) iChrom->Density += Chi(RMSD[K(i,j,num_chrom)], DC);
-		}
+		iChrom->Density = vptree_range_count(&Tree, Tree.root, iChrom, DC) - 1;
+		nSimilar += vptree_range_count(&Tree, Tree.root, iChrom, 0.0001f) - 1;
 	}
+	nSimilar /= 2;
+	vptree_update_density(&Tree, Tree.root);
 
-	// (4) Fill out DP and Distance in Chrom
+	// (4) Fill out DP and Distance in Chrom (nearest chromosome of higher density)
 	for(i = 0; i < num_chrom; ++i)
 	{
 		iChrom = &Chrom[i];
-		for(j = i+1, minDist=FLT_MAX; j < num_chrom; ++j)
+		minDist = FLT_MAX; j = -1;
+		vptree_nearest_higher_density(&Tree, Tree.root, iChrom, &minDist, &j);
+		if(j >= 0)
 		{
-			if(j != i)
-			{
-				jChrom = &Chrom[j];
-				if(jChrom->Density > iChrom->Density && RMSD[K(i,j,num_chrom)] < minDist && RMSD[K(i,j,num_chrom)] > 0.0)
-				{
-					minDist = RMSD[K(i,j,num_chrom)];
-					iChrom->DP = jChrom;
-					iChrom->Distance = minDist;
-				}
-			}
-		}
-		for(j = num_chrom-1, minDist=FLT_MAX; j > i; --j)
-		{
-            jChrom = &Chrom[j];
-            if(jChrom->Density > iChrom->Density && RMSD[K(i,j,num_chrom)] < minDist && RMSD[K(i,j,num_chrom)] > 0.0)
-            {
-                minDist = RMSD[K(i,j,num_chrom)];
-                iChrom->DP = jChrom;
-                iChrom->Distance = minDist;
-            }
+			iChrom->DP = &Chrom[j];
+			iChrom->Distance = minDist;
 		}
 	}
 
@@ -186,13 +164,14 @@ void DensityPeak_cluster(FA_Global* FA, GB_Global* GB, VC_Global* VC, chromosome
 		}
 		for(i=0, iChrom=Chrom; i<num_chrom; ++iChrom, ++i)
 		{
-			if(iChrom == pChrom) continue; // skipping the highest density chrom (now pointed by pChrom) because it has been processed in lines 184-188
+			if(iChrom == pChrom) continue; // skipping the highest density chrom (now pointed by pChrom) because it has been processed above
 			if(iChrom->DP == NULL && iChrom->Density == maxDensity) 
 			{
-				if(RMSD[K(iChrom->index,pChrom->index,num_chrom)] <= DC)
+				minDist = DensityPeak_rmsd(iChrom, pChrom, nAtoms);
+				if(minDist <= DC)
 				{
 					iChrom->DP = pChrom;
-					iChrom->Distance = RMSD[K(iChrom->index,pChrom->index,num_chrom)];
+					iChrom->Distance = minDist;
 					iChrom->PiDi = iChrom->Density * iChrom->Distance;
 					--k;
 				}
@@ -214,25 +193,25 @@ void DensityPeak_cluster(FA_Global* FA, GB_Global* GB, VC_Global* VC, chromosome
 		if(pChrom->Density == maxDensity) pChrom->Distance = maxDist;
 		else 
 		{
-			minDist = FLT_MAX;
-			for(j=0, jChrom=NULL; j < num_chrom; ++j)
+			minDist = FLT_MAX; j = -1;
+			vptree_nearest_higher_density(&Tree, Tree.root, pChrom, &minDist, &j);
+			if(j >= 0)
 			{
-				jChrom = &Chrom[j];
-				if(jChrom != pChrom && jChrom->Density > pChrom->Density && RMSD[K(pChrom->index,jChrom->index,num_chrom)] <= minDist && RMSD[K(pChrom->index,jChrom->index,num_chrom)] > 0.0)
-				{
-					minDist = RMSD[K(pChrom->index,jChrom->index,num_chrom)];
-					pChrom->DP = jChrom;
-					pChrom->Distance = minDist;
-				}
+				pChrom->DP = &Chrom[j];
+				pChrom->Distance = minDist;
 			}
 		}
 		pChrom->PiDi = pChrom->Density * pChrom->Distance;
 		--k;
 	}
-	
+
+	// the tree indexes Chrom by position and is invalidated by the sorts below
+	free_DensityPeak_vptree(&Tree);
 
 	// (5.3) Sort Chrom by decreasing PiDi value
+	unlink_DensityPeaks(Chrom, num_chrom, DPindex);
 	QuickSort_ChromCluster_by_lower_Density(Chrom,num_chrom,0,num_chrom-1);
+	relink_DensityPeaks(Chrom, num_chrom, DPindex, slot);
 
 	// (6) Identify Cluster Centers
 	pChrom = NULL;
@@ -253,7 +232,7 @@ void DensityPeak_cluster(FA_Global* FA, GB_Global* GB, VC_Global* VC, chromosome
 				for(j = i+1; j < num_chrom; ++j)
 				{
 					jChrom = &Chrom[j];
-					if(RMSD[K(iChrom->index,jChrom->index,num_chrom)] <= DC && jChrom->Cluster > 0)
+					if(jChrom->Cluster > 0 && DensityPeak_rmsd(iChrom, jChrom, nAtoms) <= DC)
 					{
 						iChrom->Cluster = jChrom->Cluster;
 					}
@@ -269,7 +248,9 @@ void DensityPeak_cluster(FA_Global* FA, GB_Global* GB, VC_Global* VC, chromosome
 	// printf("nClusters:%d\n",nClusters);
 	
 	// (6.1) QuickSort by decreasing Density value
+	unlink_DensityPeaks(Chrom, num_chrom, DPindex);
 	QuickSort_ChromCluster_by_higher_Density(Chrom, num_chrom, 0, num_chrom-1);
+	relink_DensityPeaks(Chrom, num_chrom, DPindex, slot);
 
 	// (7) Clustering Step
 	for(i = 0, pChrom = NULL; i < num_chrom; ++i)
@@ -281,7 +262,9 @@ void DensityPeak_cluster(FA_Global* FA, GB_Global* GB, VC_Global* VC, chromosome
 	}
 
 	// Sorting ChromCluster elements by ASCENCING CF values
+	unlink_DensityPeaks(Chrom, num_chrom, DPindex);
 	QuickSort_ChromCluster_by_CF(Chrom, num_chrom, 0, num_chrom-1);
+	relink_DensityPeaks(Chrom, num_chrom, DPindex, slot);
 
 	// (8) Assignation of chromosome to its cluster Core/Halo 
 	// At this point, the cluster core vs cluster halo assignation is unuseful if there is a single cluster (unable to separe halore (noise) from core data points in dataset)
@@ -295,7 +278,7 @@ void DensityPeak_cluster(FA_Global* FA, GB_Global* GB, VC_Global* VC, chromosome
 			{
 				for(j=0, jChrom=Chrom; j<num_chrom; ++j, ++jChrom) if(jChrom->Cluster > 0 && jChrom->Cluster != k)
 				{
-					if( RMSD[K(iChrom->index, jChrom->index, num_chrom)] < ( (DC < FA->cluster_rmsd) ? DC : FA->cluster_rmsd) /*&& iChrom->Density > maxDensity*/)
+					if( DensityPeak_rmsd(iChrom, jChrom, nAtoms) < ( (DC < FA->cluster_rmsd) ? DC : FA->cluster_rmsd) /*&& iChrom->Density > maxDensity*/)
 					{
 						iChrom->isBorder = true;
 					}
@@ -436,8 +419,8 @@ void DensityPeak_cluster(FA_Global* FA, GB_Global* GB, VC_Global* VC, chromosome
 				{
 					jClust = &Clust[j];
                     if(!Clust[j].Representative || (OUTPUT_CLUSTER_CENTER && !Clust[j].Center) ) continue;
-					if(OUTPUT_CLUSTER_CENTER==true) fprintf(outfile_ptr,"rmsd(%d,%d)=%f\n",i+1,j+1,RMSD[K(iClust->Center->index, jClust->Center->index, num_chrom)]);
-					else fprintf(outfile_ptr,"rmsd(%d,%d)=%f\n",i+1,j+1,RMSD[K(iClust->Representative->index, jClust->Representative->index, num_chrom)]);
+					if(OUTPUT_CLUSTER_CENTER==true) fprintf(outfile_ptr,"rmsd(%d,%d)=%f\n",i+1,j+1,DensityPeak_rmsd(iClust->Center, jClust->Center, nAtoms));
+					else fprintf(outfile_ptr,"rmsd(%d,%d)=%f\n",i+1,j+1,DensityPeak_rmsd(iClust->Representative, jClust->Representative, nAtoms));
 				}
 			} 
 		}
@@ -529,72 +512,245 @@ void DensityPeak_cluster(FA_Global* FA, GB_Global* GB, VC_Global* VC, chromosome
 		write_pdb(FA,atoms,residue,tmp_end_strfile,remark);
 	}
     
-    for(i = 0, k = 0; i < num_chrom; ++i)
-        for(j = i+1; j < num_chrom; ++j)
-            if(RMSD[K(i,j,num_chrom)] == 0.0 || !RMSD[K(i,j,num_chrom)] || RMSD[K(i,j,num_chrom)] < 0.0001) k++;
-
-    printf("there is %d pairwise-chromosomes with similar (x < 0.0001) RMSD values.\n", k);
+    printf("there is %ld pairwise-chromosomes with similar (x < 0.0001) RMSD values.\n", nSimilar);
     
 	// Need to modify write_rrd.c OR  
-	if(FA->refstructure == 1) { write_DensityPeak_rrd(FA,GB,chrom,gene_lim,atoms,residue,cleftgrid,Chrom,Clust,RMSD,end_strfile); }
+	if(FA->refstructure == 1) { write_DensityPeak_rrd(FA,GB,chrom,gene_lim,atoms,residue,cleftgrid,Chrom,Clust,num_chrom,nAtoms,end_strfile); }
 
 	
 	// (*) Memory deallocation
 	if(Chrom != NULL) { free(Chrom); Chrom=NULL; }
-	if(RMSD  != NULL) { free(RMSD);  RMSD=NULL;  }
+	if(DPindex != NULL) { free(DPindex); DPindex=NULL; }
+	if(slot != NULL) { free(slot); slot=NULL; }
     if(Clust != NULL) { free(Clust); Clust=NULL; }
 }
 
-float getDistanceCutoff(float* RMSD, int sizeChrom)
+float getDistanceCutoff(DPvptree* Tree, long sizeChrom)
 {
-//	int i,j,k;
 	float DC = 0.0f;
-//	int neighbors = 0;
-	float* RMSDsorted;
-	int nLow = NEIGHBORRATELOW * sizeChrom;
-	int nHigh = NEIGHBORRATEHIGH * sizeChrom;
-	RMSDsorted = (float*) malloc( sizeChrom * sizeof(float) );
-	
-	if(RMSDsorted == NULL)
-	{
-		fprintf(stderr,"ERROR: memory allocation error for RMSD matrix copy in DensityPeak_Cluster::getDistanceCutoff().\n");
-		Terminate(2);
-	}
-//    for(i = 0, k = 0; i< num_chrom; ++i)
-//    {
-//        for(j = i+1; j < num_chrom; ++j)
-//        {
-//            RMSDsorted[k] = RMSD[K(i,j,num_chrom)];
-//            ++k;
-//        }
-//    }
-	memcpy(RMSDsorted, RMSD, sizeChrom * sizeof(float));
-	qsort(RMSDsorted, sizeChrom, sizeof(float), DistanceComparator);
-	DC = (RMSDsorted[nLow] + RMSDsorted[nHigh]) * 0.5;
-	// while(neighbors < nLow || neighbors > nHigh)
-	// {
-	// 	neighbors = 0;
-	// 	for(i=0; i<num_chrom-1; ++i)
-	// 	{
-	// 		for(j=0; j<num_chrom; ++j)
-	// 		{
-	// 			if(i==j) continue;
-	// 			if(RMSD[K(i,j,num_chrom)] <= DC) ++neighbors;
-	// 			if(neighbors > nHigh) goto DCPLUS;
-	// 		}
-	// 	}
-	// 	DCPLUS: DC += 0.05;
-	// }
-    while( DC < 1.0 && nHigh < sizeChrom )
+	long nLow = NEIGHBORRATELOW * sizeChrom;
+	long nHigh = NEIGHBORRATEHIGH * sizeChrom;
+
+	if(sizeChrom < 1) return DC;
+
+	// quantiles of the pairwise RMSD distribution are searched with range counts instead of sorting every pairwise RMSD
+	DC = (vptree_pair_quantile(Tree, nLow) + vptree_pair_quantile(Tree, nHigh)) * 0.5;
+    while( DC < 1.0 && nHigh < sizeChrom-1 )
     {
         nLow = 1.5 * nLow;
-        nHigh = 1.5 * nHigh;
-        DC = (RMSDsorted[nLow] + RMSDsorted[nHigh]) * 0.5;
+        nHigh = ( (long)(1.5 * nHigh) > nHigh ) ? (long)(1.5 * nHigh) : nHigh+1;
+        if(nHigh > sizeChrom-1) nHigh = sizeChrom-1;
+        DC = (vptree_pair_quantile(Tree, nLow) + vptree_pair_quantile(Tree, nHigh)) * 0.5;
     }
-    if(RMSDsorted) { free(RMSDsorted); RMSDsorted = NULL; }
 	return DC;
 }
 
+/******************************************************************************
+ * Vantage-point tree over ClusterChrom coordinates
+ * Each node splits its subtree at the median distance (mu) to its vantage point
+ * and keeps the subtree radius, size and highest Density, so that range counts
+ * (local Density) and nearest higher density searches (DP) can skip whole
+ * subtrees using the triangle inequality of the RMSD metric.
+ ******************************************************************************/
+float DensityPeak_rmsd(const ClusterChrom* ChromX, const ClusterChrom* ChromY, int nAtoms)
+{
+	int k;
+	float diff;
+	float dist = 0.0f;
+	for(k = 0; k < 3*nAtoms; ++k)
+	{
+		diff = ChromX->Coord[k] - ChromY->Coord[k];
+		dist += diff*diff;
+	}
+	return sqrtf(dist/(float)nAtoms);
+}
+
+void build_DensityPeak_vptree(DPvptree* Tree, ClusterChrom* Chrom, int num_chrom, int nAtoms)
+{
+	int i;
+	int* idx;
+	pair<float,int>* work;
+
+	Tree->Chrom = Chrom;
+	Tree->nAtoms = nAtoms;
+	Tree->nNodes = 0;
+	Tree->root = -1;
+	Tree->nodes = (DPvpnode*) malloc(num_chrom * sizeof(DPvpnode));
+	idx = (int*) malloc(num_chrom * sizeof(int));
+	work = (pair<float,int>*) malloc(num_chrom * sizeof(pair<float,int>));
+	if(Tree->nodes == NULL || idx == NULL || work == NULL)
+	{
+		fprintf(stderr,"ERROR: memory allocation error for vantage-point tree in DensityPeak_Cluster.\n");
+		Terminate(2);
+	}
+
+	for(i = 0; i < num_chrom; ++i) idx[i] = i;
+	Tree->root = vptree_build_node(Tree, idx, work, 0, num_chrom);
+
+	free(idx);
+	free(work);
+}
+
+void free_DensityPeak_vptree(DPvptree* Tree)
+{
+	if(Tree->nodes != NULL) { free(Tree->nodes); Tree->nodes = NULL; }
+	Tree->nNodes = 0;
+	Tree->root = -1;
+}
+
+int vptree_build_node(DPvptree* Tree, int* idx, pair<float,int>* work, int beg, int end)
+{
+	int i, mid, node;
+	DPvpnode* pNode;
+
+	if(beg >= end) return -1;
+
+	node = Tree->nNodes++;
+	pNode = &Tree->nodes[node];
+	pNode->vantage = idx[beg];
+	pNode->size = end - beg;
+	pNode->maxDensity = 0;
+	pNode->mu = 0.0f;
+	pNode->radius = 0.0f;
+	pNode->inner = -1;
+	pNode->outer = -1;
+
+	if(end - beg > 1)
+	{
+		for(i = beg+1; i < end; ++i)
+		{
+			work[i].first = DensityPeak_rmsd(&Tree->Chrom[pNode->vantage], &Tree->Chrom[idx[i]], Tree->nAtoms);
+			work[i].second = idx[i];
+			if(work[i].first > pNode->radius) pNode->radius = work[i].first;
+		}
+		// points closer than the median distance (mu) go to the inner subtree, the others to the outer subtree
+		mid = beg + 1 + (end - beg - 1)/2;
+		nth_element(work+beg+1, work+mid, work+end);
+		pNode->mu = work[mid].first;
+		for(i = beg+1; i < end; ++i) idx[i] = work[i].second;
+
+		// pNode is not used after recursion since Tree->nodes is indexed
+		i = vptree_build_node(Tree, idx, work, beg+1, mid);
+		Tree->nodes[node].inner = i;
+		i = vptree_build_node(Tree, idx, work, mid, end);
+		Tree->nodes[node].outer = i;
+	}
+	return node;
+}
+
+int vptree_update_density(DPvptree* Tree, int node)
+{
+	int inner, outer;
+	DPvpnode* pNode;
+
+	if(node < 0) return -1;
+
+	pNode = &Tree->nodes[node];
+	pNode->maxDensity = Tree->Chrom[pNode->vantage].Density;
+	inner = vptree_update_density(Tree, pNode->inner);
+	outer = vptree_update_density(Tree, pNode->outer);
+	if(inner > pNode->maxDensity) pNode->maxDensity = inner;
+	if(outer > pNode->maxDensity) pNode->maxDensity = outer;
+	return pNode->maxDensity;
+}
+
+// number of indexed chromosomes strictly closer than radius to Query (Query included if indexed)
+int vptree_range_count(const DPvptree* Tree, int node, const ClusterChrom* Query, float radius)
+{
+	int count;
+	float d;
+	const DPvpnode* pNode;
+
+	if(node < 0) return 0;
+
+	pNode = &Tree->nodes[node];
+	d = DensityPeak_rmsd(Query, &Tree->Chrom[pNode->vantage], Tree->nAtoms);
+
+	if(d + pNode->radius < radius - VPTREE_TOLERANCE) return pNode->size;
+	if(d - pNode->radius >= radius + VPTREE_TOLERANCE) return 0;
+
+	count = (d < radius) ? 1 : 0;
+	if(d - pNode->mu < radius + VPTREE_TOLERANCE) count += vptree_range_count(Tree, pNode->inner, Query, radius);
+	if(pNode->mu - d < radius + VPTREE_TOLERANCE) count += vptree_range_count(Tree, pNode->outer, Query, radius);
+	return count;
+}
+
+// nearest chromosome of higher Density than Query at non-null distance (ties resolved by lowest position)
+void vptree_nearest_higher_density(const DPvptree* Tree, int node, const ClusterChrom* Query, float* minDist, int* nearest)
+{
+	float d;
+	const DPvpnode* pNode;
+	const ClusterChrom* vChrom;
+
+	if(node < 0) return;
+
+	pNode = &Tree->nodes[node];
+	if(pNode->maxDensity <= Query->Density) return;
+
+	vChrom = &Tree->Chrom[pNode->vantage];
+	d = DensityPeak_rmsd(Query, vChrom, Tree->nAtoms);
+	if(d - pNode->radius > *minDist + VPTREE_TOLERANCE) return;
+
+	if(vChrom->Density > Query->Density && d > 0.0f && (d < *minDist || (d == *minDist && pNode->vantage < *nearest)))
+	{
+		*minDist = d;
+		*nearest = pNode->vantage;
+	}
+
+	// visit the side of mu holding Query first to tighten minDist early
+	if(d < pNode->mu)
+	{
+		vptree_nearest_higher_density(Tree, pNode->inner, Query, minDist, nearest);
+		if(pNode->mu - d <= *minDist + VPTREE_TOLERANCE) vptree_nearest_higher_density(Tree, pNode->outer, Query, minDist, nearest);
+	}
+	else
+	{
+		vptree_nearest_higher_density(Tree, pNode->outer, Query, minDist, nearest);
+		if(d - pNode->mu <= *minDist + VPTREE_TOLERANCE) vptree_nearest_higher_density(Tree, pNode->inner, Query, minDist, nearest);
+	}
+}
+
+// number of distinct pairs of indexed chromosomes strictly closer than radius
+long vptree_pair_count(const DPvptree* Tree, float radius)
+{
+	int i;
+	long count = 0;
+	for(i = 0; i < Tree->nNodes; ++i) count += vptree_range_count(Tree, Tree->root, &Tree->Chrom[i], radius) - 1;
+	return count/2;
+}
+
+// n-th smallest (0-based) pairwise distance, found by bisection on the pair count
+float vptree_pair_quantile(const DPvptree* Tree, long n)
+{
+	int it;
+	float lo = 0.0f, hi, mid;
+
+	if(Tree->root < 0) return lo;
+
+	hi = 2.0f * Tree->nodes[Tree->root].radius + 1.0f;
+	for(it = 0; it < VPTREE_MAX_BISECTION && (hi - lo) > VPTREE_TOLERANCE * hi; ++it)
+	{
+		mid = lo + 0.5f * (hi - lo);
+		if(vptree_pair_count(Tree, mid) <= n) lo = mid;
+		else hi = mid;
+	}
+	return lo;
+}
+
+// DP pointers address positions in Chrom : they are saved as original indices before sorting Chrom and restored afterwards
+void unlink_DensityPeaks(ClusterChrom* Chrom, int num_chrom, int* DPindex)
+{
+	int i;
+	for(i = 0; i < num_chrom; ++i) DPindex[Chrom[i].index] = (Chrom[i].DP != NULL) ? (int)Chrom[i].DP->index : -1;
+}
+
+void relink_DensityPeaks(ClusterChrom* Chrom, int num_chrom, const int* DPindex, int* slot)
+{
+	int i;
+	for(i = 0; i < num_chrom; ++i) slot[Chrom[i].index] = i;
+	for(i = 0; i < num_chrom; ++i) Chrom[i].DP = (DPindex[Chrom[i].index] >= 0) ? &Chrom[slot[DPindex[Chrom[i].index]]] : NULL;
+}
+
 void QuickSort_Cluster_by_CF(DPcluster* Clust, bool Entropic, int beg, int end)
 {
 	int l, r, p;
@@ -667,11 +823,11 @@ void QuickSort_ChromCluster_by_CF(ClusterChrom* Chrom, int num_chrom, int beg, i
 			
 			if (l > r) break;
 
-			swap_elements(Chrom, &Chrom[l],&Chrom[r], num_chrom);
+			swap_elements(&Chrom[l],&Chrom[r]);
 			if (p == r) p=l;
 			++l;--r;
 		}
-		swap_elements(Chrom, &Chrom[p], &Chrom[r], num_chrom);
+		swap_elements(&Chrom[p], &Chrom[r]);
 		
 		--r;
 
@@ -704,11 +860,11 @@ void QuickSort_ChromCluster_by_higher_Density(ClusterChrom* Chrom, int num_chrom
 			
 			if (l > r) break;
 
-			swap_elements(Chrom, &Chrom[l],&Chrom[r], num_chrom);
+			swap_elements(&Chrom[l],&Chrom[r]);
 			if (p == r) p=l;
 			++l;--r;
 		}
-		swap_elements(Chrom, &Chrom[p], &Chrom[r], num_chrom);
+		swap_elements(&Chrom[p], &Chrom[r]);
 		
 		--r;
 
@@ -741,11 +897,11 @@ void QuickSort_ChromCluster_by_lower_Density(ClusterChrom* Chrom, int num_chrom,
 			
 			if (l > r) break;
 
-			swap_elements(Chrom, &Chrom[l],&Chrom[r], num_chrom);
+			swap_elements(&Chrom[l],&Chrom[r]);
 			if (p == r) p=l;
 			++l;--r;
 		}
-		swap_elements(Chrom, &Chrom[p], &Chrom[r], num_chrom);
+		swap_elements(&Chrom[p], &Chrom[r]);
 		
 		--r;
 
@@ -762,20 +918,7 @@ void QuickSort_ChromCluster_by_lower_Density(ClusterChrom* Chrom, int num_chrom,
 	}
 }
 
-void swap_elements(ClusterChrom* Chrom, ClusterChrom* ChromX, ClusterChrom* ChromY, int num_chrom)
-{
-	int i;
-	ClusterChrom* pChrom;
-	ClusterChrom ChromT = *ChromX;*ChromX = *ChromY; *ChromY = ChromT;
-	
-	for(i=0, pChrom=NULL;i<num_chrom;++i)
-	{
-		pChrom = &Chrom[i];
-		if(pChrom->DP == ChromX) pChrom->DP = ChromY;
-		else if(pChrom->DP == ChromY) pChrom->DP = ChromX;
-	}
-		
-}
+void swap_elements(ClusterChrom* ChromX, ClusterChrom* ChromY) { ClusterChrom ChromT = *ChromX; *ChromX = *ChromY; *ChromY = ChromT; }
 
 float calculate_stddev(ClusterChrom* Chrom, int num_chrom)
 {
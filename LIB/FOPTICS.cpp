@@ -100,6 +100,9 @@ FastOPTICS::FastOPTICS(FA_Global* FA, GB_Global* GB, VC_Global* VC, chromosome*
     // this->nDimensions = this->FA->npar + 2; 	// use with Vectorized_Chromosome()
     
     this->minPoints = nPoints;
+    this->nThreads = 1;
+    this->Projections = NULL;
+    this->seed = 0;
     
     // FastOPTICS::iOrder = 0;
     this->iOrder = 0;
@@ -130,7 +133,27 @@ FastOPTICS::FastOPTICS(FA_Global* FA, GB_Global* GB, VC_Global* VC, chromosome*
 
 };
 
-void FastOPTICS::Execute_FastOPTICS(char* end_strfile, char* tmp_end_strfile)
+// Constructor reusing the vectorized chromosomes of Source (avoids rebuilding the cartesian coordinates of every chromosome for each minPoints)
+FastOPTICS::FastOPTICS(const FastOPTICS& Source, BindingPopulation& Population, int nPoints) : N(Source.N), minPoints(nPoints), nDimensions(Source.nDimensions), iOrder(0), points(Source.points), Population(&Population), FA(Source.FA), GB(Source.GB), VC(Source.VC), chroms(Source.chroms), gene_lim(Source.gene_lim), atoms(Source.atoms), residue(Source.residue), cleftgrid(Source.cleftgrid)
+{
+	this->nThreads = 1;
+	this->Projections = NULL;
+	this->seed = 0;
+	this->order.assign(this->points.size(), -1);
+	this->reachDist.assign(this->points.size(), UNDEFINED_DIST);
+	this->processed.assign(this->points.size(), false);
+	this->inverseDensities.assign(this->points.size(), 0.0f);
+	this->neighbors.reserve(this->N);
+}
+
+void* FastOPTICS_thread(void* Algo)
+{
+	FastOPTICS* pAlgo = static_cast<FastOPTICS*>(Algo);
+	pAlgo->Execute_FastOPTICS(*pAlgo->Projections, pAlgo->nThreads);
+	return NULL;
+}
+
+void FastOPTICS::Execute_FastOPTICS(const RandomProjections& Projections, int nThreads)
 {
 	// vector of point indexes 
 	std::vector< int > ptInd;
@@ -140,8 +163,9 @@ void FastOPTICS::Execute_FastOPTICS(char* end_strfile, char* tmp_end_strfile)
         ptInd.push_back(k);
     }
 	
-	// Build object, compute projections, density estimates and density neighborhoods (in serial order of function calls below)
-	RandomProjectedNeighborsAndDensities::RandomProjectedNeighborsAndDensities MultiPartition(this->points, this->minPoints, this); // use minPoints amount of random projections
+	// Build object, split sets along the shared projections, density estimates and density neighborhoods (in serial order of function calls below)
+	this->nThreads = nThreads;
+	RandomProjectedNeighborsAndDensities MultiPartition(this->points, this->minPoints, this, Projections); // use minPoints as minimal split size
 	MultiPartition.computeSetBounds(ptInd);
 	MultiPartition.getInverseDensities(this->inverseDensities);
 	MultiPartition.getNeighbors(this->neighbors);
@@ -155,9 +179,6 @@ void FastOPTICS::Execute_FastOPTICS(char* end_strfile, char* tmp_end_strfile)
     
     // Would it be useful to normalize 'reachability distance' ?
     // this->normalizeDistances();
-    // output the projected distances
-    
-    MultiPartition.output_projected_distance(end_strfile, tmp_end_strfile);
     
 	// Order chromosome and their reachDist in OPTICS
     //  points pairs contain :
@@ -168,16 +189,16 @@ void FastOPTICS::Execute_FastOPTICS(char* end_strfile, char* tmp_end_strfile)
 		if( (this->points[i]).first != NULL && (this->points[i].first)->app_evalue < 0 )
 		{
 			// Calling Pose constructor for the current chromosome
-			Pose::Pose Pose((this->points[i]).first, i, this->order[i], this->reachDist[i], this->Population->Temperature, (this->points[i]).second);
-			// OPTICS.push(Pose);
-            this->OPTICS.push_back(Pose);
+			Pose pose((this->points[i]).first, i, this->order[i], this->reachDist[i], this->Population->Temperature, &this->points);
+			// OPTICS.push(pose);
+            this->OPTICS.push_back(pose);
 		}
 	}
-    std::sort(this->OPTICS.begin(), this->OPTICS.end(), PoseClassifier::PoseClassifier());
+    std::sort(this->OPTICS.begin(), this->OPTICS.end(), PoseClassifier());
 
 	// Build BindingModes (aggregation of Poses in BindingModes)
     int i = 0; // used to have an idea of the number of loop completed (iterators are less convenient for that information while debugging)
- 	BindingMode::BindingMode Current(this->Population);
+ 	BindingMode Current(this->Population);
 	for(std::vector< Pose >::iterator it = this->OPTICS.begin(); it != this->OPTICS.end(); ++i, ++it)
 	{
 
@@ -214,8 +235,8 @@ void FastOPTICS::output_OPTICS(char* end_strfile, char* tmp_end_strfile)
         fprintf(outfile, "#ORDER\t#INDEX\t#reachDist\t#CF\t#prevRMSD\t#nextRMSD\n");
 		for(std::vector<Pose>::iterator it = this->OPTICS.begin(); it != this->OPTICS.end(); ++it)
 		{
-			float prevDist = (it == this->OPTICS.begin()) 	? 0.0f : this->compute_vect_distance(it->vPose, (it-1)->vPose);
-			float nextDist = ((it+1) == this->OPTICS.end()) ? 0.0f : this->compute_vect_distance(it->vPose, (it+1)->vPose);
+			float prevDist = (it == this->OPTICS.begin()) 	? 0.0f : this->compute_vect_distance(it->get_vPose(), (it-1)->get_vPose());
+			float nextDist = ((it+1) == this->OPTICS.end()) ? 0.0f : this->compute_vect_distance(it->get_vPose(), (it+1)->get_vPose());
             if(!isUndefinedDist(it->reachDist))	fprintf(outfile, "%d\t%d\t%8g\t%8g\t%8g\t%8g\n", it->order, it->chrom_index, it->reachDist, it->CF, prevDist, nextDist);
             else fprintf(outfile, "%d\t%d\t%8g\t%8g\t%8g\t%8g\n", it->order, it->chrom_index, UNDEFINED_DIST, it->CF, prevDist, nextDist);
 		}
@@ -442,7 +463,7 @@ std::vector<float> FastOPTICS::Vectorized_Cartesian_Coordinates(int chrom_index)
   
 	}
 
-	if(normalmode > -1) alter_mode(this->atoms,this->residue,this->FA->normal_grid[normalmode],this->FA->res_cnt,this->FA->normal_modes);
+	if(normalmode > -1) alter_mode(this->FA,this->atoms,normalmode,0);
 
 	/* rebuild cartesian coordinates of optimized residues*/
     for(i=0;i<this->FA->nors;i++) buildcc(this->FA,this->atoms,this->FA->nmov[i],this->FA->mov[i]);
@@ -462,7 +483,7 @@ std::vector<float> FastOPTICS::Vectorized_Cartesian_Coordinates(int chrom_index)
 
 void FastOPTICS::ExpandClusterOrder(int ipt)
 {
-    std::priority_queue< ClusterOrdering, std::vector<ClusterOrdering>, ClusterOrderingComparator::ClusterOrderingComparator > queue;
+    std::priority_queue< ClusterOrdering, std::vector<ClusterOrdering>, ClusterOrderingComparator > queue;
 	ClusterOrdering tmp(ipt,0,1e6f);
 	queue.push(tmp);
 
@@ -494,12 +515,12 @@ void FastOPTICS::ExpandClusterOrder(int ipt)
 				this->reachDist[iNeigh] = nrdist;
 			else if(nrdist < this->reachDist[iNeigh])
 				this->reachDist[iNeigh] = nrdist;
-			tmp = ClusterOrdering::ClusterOrdering(iNeigh, currPt, nrdist);
+			tmp = ClusterOrdering(iNeigh, currPt, nrdist);
 			queue.push(tmp);
 		}
         std::make_heap(const_cast<ClusterOrdering*>(&queue.top()),
                        const_cast<ClusterOrdering*>(&queue.top() + queue.size()),
-                       ClusterOrderingComparator::ClusterOrderingComparator()
+                       ClusterOrderingComparator()
                        );
 	}
 }
@@ -528,7 +549,7 @@ float FastOPTICS::compute_distance(std::pair< chromosome*,std::vector<float> > &
     // else 	return 0.0f;
    	}
 
-float FastOPTICS::compute_vect_distance(std::vector<float> a, std::vector<float> b)
+float FastOPTICS::compute_vect_distance(const std::vector<float>& a, const std::vector<float>& b)
 {
 	float distance = 0.0f;
 
@@ -548,116 +569,167 @@ int FastOPTICS::get_minPoints() { return this->minPoints; }
 \*****************************************/
 
 // STATIC variables declaration
-int const RandomProjectedNeighborsAndDensities::logOProjectionConstant;
-float RandomProjectedNeighborsAndDensities::sizeTolerance;
+int const RandomProjections::logOProjectionConstant;
+const float RandomProjectedNeighborsAndDensities::sizeTolerance = static_cast<float>(2.0f/3.0f);
 
-// Constructor
-RandomProjectedNeighborsAndDensities::RandomProjectedNeighborsAndDensities(std::vector< std::pair< chromosome*,std::vector<float> > >& inPoints, int minSplitSize, FastOPTICS* top)
+// Constructor : draws the random vectors (serial, uses FA/atoms of top) and projects every point on them (nThreads)
+RandomProjections::RandomProjections(FastOPTICS* top, int nThreads)
 {
 	this->top = top;
-	this->minSplitSize = minSplitSize;
-	RandomProjectedNeighborsAndDensities::sizeTolerance = static_cast<float>(2.0f/3.0f);
+	this->nThreads = (nThreads < 1) ? 1 : nThreads;
 
-	if( inPoints.size() < 1 )
+	if( top->points.size() < 1 )
 	{
 		this->N = 0;
 		this->nDimensions = 0;
 		this->nProject1D = 0;
+		this->nPointsSetSplits = 0;
 		return;
 	}
-	else
+	this->N = top->points.size();
+	this->nDimensions = top->nDimensions;
+	this->nPointsSetSplits = static_cast<int>(RandomProjections::logOProjectionConstant * log(this->N * this->nDimensions + 1)/log(2));
+	this->nProject1D = static_cast<int>(RandomProjections::logOProjectionConstant * log(this->N * this->nDimensions + 1)/log(2));
+
+	this->randomVectors.reserve(this->nProject1D);
+	this->projectedPoints.reserve(this->nProject1D);
+	for(int j = 0; j < this->nProject1D; ++j)
 	{
-        this->points = inPoints;
-		this->N = this->points.size();
-		this->nDimensions = this->top->nDimensions;
-		this->nPointsSetSplits = static_cast<int>(RandomProjectedNeighborsAndDensities::logOProjectionConstant * log(this->N * this->nDimensions + 1)/log(2));
-		this->nProject1D = static_cast<int>(RandomProjectedNeighborsAndDensities::logOProjectionConstant * log(this->N * this->nDimensions + 1)/log(2));
-		// line below calls copy-constructor
+		// std::vector<float> currentRp = this->Randomized_InternalCoord_Vector();
+		this->randomVectors.push_back(this->Randomized_CartesianCoord_Vector());
+		this->projectedPoints.push_back(std::vector<float>(this->N));
 	}
-	this->projectedPoints.reserve(this->nProject1D);
-	for(int i = 0; i < this->nProject1D; ++i)
+
+	// perform projection of points (projections are independent of each other)
+	if(this->nThreads > this->nProject1D) this->nThreads = this->nProject1D;
+	std::vector<pthread_t> threads(this->nThreads);
+	std::vector<FOPTICS_worker> workers(this->nThreads);
+	std::vector<bool> started(this->nThreads, false);
+	for(int t = 0; t < this->nThreads; ++t)
 	{
-        this->projectedPoints.push_back(std::vector<float>(this->N));
+		workers[t].object = this;
+		workers[t].first = t;
+		workers[t].step = this->nThreads;
+		// worker 0 runs in the calling thread
+		if(t > 0) started[t] = ( pthread_create(&threads[t], NULL, RandomProjections::project_thread, &workers[t]) == 0 );
 	}
-//	this->splitsets.reserve(this->nPointsSetSplits);
-//	for(int j = 0; j< this->nPointsSetSplits; ++j)
-//	{
-		// this->splitsets.push_back(std::vector<int>());
-//	}
+	for(int t = 0; t < this->nThreads; ++t) if(!started[t]) this->project(workers[t].first, workers[t].step);
+	for(int t = 0; t < this->nThreads; ++t) if(started[t]) pthread_join(threads[t], NULL);
+	
+	this->randomVectors.clear();
 }
 
-void RandomProjectedNeighborsAndDensities::computeSetBounds(std::vector< int > & ptList)
+void* RandomProjections::project_thread(void* arg)
+{
+	FOPTICS_worker* worker = static_cast<FOPTICS_worker*>(arg);
+	static_cast<RandomProjections*>(worker->object)->project(worker->first, worker->step);
+	return NULL;
+}
+
+void RandomProjections::project(int first, int step)
 {
-	std::vector< std::vector<float> > tempProj(this->nProject1D);
-	// perform projection of points
-	for(int j = 0; j<this->nProject1D; ++j)
+	for(int j = first; j < this->nProject1D; j += step)
 	{
-        // std::vector<float> currentRp = this->Randomized_InternalCoord_Vector();
-        std::vector<float> currentRp(this->Randomized_CartesianCoord_Vector());
-        
-		int k = 0;
-		std::vector<int>::iterator it = ptList.begin();
-		while(it != ptList.end())
+		const std::vector<float> & currentRp = this->randomVectors[j];
+		std::vector<float> & currPro = this->projectedPoints[j];
+		for(int k = 0; k < this->N; ++k)
 		{
+			const std::vector<float> & vecPt = this->top->points[k].second;
 			float sum = 0.0f;
-			// std::vector<float>::iterator vecPt = this->points[(*it)].second.begin();
-			std::vector<float> vecPt(this->points[(*it)].second);
-			std::vector<float>::iterator currPro = (this->projectedPoints[j]).begin();
 			for(int m = 0; m < this->nDimensions; ++m)
 				sum += currentRp[m] * vecPt[m];
-
 			currPro[k] = sum;
-
-			++k;
-            ++it;
 		}
 	}
+}
 
-	// Split Points Set
-    
-	std::vector<int> projInd(this->nProject1D);
-	projInd.reserve(this->nProject1D);
-	for(int j = 0; j < this->nProject1D; ++j) 
+// Constructor
+RandomProjectedNeighborsAndDensities::RandomProjectedNeighborsAndDensities(std::vector< std::pair< chromosome*,std::vector<float> > >& inPoints, int minSplitSize, FastOPTICS* top, const RandomProjections& Projections) : top(top), Projections(Projections), points(inPoints)
+{
+	this->minSplitSize = minSplitSize;
+	this->nThreads = (top->nThreads < 1) ? 1 : top->nThreads;
+	this->seed = top->seed;
+
+	if( inPoints.size() < 1 )
 	{
-//		projInd.push_back(j);
-        projInd[j] = j;
+		this->N = 0;
+		this->nDimensions = 0;
+		this->nProject1D = 0;
+		this->nPointsSetSplits = 0;
+		return;
 	}
-	for(int avgP = 0; avgP < this->nPointsSetSplits; avgP++)
+	else
 	{
-		// Shuffle projections
-		for(int i = 0; i < this->nProject1D; ++i)
-        {
-//			tempProj.push_back(this->projectedPoints[i]);
-            tempProj[i] = this->projectedPoints[i];
-        }
-//        std::random_shuffle(projInd.begin(), projInd.end(), ([](int n) { return rand() % n; }) );
-        std::random_shuffle(projInd.begin(), projInd.end());
-		
-		int i = 0;
-        for(std::vector<int>::iterator it = projInd.begin(); it != projInd.end(); ++it, i++)
+		this->N = this->points.size();
+		this->nDimensions = this->top->nDimensions;
+		this->nPointsSetSplits = Projections.nPointsSetSplits;
+		this->nProject1D = Projections.nProject1D;
+	}
+}
+
+void RandomProjectedNeighborsAndDensities::computeSetBounds(std::vector< int > & ptList)
+{
+	// Split Points Set : each split round shuffles the projections and splits the points set recursively
+	int nWorkers = (this->nThreads < this->nPointsSetSplits) ? this->nThreads : this->nPointsSetSplits;
+	if(nWorkers < 1) return;
+
+	this->roundsets.assign(this->nPointsSetSplits, std::vector< std::vector<int> >());
+	std::vector<pthread_t> threads(nWorkers);
+	std::vector<FOPTICS_worker> workers(nWorkers);
+	std::vector<bool> started(nWorkers, false);
+	for(int t = 0; t < nWorkers; ++t)
+	{
+		workers[t].object = this;
+		workers[t].first = t;
+		workers[t].step = nWorkers;
+		// worker 0 runs in the calling thread
+		if(t > 0) started[t] = ( pthread_create(&threads[t], NULL, RandomProjectedNeighborsAndDensities::split_thread, &workers[t]) == 0 );
+	}
+	for(int t = 0; t < nWorkers; ++t) if(!started[t]) this->split_rounds(workers[t].first, workers[t].step);
+	for(int t = 0; t < nWorkers; ++t) if(started[t]) pthread_join(threads[t], NULL);
+
+	// gather split sets in round order
+	for(int avgP = 0; avgP < this->nPointsSetSplits; ++avgP)
+	{
+		this->splitsets.insert(this->splitsets.end(), this->roundsets[avgP].begin(), this->roundsets[avgP].end());
+	}
+	this->roundsets.clear();
+}
+
+void* RandomProjectedNeighborsAndDensities::split_thread(void* arg)
+{
+	FOPTICS_worker* worker = static_cast<FOPTICS_worker*>(arg);
+	static_cast<RandomProjectedNeighborsAndDensities*>(worker->object)->split_rounds(worker->first, worker->step);
+	return NULL;
+}
+
+void RandomProjectedNeighborsAndDensities::split_rounds(int first, int step)
+{
+	std::vector<int> projInd(this->nProject1D);
+	std::vector<int> ind(this->N);
+	for(int avgP = first; avgP < this->nPointsSetSplits; avgP += step)
+	{
+		boost::random::mt19937 rng(this->seed + avgP);
+
+		// Shuffle projections (Fisher-Yates)
+		for(int j = 0; j < this->nProject1D; ++j) projInd[j] = j;
+		for(int j = this->nProject1D-1; j > 0; --j)
 		{
-			int cind = (*it);
-			// look this line to be sure that the vector is pushed in this->projectedPoints
-			this->projectedPoints[cind] = tempProj[i];
+			boost::random::uniform_int_distribution<> dist(0, j);
+			std::swap(projInd[j], projInd[dist(rng)]);
 		}
 
 		//split points set
-		int nPoints = ptList.size();
-		std::vector<int> ind(nPoints);
-		ind.reserve(nPoints);
-		for(int l = 0; l < nPoints; ++l)
-		{
-			ind[l] = l;
-		}
-		this->SplitUpNoSort(ind,0);
+		for(int l = 0; l < this->N; ++l) ind[l] = l;
+		this->SplitUpNoSort(ind, 0, projInd, rng, this->roundsets[avgP]);
 	}
 }
 
-void RandomProjectedNeighborsAndDensities::SplitUpNoSort(std::vector< int >& ind, int dim)
+void RandomProjectedNeighborsAndDensities::SplitUpNoSort(std::vector< int >& ind, int dim, const std::vector<int>& projInd, boost::random::mt19937& rng, std::vector< std::vector<int> >& sets)
 {
 	int nElements = ind.size();
 	dim = dim % this->nProject1D;
-	std::vector<float>::iterator tProj = (this->projectedPoints[dim]).begin();
+	std::vector<float>::const_iterator tProj = (this->Projections.projectedPoints[projInd[dim]]).begin();
 	int splitPos;
 
 	// save set such that used for density or neighborhood computation
@@ -666,19 +738,19 @@ void RandomProjectedNeighborsAndDensities::SplitUpNoSort(std::vector< int >& ind
 		std::vector<float> cpro(nElements);
 		for(int i = 0; i < nElements; ++i)	
 		{
-//			cpro.push_back(tProj[ind[i]]);
             cpro[i] = tProj[ind[i]];
 		}
 		// sprting cpro[] && ind[] concurrently
 		this->quicksort_concurrent_Vectors(cpro, ind, 0, nElements-1);
-		this->splitsets.push_back(ind);
+		sets.push_back(ind);
 	}
 
 	// compute splitting element
 	if(nElements > this->minSplitSize)
 	{
 		//pick random splitting element based on position
-		int randInt = static_cast<int>(std::floor( (RandomDouble()*static_cast<double>(nElements)) ));
+		boost::random::uniform_int_distribution<> dist(0, nElements-1);
+		int randInt = dist(rng);
 		float rs = tProj[ind[randInt]];
 		int minInd = 0;
 		int maxInd = nElements - 1;
@@ -702,23 +774,11 @@ void RandomProjectedNeighborsAndDensities::SplitUpNoSort(std::vector< int >& ind
 		// split set recursively
 		splitPos = minInd + 1;
 		
-		// std::vector<int> ind2(splitPos);
-		std::vector<int> ind2(splitPos);
-		for(int l = 0; l < splitPos; ++l)
-		{
-			 ind2[l] = ind[l];
-//			ind2.push_back(ind[l]);
-		}
-		this->SplitUpNoSort(ind2,dim+1);
+		std::vector<int> ind2(ind.begin(), ind.begin()+splitPos);
+		this->SplitUpNoSort(ind2, dim+1, projInd, rng, sets);
 		
-        std::vector<int> ind3(nElements - splitPos);
-//        ind2 = std::vector<int>( nElements-splitPos );
-		for(int l = 0; l < nElements-splitPos; ++l)
-		{
-			 ind3[l] = ind[l+splitPos];
-//			ind3.push_back(ind[l+splitPos]);
-		}
-		this->SplitUpNoSort(ind3,dim+1);
+        std::vector<int> ind3(ind.begin()+splitPos, ind.end());
+		this->SplitUpNoSort(ind3, dim+1, projInd, rng, sets);
 	}
 }
 
@@ -815,7 +875,7 @@ void FastOPTICS::normalizeDistances()
 	for(std::vector<float>::iterator it = Distances.begin(); it != Distances.end(); ++it) if(!isUndefinedDist(*it)) *it /= max;
 }
 
-std::vector<float> RandomProjectedNeighborsAndDensities::Randomized_InternalCoord_Vector()
+std::vector<float> RandomProjections::Randomized_InternalCoord_Vector()
 {
     std::vector<float> vChrom(this->nDimensions);
 
@@ -864,7 +924,7 @@ std::vector<float> RandomProjectedNeighborsAndDensities::Randomized_InternalCoor
 	return vChrom;
 }
 
-std::vector<float> RandomProjectedNeighborsAndDensities::Randomized_CartesianCoord_Vector()
+std::vector<float> RandomProjections::Randomized_CartesianCoord_Vector()
 {
     float norm = 0.0f;
 
@@ -933,7 +993,7 @@ std::vector<float> RandomProjectedNeighborsAndDensities::Randomized_CartesianCoo
   
 	}
 
-	if(normalmode > -1) alter_mode(this->top->atoms,this->top->residue,this->top->FA->normal_grid[normalmode],this->top->FA->res_cnt,this->top->FA->normal_modes);
+	if(normalmode > -1) alter_mode(this->top->FA,this->top->atoms,normalmode,0);
 
 	/* rebuild cartesian coordinates of optimized residues*/
     for(i=0;i<this->top->FA->nors;i++) buildcc(this->top->FA,this->top->atoms,this->top->FA->nmov[i],this->top->FA->mov[i]);
@@ -1005,10 +1065,10 @@ void RandomProjectedNeighborsAndDensities::swap_element_in_vectors(std::vector<f
 	int tIndex = *xIndex; *xIndex = *yIndex; *yIndex = tIndex;
 }
 
-void RandomProjectedNeighborsAndDensities::output_projected_distance(char* end_strfile, char* tmp_end_strfile)
+void RandomProjections::output_projected_distance(char* end_strfile, char* tmp_end_strfile, int minPoints) const
 {
 	char sufix[25];
-	sprintf(sufix, "__%d.projDist", this->top->minPoints);
+	sprintf(sufix, "__%d.projDist", minPoints);
 	strcpy(tmp_end_strfile, end_strfile);
 	strcat(tmp_end_strfile,sufix);
 	FILE* outfile;
@@ -1022,7 +1082,7 @@ void RandomProjectedNeighborsAndDensities::output_projected_distance(char* end_s
 		{
             for(int j = 0; j < this->nProject1D; ++j)
 			{
-                std::vector<float> & it = this->projectedPoints.at(j);
+                const std::vector<float> & it = this->projectedPoints.at(j);
 				fprintf(outfile, "%6f", it[i]);
                 if(j < this->nProject1D-1) fprintf(outfile, "\t");
                 else fprintf(outfile, "\n");
@@ -1048,6 +1108,13 @@ int roll_die()
     boost::random::uniform_int_distribution<> dist(0, MAX_RANDOM_VALUE);
     return dist(gen);
 }
+// number of online processors (at least 1) used to size worker threads
+int get_nThreads()
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return (n < 1) ? 1 : static_cast<int>(n);
+}
+
 int roll_rand_die()
 {
 	int n;
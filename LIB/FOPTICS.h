@@ -9,16 +9,29 @@
 #include <fstream>
 #include <queue>
 #include <cmath>
+#include <pthread.h>
+#include <unistd.h>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
 
 
 int roll_die();
 int roll_rand_die();
+int get_nThreads();
 // Float comparators
 bool definitelyGreaterThan(float a, float b, float epsilon);
 bool definitelyLessThan(float a, float b, float epsilon);
 
 float normalize_IC_interval(const genlim* gene_lim, float dist);
 
+// argument of worker threads (a worker processes items first, first+step, first+2*step, ...)
+struct FOPTICS_worker
+{
+	void* object;
+	int first;
+	int step;
+};
+
 struct ClusterOrdering
 {
 	int objectID;
@@ -64,18 +77,25 @@ struct ClusterOrderingComparator
 /*****************************************\
 				FastOPTICS
 \*****************************************/
+class RandomProjections; // forward-declaration of the projections shared by FastOPTICS runs
+
 class FastOPTICS
 {
 	friend class RandomProjectedNeighborsAndDensities;
+	friend class RandomProjections;
 	
 	public:
 		explicit 	FastOPTICS(FA_Global* FA, GB_Global* GB, VC_Global* VC, chromosome* chrom, genlim* gen_lim, atom* atoms, resid* residue, gridpoint* cleftgrid, int nChrom, BindingPopulation&, int nPoints); // Constructor (publicly called from FlexAID's *_cluster.cxx)
-		void 		Execute_FastOPTICS(char* end_strfile, char* tmp_end_strfile);
+		explicit 	FastOPTICS(const FastOPTICS&, BindingPopulation&, int nPoints); // Constructor sharing the vectorized chromosomes of an existing FastOPTICS
+		void 		Execute_FastOPTICS(const RandomProjections& Projections, int nThreads); // thread-safe as long as each FastOPTICS owns its BindingPopulation
         void 		output_OPTICS(char* end_strfile, char* tmp_end_strfile);
         void 		output_3d_OPTICS_ordering(char* end_strfile, char* tmp_end_strfile);
 		float 		compute_distance(std::pair< chromosome*,std::vector<float> > &, std::pair< chromosome*,std::vector<float> > &);
-		float 		compute_vect_distance(std::vector<float> a, std::vector<float> b);
+		float 		compute_vect_distance(const std::vector<float>& a, const std::vector<float>& b);
 		int 		get_minPoints();
+		int 		nThreads;	// number of threads used by Execute_FastOPTICS() (set before starting FastOPTICS_thread)
+		const RandomProjections* Projections;	// shared projections used by FastOPTICS_thread()
+		boost::random::mt19937::result_type seed;	// seed of the split rounds (drawn serially before starting FastOPTICS_thread)
 
 	private:
 		// FlexAID specific attributes
@@ -116,6 +136,40 @@ class FastOPTICS
 		std::vector<float>			Vectorized_Cartesian_Coordinates(int chrom_index);
 };
 
+// pthread entry point : calls Execute_FastOPTICS() on the FastOPTICS* passed as argument
+void* FastOPTICS_thread(void* Algo);
+
+/*****************************************			RandomProjections
+\*****************************************/
+// Random projections of the vectorized chromosomes.
+// Projections do not depend on minPoints and are computed once, then shared (read-only) by every FastOPTICS run.
+class RandomProjections
+{
+	friend class RandomProjectedNeighborsAndDensities;
+
+	public:
+		explicit RandomProjections(FastOPTICS* top, int nThreads); // random vectors are drawn serially (FA/atoms are modified), projections are computed with nThreads
+		void 								output_projected_distance(char* end_strfile, char* tmp_end_strfile, int minPoints) const;
+
+	private:
+		FastOPTICS* top;
+		int N;
+		int nDimensions;
+		int nThreads;
+		static const int logOProjectionConstant = 20;
+		std::vector< std::vector<float> > 	randomVectors;
+
+		std::vector<float> 					Randomized_InternalCoord_Vector();
+		std::vector<float>					Randomized_CartesianCoord_Vector();
+		void 								project(int first, int step);
+		static void* 						project_thread(void*);
+
+	protected:
+		int nProject1D;				// CONSTANT c0
+		int nPointsSetSplits;		// CONSTANT c1
+		std::vector< std::vector<float> > 	projectedPoints;
+};
+
 /*****************************************\
 			RandomProjections
 \*****************************************/
@@ -124,20 +178,25 @@ class RandomProjectedNeighborsAndDensities
 	friend class FastOPTICS;
 	
 	public:
-		explicit RandomProjectedNeighborsAndDensities(std::vector< std::pair< chromosome*,std::vector<float> > >&, int, FastOPTICS*); // Constructor (publicly called from FlexAID *_cluster.cxx)
+		explicit RandomProjectedNeighborsAndDensities(std::vector< std::pair< chromosome*,std::vector<float> > >&, int, FastOPTICS*, const RandomProjections&); // Constructor (publicly called from FlexAID *_cluster.cxx)
 	
 	private:
 		// private attributes
 		FastOPTICS* top;
+		const RandomProjections& Projections;
 		int N;
 		int nDimensions;
 		int minSplitSize;
-		static const int logOProjectionConstant = 20;
-		static float sizeTolerance;
-		std::vector< std::pair<chromosome*,std::vector<float> > > points;
+		int nThreads;
+		boost::random::mt19937::result_type seed;	// split rounds are seeded from seed+round (results do not depend on nThreads)
+		static const float sizeTolerance;
+		std::vector< std::pair<chromosome*,std::vector<float> > >& points;
+		std::vector< std::vector< std::vector< int > > > roundsets;	// split sets found in each split round
 
 		// private methods
-		void 								SplitUpNoSort(std::vector<int>&, int);
+		void 								SplitUpNoSort(std::vector<int>&, int, const std::vector<int>&, boost::random::mt19937&, std::vector< std::vector<int> >&);
+		void 								split_rounds(int first, int step);
+		static void* 						split_thread(void*);
 		void 								quicksort_concurrent_Vectors(std::vector<float>& data, std::vector<int>& index, int begin, int end);
 		void 								swap_element_in_vectors(std::vector<float>::iterator, std::vector<float>::iterator, std::vector<int>::iterator , std::vector<int>::iterator);
 		
@@ -146,14 +205,10 @@ class RandomProjectedNeighborsAndDensities
 		int nProject1D;				// CONSTANT c0
 		int nPointsSetSplits;		// CONSTANT c1
 		std::vector< std::vector< int > > 	splitsets;
-		std::vector< std::vector< float > > projectedPoints;
 		// protected methods (accessible via FastOPTICS class)
 		void 								computeSetBounds(std::vector< int >&);
 		void								getInverseDensities(std::vector<float> &);
 		void								getNeighbors(std::vector< std::vector< int > > &);
-		std::vector<float> 					Randomized_InternalCoord_Vector();
-        std::vector<float>                  Randomized_CartesianCoord_Vector();
-        void								output_projected_distance(char* end_strfile, char* tmp_end_strfile);
 		// int 								Dice();
 };
 #endif
@@ -3,36 +3,56 @@
 void FastOPTICS_cluster(FA_Global* FA, GB_Global* GB, VC_Global* VC, chromosome* chrom, genlim* gene_lim, atom* atoms, resid* residue, gridpoint* cleftgrid, int nChrom, char* end_strfile, char* tmp_end_strfile, char* dockinp, char* gainp)
 {
     int minPoints = 10;
+    int nThreads = get_nThreads();
     // (minPoints < 3*FA->num_het_atm) ? minPoints = minPoints : minPoints = 3*FA->num_het_atm;
 	
     // BindingPopulation() : BindingPopulation constructor *non-overridable*
-    BindingPopulation::BindingPopulation Population1(FA,GB,VC,chrom,gene_lim,atoms,residue,cleftgrid,nChrom);
-    BindingPopulation::BindingPopulation Population2(FA,GB,VC,chrom,gene_lim,atoms,residue,cleftgrid,nChrom);
-    BindingPopulation::BindingPopulation Population3(FA,GB,VC,chrom,gene_lim,atoms,residue,cleftgrid,nChrom);
- //    BindingPopulation::BindingPopulation Population4(FA,GB,VC,chrom,gene_lim,atoms,residue,cleftgrid,nChrom);
-	// BindingPopulation::BindingPopulation Population5(FA,GB,VC,chrom,gene_lim,atoms,residue,cleftgrid,nChrom);
+    BindingPopulation Population1(FA,GB,VC,chrom,gene_lim,atoms,residue,cleftgrid,nChrom);
+    BindingPopulation Population2(FA,GB,VC,chrom,gene_lim,atoms,residue,cleftgrid,nChrom);
+    BindingPopulation Population3(FA,GB,VC,chrom,gene_lim,atoms,residue,cleftgrid,nChrom);
+ //    BindingPopulation Population4(FA,GB,VC,chrom,gene_lim,atoms,residue,cleftgrid,nChrom);
+	// BindingPopulation Population5(FA,GB,VC,chrom,gene_lim,atoms,residue,cleftgrid,nChrom);
     
-    // FastOPTICS() : calling FastOPTICS constructors
-    FastOPTICS::FastOPTICS Algo1(FA, GB, VC, chrom, gene_lim, atoms, residue, cleftgrid, nChrom, Population1, minPoints);
+    // FastOPTICS() : calling FastOPTICS constructors (chromosomes are vectorized once by Algo1 and shared)
+    FastOPTICS Algo1(FA, GB, VC, chrom, gene_lim, atoms, residue, cleftgrid, nChrom, Population1, minPoints);
     minPoints = std::floor(minPoints * 1.5);
-    FastOPTICS::FastOPTICS Algo2(FA, GB, VC, chrom, gene_lim, atoms, residue, cleftgrid, nChrom, Population2, minPoints);
+    FastOPTICS Algo2(Algo1, Population2, minPoints);
     minPoints = std::floor(minPoints * 1.5);
-    FastOPTICS::FastOPTICS Algo3(FA, GB, VC, chrom, gene_lim, atoms, residue, cleftgrid, nChrom, Population3, minPoints);
+    FastOPTICS Algo3(Algo1, Population3, minPoints);
     // minPoints = std::floor(minPoints * 1.5);
-    // FastOPTICS::FastOPTICS Algo4(FA, GB, VC, chrom, gene_lim, atoms, residue, cleftgrid, nChrom, Population4, minPoints);
+    // FastOPTICS Algo4(Algo1, Population4, minPoints);
     // minPoints = std::floor(minPoints * 1.5);
-    // FastOPTICS::FastOPTICS Algo5(FA, GB, VC, chrom, gene_lim, atoms, residue, cleftgrid, nChrom, Population5, minPoints);
+    // FastOPTICS Algo5(Algo1, Population5, minPoints);
     
-    // 	1. Partition Sets using Random Vectorial Projections
+    // 	0. Random Vectorial Projections (independent of minPoints, computed once and shared by all FastOPTICS)
+    // 	1. Partition Sets using the Random Vectorial Projections
     // 	2. Calculate Neighborhood
     // 	3. Calculate reachability distance
     // 	4. Compute the Ordering of Points To Identify Cluster Structure (OPTICS)
     // 	5. Populate BindingPopulation::Population after analyzing OPTICS
-    Algo1.Execute_FastOPTICS(end_strfile, tmp_end_strfile);
-    Algo2.Execute_FastOPTICS(end_strfile, tmp_end_strfile);
-    Algo3.Execute_FastOPTICS(end_strfile, tmp_end_strfile);
-    // Algo4.Execute_FastOPTICS(end_strfile, tmp_end_strfile);
-    // Algo5.Execute_FastOPTICS(end_strfile, tmp_end_strfile);
+    // Steps 1. to 5. only touch the FastOPTICS and its own BindingPopulation : the FastOPTICS are executed concurrently
+    RandomProjections Projections(&Algo1, nThreads);
+    
+    FastOPTICS* Algos[3] = { &Algo1, &Algo2, &Algo3 };
+    pthread_t threads[3];
+    bool started[3];
+    // the global generator is not thread-safe : the seeds are drawn before starting the threads
+    for(int i = 0; i < 3; ++i) Algos[i]->seed = static_cast<boost::random::mt19937::result_type>(roll_die());
+    for(int i = 0; i < 3; ++i)
+    {
+        Algos[i]->Projections = &Projections;
+        Algos[i]->nThreads = (nThreads/3 > 1) ? nThreads/3 : 1;
+        started[i] = ( pthread_create(&threads[i], NULL, FastOPTICS_thread, Algos[i]) == 0 );
+        if(!started[i]) Algos[i]->Execute_FastOPTICS(Projections, Algos[i]->nThreads);
+    }
+    for(int i = 0; i < 3; ++i) if(started[i]) pthread_join(threads[i], NULL);
+    // Algo4.Execute_FastOPTICS(Projections, nThreads);
+    // Algo5.Execute_FastOPTICS(Projections, nThreads);
+
+    // output the projected distances
+    Projections.output_projected_distance(end_strfile, tmp_end_strfile, Algo1.get_minPoints());
+    Projections.output_projected_distance(end_strfile, tmp_end_strfile, Algo2.get_minPoints());
+    Projections.output_projected_distance(end_strfile, tmp_end_strfile, Algo3.get_minPoints());
 
     // Algo1.output_OPTICS(end_strfile, tmp_end_strfile);
     // Algo2.output_OPTICS(end_strfile, tmp_end_strfile);
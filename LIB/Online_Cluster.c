@@ -0,0 +1,344 @@
+#include "gaboom.h"
+#include "boinc.h"
+
+// populations whose hashes are kept (without SNAPSIZE) before the folded poses are forgotten
+# define OL_SIGNATURE_RING 100
+
+/*****************************************************************************
+ * Online (leader) clustering : poses are folded in clusters as they are saved
+ * by the GA (instead of keeping every chromosome in chrom_snapshot).
+ * A pose joins the nearest cluster whose leader (first pose of the cluster)
+ * is within FA->cluster_rmsd, otherwise it becomes the leader of a new cluster.
+ * Clusters only keep their leader coordinates, the genes of their lowest CF
+ * pose and the Boltzmann sums needed for their free energy.
+ * Exact duplicates are skipped with the hashes of the poses recently folded :
+ * past maxSignatures, only the hashes of the Representatives are kept.
+ *****************************************************************************/
+OLclustering* build_Online_clustering(FA_Global* FA, GB_Global* GB, atom* atoms, resid* residue)
+{
+	OLclustering* OL = new OLclustering;
+
+	OL->nClusters = 0;
+	OL->maxClusters = 0;
+	OL->nAtoms = residue[atoms[FA->map_par[0].atm].ofres].latm[0] - residue[atoms[FA->map_par[0].atm].ofres].fatm[0] + 1;
+	OL->num_genes = GB->num_genes;
+	OL->nPoses = 0;
+	OL->nDuplicates = 0;
+	OL->PartitionFunction = 0.0;
+	OL->Clust = NULL;
+	OL->Center = NULL;
+	OL->Representative = NULL;
+
+	// bounded like chrom_snapshot (SNAPSIZE), at least two populations
+	OL->maxSignatures = (GB->snapshot_size > 0) ? GB->snapshot_size : OL_SIGNATURE_RING*GB->num_chrom;
+	if(OL->maxSignatures < 2*GB->num_chrom) OL->maxSignatures = 2*GB->num_chrom;
+
+	OL->Coord = (float*)malloc(3*MAX_ATM_HET*sizeof(float));
+	if(!OL->Coord)
+	{
+		fprintf(stderr,"ERROR: memory allocation error for online clustering coordinates.\n");
+		Terminate(2);
+	}
+
+	Online_cluster_grow(OL);
+
+	return OL;
+}
+
+
+int Online_cluster_grow(OLclustering* OL)
+{
+	int maxClusters = (OL->maxClusters > 0) ? 2*OL->maxClusters : 64;
+
+	OLcluster* Clust = (OLcluster*)realloc(OL->Clust, maxClusters*sizeof(OLcluster));
+	float* Center = (float*)realloc(OL->Center, (size_t)maxClusters*3*OL->nAtoms*sizeof(float));
+	gene* Representative = (gene*)realloc(OL->Representative, (size_t)maxClusters*OL->num_genes*sizeof(gene));
+
+	if(!Clust || !Center || !Representative)
+	{
+		fprintf(stderr,"ERROR: memory allocation error for online clusters (%d clusters).\n", maxClusters);
+		Terminate(2);
+	}
+
+	OL->Clust = Clust;
+	OL->Center = Center;
+	OL->Representative = Representative;
+	OL->maxClusters = maxClusters;
+
+	return maxClusters;
+}
+
+
+void free_Online_clustering(OLclustering* OL)
+{
+	if(OL == NULL) return;
+
+	if(OL->Clust != NULL) free(OL->Clust);
+	if(OL->Center != NULL) free(OL->Center);
+	if(OL->Representative != NULL) free(OL->Representative);
+	if(OL->Coord != NULL) free(OL->Coord);
+
+	delete OL;
+}
+
+
+// folds num_chrom chromosomes in the clusters, returns the number of unique poses added
+int Online_cluster_add(FA_Global* FA, GB_Global* GB, OLclustering* OL, const chromosome* chrom, const genlim* gene_lim, atom* atoms, resid* residue, gridpoint* cleftgrid, int num_chrom)
+{
+	int i,j,k;
+	int nAdded = 0;
+	int nCoord = 3*OL->nAtoms;
+	int nearest;
+	float d, dist, minDist;
+	float* pCenter;
+	double weight;
+	OLcluster* pClust;
+
+	// squared RMSD threshold summed over all atoms
+	const float threshold = FA->cluster_rmsd * FA->cluster_rmsd * (float)OL->nAtoms;
+
+	for(i = 0; i < num_chrom; ++i)
+	{
+		// skip exact duplicates (e.g. elite individuals surviving through generations)
+		if(!OL->signatures.insert(hash_genes(chrom[i].genes, OL->num_genes)).second)
+		{
+			OL->nDuplicates++;
+			continue;
+		}
+
+		// build the ligand cartesian coordinates of the pose
+		calc_rmsd_chrom(FA,GB,chrom,gene_lim,atoms,residue,cleftgrid,OL->num_genes,i,i,OL->Coord,NULL,false);
+
+		// nearest leader within cluster_rmsd (partial sums are abandoned once above the best distance)
+		nearest = -1;
+		minDist = threshold;
+		for(j = 0; j < OL->nClusters; ++j)
+		{
+			pCenter = &OL->Center[(size_t)OL->Clust[j].index*nCoord];
+			for(k = 0, dist = 0.0f; k < nCoord && dist <= minDist; ++k)
+			{
+				d = OL->Coord[k] - pCenter[k];
+				dist += d*d;
+			}
+			if(dist <= minDist)
+			{
+				minDist = dist;
+				nearest = j;
+			}
+		}
+
+		// the pose becomes the leader of a new cluster
+		if(nearest == -1)
+		{
+			if(OL->nClusters == OL->maxClusters) Online_cluster_grow(OL);
+
+			nearest = OL->nClusters++;
+			pClust = &OL->Clust[nearest];
+			pClust->index = nearest;
+			pClust->Frequency = 0;
+			pClust->weightSum = 0.0;
+			pClust->enthalpySum = 0.0;
+			pClust->entropySum = 0.0;
+			pClust->totCF = 0.0;
+			pClust->lowestCF = DBL_MAX;
+			pClust->lowestEvalue = DBL_MAX;
+			pClust->energy = 0.0;
+			memcpy(&OL->Center[(size_t)nearest*nCoord], OL->Coord, nCoord*sizeof(float));
+		}
+
+		pClust = &OL->Clust[nearest];
+		weight = pow( E, ((-1.0) * FA->beta * chrom[i].app_evalue) );
+
+		pClust->Frequency++;
+		pClust->totCF += chrom[i].app_evalue;
+		pClust->weightSum += weight;
+		pClust->enthalpySum += weight * chrom[i].app_evalue;
+		if(weight > 0.0) pClust->entropySum += weight * log(weight);
+		OL->PartitionFunction += weight;
+
+		if(chrom[i].app_evalue < pClust->lowestCF)
+		{
+			pClust->lowestCF = chrom[i].app_evalue;
+			pClust->lowestEvalue = chrom[i].evalue;
+			memcpy(&OL->Representative[(size_t)pClust->index*OL->num_genes], chrom[i].genes, OL->num_genes*sizeof(gene));
+		}
+
+		OL->nPoses++;
+		nAdded++;
+	}
+
+	trim_Online_signatures(OL);
+
+	return nAdded;
+}
+
+
+// keeps only the hashes of the Representatives when there are more than maxSignatures others
+void trim_Online_signatures(OLclustering* OL)
+{
+	if((long)OL->signatures.size() <= (long)OL->maxSignatures + OL->nClusters) return;
+
+	OL->signatures.clear();
+	for(int j=0; j<OL->nClusters; j++) OL->signatures.insert(hash_genes(&OL->Representative[(size_t)OL->Clust[j].index*OL->num_genes],OL->num_genes));
+}
+
+
+int OnlineClusterComparator(const void* a, const void* b)
+{
+	const OLcluster* x = (const OLcluster*) a;
+	const OLcluster* y = (const OLcluster*) b;
+	if(x->energy > y->energy) return 1;
+	else if(x->energy < y->energy) return -1;
+	else return 0;
+}
+
+
+void Online_cluster(FA_Global* FA, GB_Global* GB, VC_Global* VC, OLclustering* OL, genlim* gene_lim, atom* atoms, resid* residue, gridpoint* cleftgrid, char* end_strfile, char* tmp_end_strfile, char* dockinp, char* gainp)
+{
+	bool Hungarian = false;
+	int i,j,k;
+	cfstr cf;                                /* complementarity function value */
+	resid *res_ptr = NULL;
+	cfstr* cf_ptr = NULL;
+
+	FILE* outfile_ptr = NULL;
+
+	int nCoord = 3*OL->nAtoms;
+	int num_of_results = FA->max_results;
+	float d, rmsd;
+	float *iCenter, *jCenter;
+	double Z = OL->PartitionFunction;
+	double enthalpy, entropy;
+	OLcluster* pClust;
+
+	char sufix[25];
+	char remark[MAX_REMARK];
+	char tmpremark[MAX_REMARK];
+
+	printf("%ld unique poses folded in %d clusters (%ld duplicates skipped)\n", OL->nPoses, OL->nClusters, OL->nDuplicates);
+
+	if(FA->temperature && Z == 0.0)
+	{
+		fprintf(stderr,"ERROR: The Partition Function is NULL in the clustering step.\n");
+		Terminate(2);
+	}
+
+	// ordering : lowest free energy (conformational entropy considered) or lowest CF of the Representative
+	for(i = 0; i < OL->nClusters; ++i)
+	{
+		pClust = &OL->Clust[i];
+		if(FA->temperature)
+		{
+			enthalpy = pClust->enthalpySum / Z;
+			entropy = -(pClust->entropySum - pClust->weightSum * log(Z)) / Z;
+			pClust->energy = enthalpy - FA->temperature * entropy;
+		}
+		else pClust->energy = pClust->lowestCF;
+	}
+	qsort(OL->Clust, OL->nClusters, sizeof(OLcluster), OnlineClusterComparator);
+
+	if(OL->nClusters < num_of_results){num_of_results=OL->nClusters;}
+
+	// print cluster information
+	sprintf(sufix,".cad");
+	strcpy(tmp_end_strfile,end_strfile);
+	strcat(tmp_end_strfile,sufix);
+
+	if(!OpenFile_B(tmp_end_strfile,"w",&outfile_ptr))
+	{
+		Terminate(6);
+	}
+	else
+	{
+		for(i=0;i<num_of_results;++i)
+		{
+			fprintf(outfile_ptr,"Cluster %d: TOP=%d TCF=%f ACF=%f freq=%d\n",i,
+				OL->Clust[i].index,OL->Clust[i].lowestCF,
+				(FA->temperature ? OL->Clust[i].energy : OL->Clust[i].totCF), OL->Clust[i].Frequency);
+		}
+		if(num_of_results > 1)
+		{
+			fprintf(outfile_ptr,"RMSD between clusters\n");
+			for(i=0;i<num_of_results;++i)
+			{
+				iCenter = &OL->Center[(size_t)OL->Clust[i].index*nCoord];
+				for(j=i+1;j<num_of_results;++j)
+				{
+					jCenter = &OL->Center[(size_t)OL->Clust[j].index*nCoord];
+					for(k=0, rmsd=0.0f; k<nCoord; ++k) { d = iCenter[k] - jCenter[k]; rmsd += d*d; }
+					fprintf(outfile_ptr,"rmsd(%d,%d)=%f\n",i,j,sqrtf(rmsd/(float)OL->nAtoms));
+				}
+			}
+		}
+	}
+	CloseFile_B(&outfile_ptr,"w");
+
+	printf("num_of_clusters=%d num_of_results=%d\n",OL->nClusters,num_of_results);
+
+	for(j=0;j<num_of_results;++j)
+	{
+		pClust = &OL->Clust[j];
+
+		for(k=0; k<GB->num_genes; ++k)
+		{
+			FA->opt_par[k] = OL->Representative[(size_t)pClust->index*OL->num_genes+k].to_ic;
+		}
+
+		cf=ic2cf(FA,VC,atoms,residue,cleftgrid,GB->num_genes,FA->opt_par);
+
+		strcpy(remark,"REMARK optimized structure\n");
+
+		sprintf(tmpremark,"REMARK Online leader clustering algorithm used to output the lowest CF as Binding Mode representative\n");
+		strcat(remark,tmpremark);
+		sprintf(tmpremark,"REMARK CF=%8.5f\n",get_cf_evalue(&cf));
+		strcat(remark,tmpremark);
+		sprintf(tmpremark,"REMARK CF.app=%8.5f\n",get_apparent_cf_evalue(&cf));
+		strcat(remark,tmpremark);
+
+		for(i=0;i<FA->num_optres;++i)
+		{
+			res_ptr = &residue[FA->optres[i].rnum];
+			cf_ptr = &FA->optres[i].cf;
+
+			sprintf(tmpremark,"REMARK optimizable residue %s %c %d\n",
+				res_ptr->name,res_ptr->chn,res_ptr->number);
+			strcat(remark,tmpremark);
+
+			sprintf(tmpremark,"REMARK CF.com=%8.5f\n",cf_ptr->com);
+			strcat(remark,tmpremark);
+			sprintf(tmpremark,"REMARK CF.sas=%8.5f\n",cf_ptr->sas);
+			strcat(remark,tmpremark);
+			sprintf(tmpremark,"REMARK CF.wal=%8.5f\n",cf_ptr->wal);
+			strcat(remark,tmpremark);
+			sprintf(tmpremark,"REMARK CF.con=%8.5f\n",cf_ptr->con);
+			strcat(remark,tmpremark);
+			sprintf(tmpremark,"REMARK Residue has an overall SAS of %.3f\n",cf_ptr->totsas);
+			strcat(remark,tmpremark);
+		}
+
+		sprintf(tmpremark,"REMARK Cluster %d: Best CF in Cluster:%8.5f Cluster Total CF:%8.5f Frequency:%d\n",
+			j,pClust->lowestCF,(FA->temperature ? pClust->energy : pClust->totCF),pClust->Frequency);
+		strcat(remark,tmpremark);
+		for(i=0;i<FA->npar;++i)
+		{
+			sprintf(tmpremark,"REMARK [%8.3f]\n",FA->opt_par[i]);
+			strcat(remark,tmpremark);
+		}
+		if(FA->refstructure == 1){
+			Hungarian = false;
+			sprintf(tmpremark,"REMARK %8.5f RMSD to ref. structure (no symmetry correction)\n",
+				calc_rmsd(FA,atoms,residue,cleftgrid,FA->npar,FA->opt_par, Hungarian));
+			strcat(remark,tmpremark);
+			Hungarian = true;
+			sprintf(tmpremark,"REMARK %8.5f RMSD to ref. structure     (symmetry corrected)\n",
+				calc_rmsd(FA,atoms,residue,cleftgrid,FA->npar,FA->opt_par, Hungarian));
+			strcat(remark,tmpremark);
+		}
+		sprintf(tmpremark,"REMARK inputs: %s & %s\n",dockinp,gainp);
+		strcat(remark,tmpremark);
+		sprintf(sufix,"_%d.pdb",j);
+		strcpy(tmp_end_strfile,end_strfile);
+		strcat(tmp_end_strfile,sufix);
+		write_pdb(FA,atoms,residue,tmp_end_strfile,remark);
+	}
+}
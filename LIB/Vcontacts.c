@@ -1663,12 +1663,15 @@ atomindex* index_protein(FA_Global* FA,atom* atoms,resid* residue,atomsas* Calc,
 		
 		for(atmi=0;atmi<atmcnt;++atmi){
 			// if previous indexing is different need to reset all OR
-			// only scorable atoms might need a box change
-			if(box != prev_box || Calc[atmi].score){
+			// only scorable atoms might need a box change OR
+			// the atoms moved by another backbone (normal modes)
+			if(box != prev_box || Calc[atmi].score || FA->nma_moved == 2 ||
+			   (FA->nma_moved && FA->nma_insite[Calc[atmi].atom-atoms])){
 				Calc[atmi].boxnum = -1;
 			}
 		}
 	}
+	FA->nma_moved = 0;
 	memset(box,0,dim3*sizeof(atomindex));
 	
 	//int nbox=0;
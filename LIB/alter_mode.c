@@ -6,32 +6,127 @@
 /* select modes and amplitudes of vectors    */
 /* The function takes for arguments the      */
 /* initial protein conformation              */
+/* Only the atoms of the binding site are    */
+/* moved unless whole is set (output)        */
+/* complete_mode moves the rest of the       */
+/* protein before writing a result           */
 /*********************************************/
 
-void alter_mode(atom* atoms,resid* residue, float *grid, int res_cnt, int nmodes) {
-	int i,j,k,l;
-	int rot;
+// displaces the first n packed atoms by the row of the normal grid
+static void displace(FA_Global* FA, int normalmode, int n, float* coor) {
+	int i,k;
+	int stride = 3*FA->nma_natoms;
 
 	float amplitude;
-  
-	for (i=1;i<=res_cnt;++i) {
-		if(residue[i].type == 1){ continue; }
-    
-		rot=residue[i].rot;
-		for(j=residue[i].fatm[rot];j<=residue[i].latm[rot];++j){
-
-			// reset original coordinates
-			for(l=0;l<3;l++){ atoms[j].coor[l] = atoms[j].coor_ori[l]; }
-
-			for (k=0;k<nmodes;++k) {
-				amplitude = grid[k];
-				//printf("For atom[%d] Ampli:%f\n",j,amplitude);
-	
-				for(l=0;l<3;l++){ atoms[j].coor[l] += amplitude * atoms[j].eigen[k][l]; }
-			} 
+	const float* eigen;
+
+	// reset original coordinates
+	memcpy(coor,FA->nma_coor_ori,3*n*sizeof(float));
+
+	// one contiguous (vectorized) axpy per mode
+	for (k=0;k<FA->normal_modes;++k) {
+		amplitude = FA->normal_grid[normalmode][k];
+		eigen = &FA->nma_eigen[(size_t)k*stride];
+
+		for(i=0;i<3*n;++i){ coor[i] += amplitude * eigen[i]; }
+	}
+}
+
+// displaced binding site of the row, from the cache when it was used recently
+static const float* displaced_site(FA_Global* FA, int normalmode) {
+	nmacache* cache = FA->nma_cache;
+	int s;
+
+	if(cache == NULL){
+		displace(FA,normalmode,FA->nma_nsite,FA->nma_coor);
+		return FA->nma_coor;
+	}
+
+	s = cache->slot[normalmode];
+	if(s != -1){
+		cache->hits++;
+	}else{
+		// least recently used slot
+		s = 0;
+		for(int i=1;i<cache->size;i++){
+			if(cache->stamp[i] < cache->stamp[s]) s = i;
+		}
+		if(cache->row[s] != -1) cache->slot[cache->row[s]] = -1;
+
+		displace(FA,normalmode,FA->nma_nsite,&cache->coor[(size_t)s*cache->stride]);
+		cache->row[s] = normalmode;
+		cache->slot[normalmode] = s;
+		cache->misses++;
+	}
+	cache->stamp[s] = ++cache->clock;
+
+	return &cache->coor[(size_t)s*cache->stride];
+}
+
+void alter_mode(FA_Global* FA, atom* atoms, int normalmode, int whole) {
+	int i,j,l;
+	int n = whole ? FA->nma_natoms : FA->nma_nsite;
+	const float* coor;
+
+	if(normalmode == FA->nma_applied && (FA->nma_applied_whole || !whole)){
+		// the protein already has this backbone : only the optimized residues
+		// (rebuilt since) are reset
+		n = FA->nma_noptres;
+		coor = FA->nma_coor;
+		if(FA->nma_cache != NULL && !FA->nma_applied_whole){
+			// slot of the applied row (not a lookup : not counted as a hit)
+			int s = FA->nma_cache->slot[normalmode];
+			FA->nma_cache->stamp[s] = ++FA->nma_cache->clock;
+			coor = &FA->nma_cache->coor[(size_t)s*FA->nma_cache->stride];
 		}
+		for(i=0;i<n;++i){
+			j = FA->nma_atoms[i];
+			for(l=0;l<3;l++){ atoms[j].coor[l] = coor[3*i+l]; }
+		}
+		return;
+	}
+
+	if(whole){
+		displace(FA,normalmode,n,FA->nma_coor);
+		coor = FA->nma_coor;
+	}else{
+		coor = displaced_site(FA,normalmode);
+	}
+
+	for(i=0;i<n;++i){
+		j = FA->nma_atoms[i];
+		for(l=0;l<3;l++){ atoms[j].coor[l] = coor[3*i+l]; }
 	}
-  
+
+	FA->nma_applied = normalmode;
+	FA->nma_applied_whole = whole;
+	if(whole || FA->nma_moved == 2) FA->nma_moved = 2;
+	else FA->nma_moved = 1;
+
 	return;
 }
 
+// deforms the atoms outside the binding site by the applied row (output) :
+// the binding site, flexible side-chains included, keeps its coordinates
+void complete_mode(FA_Global* FA, atom* atoms) {
+	int i,j,l;
+
+	if(FA->nma_applied == -1 || FA->nma_applied_whole) return;
+
+	displace(FA,FA->nma_applied,FA->nma_natoms,FA->nma_coor);
+	for(i=FA->nma_nsite;i<FA->nma_natoms;++i){
+		j = FA->nma_atoms[i];
+		for(l=0;l<3;l++){ atoms[j].coor[l] = FA->nma_coor[3*i+l]; }
+	}
+
+	FA->nma_applied_whole = 1;
+	FA->nma_moved = 2;
+}
+
+void print_nma_cache(const FA_Global* FA) {
+
+	if(FA->nma_cache == NULL) return;
+
+	printf("normal-mode cache (%d rows): %ld binding sites reused, %ld displaced\n",
+	       FA->nma_cache->size, FA->nma_cache->hits, FA->nma_cache->misses);
+}
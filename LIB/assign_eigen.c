@@ -1,66 +1,357 @@
 #include "flexaid.h"
 #include "boinc.h"
+#include <float.h>
 
-void assign_eigen(FA_Global *FA,atom* atoms,resid* residue, int res_cnt, int nmodes){
-    int i,j,k,l;
-    
-    for(i=1;i<=res_cnt;i++){
-        
-        // Do not apply eigenvectors on HET groups
-        if(residue[i].type == 1)
-            continue;
-        
-        for(j=residue[i].fatm[0];j<=residue[i].latm[0];j++){
-            
-            atoms[j].eigen = (float**)malloc(nmodes*sizeof(float*));
-            if (!atoms[j].eigen){
-                fprintf(stderr,"ERROR: memory allocation error for eigen\n");
-                Terminate(2);
-            }      
-            memset(atoms[j].eigen,NULL,nmodes*sizeof(float*));
-            
-            for(k=0;k<nmodes;k++){
-                atoms[j].eigen[k] = (float*)malloc(3*sizeof(float));
-                if(!atoms[j].eigen[k]){
-                    fprintf(stderr,"ERROR: memory allocation error for eigen\n");
-                    Terminate(2);
-                }
-                memset(atoms[j].eigen[k],0,3*sizeof(float));
-            }
-            
-            for(k=0;k<nmodes;k++){
-                
-                if(FA->supernode){
-                    // N or H
-                    if ((strncmp(atoms[j].name," N  ",4) == 0) || (strncmp(atoms[j].name," H  ",4) == 0)){
-                        for(l=0;l<3;l++){
-                            atoms[j].eigen[k][l]=FA->eigenvector[(i-1)*9+l][k];
-                            //printf("assigned %.4f to atom[%d]\n",atoms[j].eigen[k][l],atoms[j].number);
-                        }
-                        // C, O or OXT
-                    }else if ((strncmp(atoms[j].name," C  ",4) == 0) || (strncmp(atoms[j].name," O  ",4) == 0) ||
-                              (strncmp(atoms[j].name," OXT",4) == 0)){
-                        for(l=0;l<3;l++){
-                            atoms[j].eigen[k][l]=FA->eigenvector[(i-1)*9+6+l][k];
-                            //printf("assigned %.4f to atom[%d]\n",atoms[j].eigen[k][l],atoms[j].number);
-                        }
-                    }else{ // side-chain atoms + CA + HA
-                        for(l=0;l<3;l++){
-                            atoms[j].eigen[k][l]=FA->eigenvector[(i-1)*9+3+l][k];
-                            //printf("assigned %.4f to atom[%d]\n",atoms[j].eigen[k][l],atoms[j].number);
-                        }
-                    }
-                }else{
-                    
-                    // all atoms from a residue have the same eigenvectors
-                    for(l=0;l<3;l++){
-                        atoms[j].eigen[k][l]=FA->eigenvector[(i-1)*3+l][k];
-                        //printf("assigned %.4f to atom[%d]\n",atoms[j].eigen[k][l],atoms[j].number);
-                    }
-                }
-            }
-        }
-    }
-    
-    return;
+// alignment (in bytes) of the packed eigen vectors and coordinates
+#define NMA_ALIGN 64
+
+/****************************************************************************
+ * The eigen vectors of the protein atoms (HET groups excluded, rotamers
+ * included) are packed mode by mode, [modes][atoms][3] : the displacement
+ * of alter_mode is one contiguous axpy per mode. The atoms of the binding
+ * site come first (those of the optimized residues leading), they are the
+ * only ones moved when scoring (ic2cf) :
+ * the other atoms cannot come in contact with the ligand or the flexible
+ * side-chains whatever the amplitudes of the modes. The binding site is
+ *  - the atoms within reach of the ligand placed on a grid point : the
+ *    bonds from its anchor atom (upper bound of the distance in any
+ *    conformation), plus the contact range of two atoms (radii and
+ *    solvent) and the largest displacement of the atom by the modes,
+ *  - the atoms within reach of the flexible side-chains (bonds from CA),
+ *  - the atoms of the flexible residues, the constrained atoms and the
+ *    reference atoms of the optimized residues.
+ * NMACUT <d> replaces the reach of the ligand by d, NMACUT 0 and a ligand
+ * not placed on the grid move the whole protein.
+ * The displaced binding sites of the last NMACHE rows of the normal grid
+ * used are kept (least recently used evicted), NMACHE 0 disables the cache.
+ ****************************************************************************/
+
+// aligned block of n floats set to 0
+static float* alloc_nma_block(size_t n)
+{
+	void* block = NULL;
+	size_t size = (n > 0 ? n : 1)*sizeof(float);
+
+#ifdef _WIN32
+	block = _aligned_malloc(size,NMA_ALIGN);
+#else
+	if(posix_memalign(&block,NMA_ALIGN,size) != 0) block = NULL;
+#endif
+	if(block == NULL){
+		fprintf(stderr,"ERROR: memory allocation error for eigen\n");
+		Terminate(2);
+	}
+	memset(block,0,size);
+
+	return (float*)block;
+}
+
+static void free_nma_block(float* block)
+{
+	if(block == NULL) return;
+
+#ifdef _WIN32
+	_aligned_free(block);
+#else
+	free(block);
+#endif
+}
+
+// eigen vector of atom j for mode k (the per-residue rows of read_eigen)
+static float get_eigen(FA_Global* FA, atom* atoms, int j, int k, int l)
+{
+	int i = atoms[j].ofres;
+	int row;
+
+	if(FA->supernode){
+		// N or H
+		if ((strncmp(atoms[j].name," N  ",4) == 0) || (strncmp(atoms[j].name," H  ",4) == 0)){
+			row = (i-1)*9+l;
+		// C, O or OXT
+		}else if ((strncmp(atoms[j].name," C  ",4) == 0) || (strncmp(atoms[j].name," O  ",4) == 0) ||
+			  (strncmp(atoms[j].name," OXT",4) == 0)){
+			row = (i-1)*9+6+l;
+		}else{ // side-chain atoms + CA + HA
+			row = (i-1)*9+3+l;
+		}
+	}else{
+		// all atoms from a residue have the same eigenvectors
+		row = (i-1)*3+l;
+	}
+
+	// rows not in the file are null (as allocated by read_eigen)
+	return (row >= 0 && row < FA->num_eigen) ? FA->eigenvector[row][k] : 0.0f;
+}
+
+/* longest path through the bonds from atom 'from' to the atoms fatm..latm :
+   bounds their distance to it whatever the dihedrals. -1 when an atom is not connected */
+static float bond_reach(atom* atoms, int from, int fatm, int latm)
+{
+	int n = latm-fatm+1;
+	int i,j,b;
+	float reach=0.0f;
+
+	std::vector<float> path(n,FLT_MAX);
+	std::vector<char> done(n,0);
+	path[from-fatm] = 0.0f;
+
+	// Dijkstra (the molecules are small)
+	for(;;){
+		int best = -1;
+		for(i=0;i<n;i++){
+			if(!done[i] && path[i] < FLT_MAX && (best == -1 || path[i] < path[best])) best = i;
+		}
+		if(best == -1) break;
+
+		done[best] = 1;
+		if(path[best] > reach) reach = path[best];
+
+		j = best+fatm;
+		for(b=1;b<=atoms[j].bond[0] && b<7;b++){
+			int k = atoms[j].bond[b];
+			if(k < fatm || k > latm || done[k-fatm]) continue;
+
+			float length = path[best] + sqrtf(distance2(atoms[j].coor_ori,atoms[k].coor_ori));
+			if(length < path[k-fatm]) path[k-fatm] = length;
+		}
+	}
+
+	for(i=0;i<n;i++){
+		if(!done[i]) return -1.0f;
+	}
+
+	return reach;
+}
+
+// atom named name in the residue (-1 when absent)
+static int residue_atom(atom* atoms, resid* residue, int r, const char* name)
+{
+	for(int j=residue[r].fatm[0];j<=residue[r].latm[0];j++){
+		if(!strcmp(atoms[j].name,name)) return j;
+	}
+
+	return -1;
+}
+
+void assign_eigen(FA_Global *FA,atom* atoms,resid* residue,const gridpoint* cleftgrid){
+	int i,j,k,l,r,rot;
+	int nmodes = FA->normal_modes;
+	int natoms = 0;
+
+	// protein atoms of all rotamers
+	std::vector<int> protein;
+	for(i=1;i<=FA->res_cnt;i++){
+
+		// Do not apply eigenvectors on HET groups
+		if(residue[i].type == 1)
+			continue;
+
+		for(rot=0;rot<=residue[i].trot;rot++){
+			for(j=residue[i].fatm[rot];j<=residue[i].latm[rot];j++){
+				protein.push_back(j);
+			}
+		}
+	}
+	natoms = (int)protein.size();
+
+	// largest displacement of each atom by the amplitudes of the grid
+	std::vector<float> amplitude(nmodes,0.0f);
+	for(i=0;i<FA->normal_grid_points;i++){
+		for(k=0;k<nmodes;k++){
+			if(fabs(FA->normal_grid[i][k]) > amplitude[k]) amplitude[k] = fabs(FA->normal_grid[i][k]);
+		}
+	}
+
+	std::vector<float> displacement(FA->atm_cnt+1,0.0f);
+	float max_displacement = 0.0f;
+	for(i=0;i<natoms;i++){
+		j = protein[i];
+		float d = 0.0f;
+		for(k=0;k<nmodes;k++){
+			float e[3];
+			for(l=0;l<3;l++) e[l] = get_eigen(FA,atoms,j,k,l);
+			d += amplitude[k]*sqrtf(e[0]*e[0]+e[1]*e[1]+e[2]*e[2]);
+		}
+		displacement[j] = d;
+		if(d > max_displacement) max_displacement = d;
+	}
+
+	// contact range of two atoms
+	float max_radius = 0.0f;
+	for(j=1;j<=FA->atm_cnt;j++){
+		if(atoms[j].radius > max_radius) max_radius = atoms[j].radius;
+	}
+	float contact = 2.0f*(max_radius+Rw);
+
+	// reach of the ligand from the grid points
+	float ligand_reach = -1.0f;
+	int anchor = -1;
+	for(i=0;i<FA->npar;i++){
+		if(FA->map_par[i].typ == -1) anchor = FA->map_par[i].atm;
+	}
+	// (the anchor is built on the grid point from the fixed frame of FA->ori)
+	if(FA->translational && anchor != -1 && atoms[anchor].rec[0] == 0 && cleftgrid != NULL){
+		if(FA->nma_cutoff > 0.0f){
+			ligand_reach = FA->nma_cutoff;
+		}else if(FA->nma_cutoff < 0.0f){
+			r = atoms[anchor].ofres;
+			ligand_reach = bond_reach(atoms,anchor,residue[r].fatm[0],residue[r].latm[0]);
+		}
+	}
+
+	std::vector<char> site(FA->atm_cnt+1,ligand_reach < 0.0f);
+
+	if(ligand_reach >= 0.0f){
+		// flexible side-chains : CA and reach of the side-chain
+		std::vector<int> flex_ca;
+		std::vector<float> flex_reach;
+		for(i=0;i<FA->num_optres;i++){
+			r = FA->optres[i].rnum;
+			if(FA->optres[i].type != 0) continue;
+
+			int ca = residue_atom(atoms,residue,r," CA ");
+			float reach = (ca != -1) ? bond_reach(atoms,ca,residue[r].fatm[0],residue[r].latm[0]) : -1.0f;
+			if(reach < 0.0f){
+				// not connected : the whole protein moves
+				site.assign(FA->atm_cnt+1,1);
+				break;
+			}
+			flex_ca.push_back(ca);
+			flex_reach.push_back(reach);
+		}
+
+		for(i=0;i<natoms;i++){
+			j = protein[i];
+			if(site[j]) continue;
+
+			float d_j = displacement[j];
+
+			if(atoms[j].optres != NULL || residue[atoms[j].ofres].trot > 0 || atoms[j].ncons > 0){
+				site[j] = 1;
+				continue;
+			}
+
+			for(k=1;k<FA->num_grd && !site[j];k++){
+				float cutoff = ligand_reach+contact+d_j;
+				if(distance2(atoms[j].coor_ori,cleftgrid[k].coor) <= cutoff*cutoff) site[j] = 1;
+			}
+
+			for(k=0;k<(int)flex_ca.size() && !site[j];k++){
+				float cutoff = flex_reach[k]+contact+d_j+max_displacement;
+				if(distance2(atoms[j].coor_ori,atoms[flex_ca[k]].coor_ori) <= cutoff*cutoff) site[j] = 1;
+			}
+		}
+
+		// the optimized residues are rebuilt from their reference atoms
+		for(j=1;j<=FA->atm_cnt;j++){
+			if(atoms[j].optres == NULL) continue;
+			for(l=0;l<3;l++){
+				if(atoms[j].rec[l] > 0 && atoms[j].rec[l] <= FA->atm_cnt) site[atoms[j].rec[l]] = 1;
+			}
+		}
+	}
+
+	// binding site first
+	FA->nma_atoms = (int*)malloc((natoms > 0 ? natoms : 1)*sizeof(int));
+	if(!FA->nma_atoms){
+		fprintf(stderr,"ERROR: memory allocation error for eigen\n");
+		Terminate(2);
+	}
+
+	// the atoms of the optimized residues first (reset at every evaluation)
+	FA->nma_natoms = natoms;
+	FA->nma_nsite = 0;
+	for(i=0;i<natoms;i++){
+		if(site[protein[i]] && atoms[protein[i]].optres != NULL) FA->nma_atoms[FA->nma_nsite++] = protein[i];
+	}
+	FA->nma_noptres = FA->nma_nsite;
+	for(i=0;i<natoms;i++){
+		if(site[protein[i]] && atoms[protein[i]].optres == NULL) FA->nma_atoms[FA->nma_nsite++] = protein[i];
+	}
+	k = FA->nma_nsite;
+	for(i=0;i<natoms;i++){
+		if(!site[protein[i]]) FA->nma_atoms[k++] = protein[i];
+	}
+
+	FA->nma_eigen = alloc_nma_block((size_t)nmodes*3*natoms);
+	FA->nma_coor_ori = alloc_nma_block((size_t)3*natoms);
+	FA->nma_coor = alloc_nma_block((size_t)3*natoms);
+
+	for(i=0;i<natoms;i++){
+		j = FA->nma_atoms[i];
+		for(l=0;l<3;l++){
+			FA->nma_coor_ori[3*i+l] = atoms[j].coor_ori[l];
+			for(k=0;k<nmodes;k++){
+				FA->nma_eigen[(size_t)k*3*natoms+3*i+l] = get_eigen(FA,atoms,j,k,l);
+			}
+		}
+	}
+
+	FA->nma_insite = (char*)malloc((FA->atm_cnt+1)*sizeof(char));
+	if(!FA->nma_insite){
+		fprintf(stderr,"ERROR: memory allocation error for eigen\n");
+		Terminate(2);
+	}
+	memset(FA->nma_insite,0,(FA->atm_cnt+1)*sizeof(char));
+	for(i=0;i<FA->nma_nsite;i++) FA->nma_insite[FA->nma_atoms[i]] = 1;
+
+	// displaced binding sites by row of the normal grid
+	int size = FA->nma_cache_size < FA->normal_grid_points ? FA->nma_cache_size : FA->normal_grid_points;
+	if(size > 0 && FA->nma_nsite > 0){
+		nmacache* cache = (nmacache*)malloc(sizeof(nmacache));
+		if(!cache){
+			fprintf(stderr,"ERROR: memory allocation error for eigen\n");
+			Terminate(2);
+		}
+
+		cache->size = size;
+		cache->stride = (3*FA->nma_nsite+NMA_ALIGN/sizeof(float)-1)/(NMA_ALIGN/sizeof(float))*(NMA_ALIGN/sizeof(float));
+		cache->coor = alloc_nma_block((size_t)size*cache->stride);
+		cache->row = (int*)malloc(size*sizeof(int));
+		cache->stamp = (long*)malloc(size*sizeof(long));
+		cache->slot = (int*)malloc(FA->normal_grid_points*sizeof(int));
+		if(!cache->row || !cache->stamp || !cache->slot){
+			fprintf(stderr,"ERROR: memory allocation error for eigen\n");
+			Terminate(2);
+		}
+		for(i=0;i<size;i++){ cache->row[i] = -1; cache->stamp[i] = 0; }
+		for(i=0;i<FA->normal_grid_points;i++) cache->slot[i] = -1;
+		cache->clock = 0;
+		cache->hits = 0;
+		cache->misses = 0;
+
+		FA->nma_cache = cache;
+	}
+
+	if(FA->nma_nsite < natoms){
+		printf("normal modes move %d atoms of the binding site when scoring (%d protein atoms, displacement <= %.2f A)\n",
+		       FA->nma_nsite, natoms, max_displacement);
+	}else{
+		printf("normal modes move the %d protein atoms when scoring\n", natoms);
+	}
+
+	return;
+}
+
+void free_eigen(FA_Global* FA)
+{
+	if(FA->nma_atoms != NULL) free(FA->nma_atoms);
+	if(FA->nma_insite != NULL) free(FA->nma_insite);
+	if(FA->nma_cache != NULL){
+		free_nma_block(FA->nma_cache->coor);
+		free(FA->nma_cache->row);
+		free(FA->nma_cache->stamp);
+		free(FA->nma_cache->slot);
+		free(FA->nma_cache);
+	}
+	free_nma_block(FA->nma_eigen);
+	free_nma_block(FA->nma_coor_ori);
+	free_nma_block(FA->nma_coor);
+
+	FA->nma_atoms = NULL;
+	FA->nma_insite = NULL;
+	FA->nma_cache = NULL;
+	FA->nma_eigen = NULL;
+	FA->nma_coor_ori = NULL;
+	FA->nma_coor = NULL;
 }
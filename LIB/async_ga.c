@@ -0,0 +1,343 @@
+#include "gaboom.h"
+#include "boinc.h"
+
+#ifndef _WIN32
+# include <unistd.h>
+# include <errno.h>
+# include <signal.h>
+# include <sys/wait.h>
+# include <sys/select.h>
+#endif
+
+/*****************************************************************************
+ * Asynchronous steady-state GA (ASYNCWRK) : the scoring function is run by
+ * worker processes forked once the population is initialized (each worker has
+ * its own copy of atoms, residues, VC and FA). The master keeps every worker
+ * busy: as soon as an offspring is scored, it is inserted in the population
+ * (kept sorted by CF) and a new offspring is sent to the same worker.
+ *   STEADY : the offspring replaces the worst chromosome
+ *   BOOM   : the offspring replaces the worst chromosome only if it is better
+ * Every STEADNUM (or BOOMFRAC*NUMCHROM) insertions count as one generation :
+ * fitness (FITMODEL), selection table, snapshot, convergence and state files
+ * are then updated, without waiting for the offspring being scored.
+ *****************************************************************************/
+
+#ifndef _WIN32
+
+struct async_request{
+	int    local_search;		// run local_search on the offspring
+};
+
+struct async_response{
+	cfstr  cf;
+	double evalue;
+	double app_evalue;
+	long   nevals;			// evaluations done by the worker for this offspring
+};
+
+// reads or writes exactly size bytes (returns false on end of file or error)
+static bool async_read(int fd, void* buf, size_t size)
+{
+	char* p = (char*)buf;
+	while(size > 0){
+		ssize_t n = read(fd,p,size);
+		if(n < 0 && errno == EINTR) continue;
+		if(n <= 0) return false;
+		p += n; size -= (size_t)n;
+	}
+	return true;
+}
+
+static bool async_write(int fd, const void* buf, size_t size)
+{
+	const char* p = (const char*)buf;
+	while(size > 0){
+		ssize_t n = write(fd,p,size);
+		if(n < 0 && errno == EINTR) continue;
+		if(n <= 0) return false;
+		p += n; size -= (size_t)n;
+	}
+	return true;
+}
+
+// worker process : scores the offspring received until the master closes the pipe
+static void async_worker(FA_Global* FA,GB_Global* GB,VC_Global* VC,const genlim* gene_lim,
+			 atom* atoms,resid* residue,gridpoint* cleftgrid,unsigned int seed,int fd_in,int fd_out,
+			 cfstr (*target)(FA_Global*,VC_Global*,atom*,resid*,gridpoint*,int,double*))
+{
+	RNGType rng(seed);
+	boost::uniform_int<> one_to_max_int32( 1, MAX_RANDOM_VALUE );
+	boost::variate_generator< RNGType, boost::uniform_int<> > dice(rng, one_to_max_int32);
+
+	gene genes[MAX_NUM_GENES];
+	chromosome offspring;
+	async_request request;
+	async_response response;
+	long nevals;
+
+	offspring.genes = genes;
+
+	while(async_read(fd_in,&request,sizeof(request)) &&
+	      async_read(fd_in,genes,GB->num_genes*sizeof(gene)))
+	{
+		nevals = GB->num_evaluations;
+
+		offspring.cf = eval_chromosome(FA,GB,VC,gene_lim,atoms,residue,cleftgrid,genes,target);
+		offspring.evalue = get_cf_evalue(&offspring.cf);
+		offspring.app_evalue = get_apparent_cf_evalue(&offspring.cf);
+
+		if(request.local_search) local_search(FA,GB,VC,gene_lim,atoms,residue,cleftgrid,&offspring,dice,target);
+
+		response.cf = offspring.cf;
+		response.evalue = offspring.evalue;
+		response.app_evalue = offspring.app_evalue;
+		response.nevals = GB->num_evaluations - nevals;
+
+		if(!async_write(fd_out,&response,sizeof(response)) ||
+		   !async_write(fd_out,genes,GB->num_genes*sizeof(gene))) break;
+	}
+
+	close(fd_in);
+	close(fd_out);
+	_exit(0);
+}
+
+// inserts a scored offspring in the population sorted by CF, returns its position (-1 if rejected)
+static int async_insert(GB_Global* GB, chromosome* chrom, const gene* genes, const async_response* response, bool replace_worse)
+{
+	if(!replace_worse && response->evalue >= chrom[GB->num_chrom-1].evalue) return -1;
+
+	return insert_chrom(GB,chrom,genes,&response->cf,response->evalue,response->app_evalue);
+}
+
+static void async_stop_workers(int nworkers, const int* fd_to, const int* fd_from, const pid_t* pid, bool kill_workers)
+{
+	int w;
+
+	for(w=0;w<nworkers;w++){
+		if(kill_workers) kill(pid[w],SIGTERM);
+		close(fd_to[w]);
+	}
+	for(w=0;w<nworkers;w++){
+		waitpid(pid[w],NULL,0);
+		close(fd_from[w]);
+	}
+}
+
+#endif
+
+/* runs the whole GA asynchronously.
+   returns 1 when done, -1 when aborted (.abort) and 0 when the workers
+   could not be started (the generational GA is then used) */
+int async_GA(FA_Global* FA,GB_Global* GB,VC_Global* VC,chromosome* chrom,const genlim* gene_lim,
+	     atom* atoms,resid* residue,gridpoint* cleftgrid,
+	     boost::variate_generator< RNGType, boost::uniform_int<> > & dice,
+	     map<string, int> & duplicates,char* pausefile,char* abortfile,char* stopfile,int interval,
+	     time_t start,int* n_chrom_snapshot,
+	     cfstr (*target)(FA_Global*,VC_Global*,atom*,resid*,gridpoint*,int,double*))
+{
+#ifdef _WIN32
+	fprintf(stderr,"WARNING: ASYNCWRK is not available on Windows, using the generational GA.\n");
+	return 0;
+#else
+	int w,k,nworkers=0;
+	int nnew,gen=0;
+	int npick=0;
+	int print=0;
+	int state=0;
+	int attempts;
+	int save_num_chrom = (int)(GB->num_chrom*SAVE_CHROM_FRACTION);
+	long total,dispatched=0,inserted=0;
+	int inflight=0;
+	bool stop=false;
+	bool replace_worse = (strcmp(GB->rep_model,"STEADY")==0);
+	double mutprob = GB->mut_rate;
+	double crossprob = GB->cross_rate;
+
+	std::vector<int> fd_to(GB->async_workers), fd_from(GB->async_workers);
+	std::vector<pid_t> pid(GB->async_workers);
+	std::vector<char> busy(GB->async_workers,0);
+	std::vector<gene> sent((size_t)GB->async_workers*GB->num_genes);
+
+	gene chrop1_gen[MAX_NUM_GENES];
+	gene chrop2_gen[MAX_NUM_GENES];
+	gene received[MAX_NUM_GENES];
+	bool pending=false;
+	async_request request;
+	async_response response;
+	selection sel;
+	fd_set readfds;
+	int maxfd;
+
+	if(strcmp(GB->rep_model,"STEADY")==0){
+		nnew = GB->ssnum;
+	}else{
+		nnew = (int)(GB->pbfrac*(double)GB->num_chrom);
+	}
+	if(nnew > GB->num_chrom) nnew = GB->num_chrom;
+	if(nnew < 1) nnew = 1;
+	total = (long)nnew*(long)GB->max_generations;
+
+	// workers inherit the current state of the process
+	fflush(stdout);
+	fflush(stderr);
+	for(w=0;w<GB->async_workers;w++){
+		int to[2],from[2];
+
+		if(pipe(to) != 0) break;
+		if(pipe(from) != 0){ close(to[0]); close(to[1]); break; }
+
+		pid[w] = fork();
+		if(pid[w] < 0){
+			close(to[0]); close(to[1]); close(from[0]); close(from[1]);
+			break;
+		}
+
+		if(pid[w] == 0){
+			close(to[1]);
+			close(from[0]);
+			for(k=0;k<w;k++){ close(fd_to[k]); close(fd_from[k]); }
+			async_worker(FA,GB,VC,gene_lim,atoms,residue,cleftgrid,(unsigned int)dice()+w,to[0],from[1],target);
+		}
+
+		close(to[0]);
+		close(from[1]);
+		fd_to[w] = to[1];
+		fd_from[w] = from[0];
+		nworkers++;
+	}
+
+	if(nworkers == 0){
+		fprintf(stderr,"WARNING: could not start the asynchronous workers, using the generational GA.\n");
+		return 0;
+	}
+
+	// a worker that dies closes its pipe : writing to it must not kill the master
+	signal(SIGPIPE,SIG_IGN);
+
+	printf("asynchronous steady-state GA with %d workers (%d insertions per generation)\n", nworkers, nnew);
+
+	build_selection(GB,chrom,GB->num_chrom,2*nnew,dice,&sel);
+
+	while(1){
+
+		// keep every idle worker busy
+		for(w=0;w<nworkers && !stop && dispatched<total;w++){
+			if(busy[w]) continue;
+
+			gene* genes = &sent[(size_t)w*GB->num_genes];
+
+			for(attempts=0;;attempts++){
+				if(pending){
+					memcpy(genes,chrop2_gen,GB->num_genes*sizeof(gene));
+					pending = false;
+				}else{
+					make_offspring(FA,GB,chrom,residue,&sel,&npick,&mutprob,&crossprob,dice,chrop1_gen,chrop2_gen);
+					memcpy(genes,chrop1_gen,GB->num_genes*sizeof(gene));
+					pending = true;
+				}
+
+				string sig = generate_sig(genes,GB->num_genes);
+				if(GB->duplicates || attempts >= MAX_NUM_CHROM || duplicates.find(sig) == duplicates.end()){
+					duplicates[sig] = 1;
+					break;
+				}
+			}
+
+			request.local_search = (GB->ls_fraction > 0.0 && RandomDouble(dice()) < GB->ls_fraction);
+
+			if(!async_write(fd_to[w],&request,sizeof(request)) ||
+			   !async_write(fd_to[w],genes,GB->num_genes*sizeof(gene))){
+				fprintf(stderr,"ERROR: asynchronous worker %d terminated unexpectedly.\n", w);
+				async_stop_workers(nworkers,&fd_to[0],&fd_from[0],&pid[0],true);
+				Terminate(2);
+			}
+
+			busy[w] = 1;
+			inflight++;
+			dispatched++;
+		}
+
+		if(inflight == 0) break;
+
+		// wait for any scored offspring
+		FD_ZERO(&readfds);
+		maxfd = -1;
+		for(w=0;w<nworkers;w++){
+			if(busy[w]){
+				FD_SET(fd_from[w],&readfds);
+				if(fd_from[w] > maxfd) maxfd = fd_from[w];
+			}
+		}
+		if(select(maxfd+1,&readfds,NULL,NULL,NULL) < 0){
+			if(errno == EINTR) continue;
+			fprintf(stderr,"ERROR: could not wait for the asynchronous workers.\n");
+			async_stop_workers(nworkers,&fd_to[0],&fd_from[0],&pid[0],true);
+			Terminate(2);
+		}
+
+		for(w=0;w<nworkers;w++){
+			if(!busy[w] || !FD_ISSET(fd_from[w],&readfds)) continue;
+
+			if(!async_read(fd_from[w],&response,sizeof(response)) ||
+			   !async_read(fd_from[w],received,GB->num_genes*sizeof(gene))){
+				fprintf(stderr,"ERROR: asynchronous worker %d terminated unexpectedly.\n", w);
+				async_stop_workers(nworkers,&fd_to[0],&fd_from[0],&pid[0],true);
+				Terminate(2);
+			}
+			busy[w] = 0;
+			inflight--;
+
+			GB->num_evaluations += response.nevals;
+			// genes improved by the local search
+			if(memcmp(received,&sent[(size_t)w*GB->num_genes],GB->num_genes*sizeof(gene)) != 0){
+				duplicates[generate_sig(received,GB->num_genes)] = 1;
+			}
+
+			async_insert(GB,chrom,received,&response,replace_worse);
+			inserted++;
+
+			if(inserted % nnew != 0 || stop) continue;
+
+			/////////////////////////////////////////
+			// generation boundary (no barrier)
+			gen++;
+
+#ifdef ENABLE_BOINC
+			boinc_fraction_done((double)gen/(double)GB->max_generations);
+#endif
+			print = ( gen % GB->print_int == 0 ) ? 1 : 0;
+
+			calculate_fitness(FA,GB,VC,chrom,gene_lim,atoms,residue,cleftgrid,
+					  GB->fitness_model,GB->num_chrom,print,target);
+			fitness_stats(GB,chrom,GB->num_chrom);
+			mutprob = GB->mut_rate;
+			crossprob = GB->cross_rate;
+
+			(*n_chrom_snapshot) += save_poses(FA,GB,chrom,gene_lim,atoms,residue,cleftgrid,save_num_chrom);
+
+			if(check_convergence(GB,chrom,gen,start)) stop = true;
+
+			state = check_state(pausefile,abortfile,stopfile,interval);
+			if(state == -1){
+				async_stop_workers(nworkers,&fd_to[0],&fd_from[0],&pid[0],true);
+				return(state);
+			}else if(state == 1){
+				stop = true;
+			}
+
+			build_selection(GB,chrom,GB->num_chrom,2*nnew,dice,&sel);
+			npick = 0;
+		}
+	}
+
+	async_stop_workers(nworkers,&fd_to[0],&fd_from[0],&pid[0],false);
+
+	// last (partial) generation
+	calculate_fitness(FA,GB,VC,chrom,gene_lim,atoms,residue,cleftgrid,GB->fitness_model,GB->num_chrom,0,target);
+
+	printf("%ld offspring scored asynchronously over %d generations\n", inserted, gen);
+
+	return 1;
+#endif
+}
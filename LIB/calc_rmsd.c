@@ -1,5 +1,6 @@
 #include "flexaid.h"
 #include "boinc.h"
+#include <float.h>
 /********************************************************************************
  * This function calculates the RSMD between atomic coordinates of the atoms in *
  * the register ori_ligatm and those for the atoms of the ligand in             *
@@ -70,7 +71,7 @@ float calc_rmsd(FA_Global* FA,atom* atoms,resid* residue, gridpoint* cleftgrid,i
     }
     
     
-    if(normalmode > -1) alter_mode(atoms,residue,FA->normal_grid[normalmode],FA->res_cnt,FA->normal_modes);
+    if(normalmode > -1) alter_mode(FA,atoms,normalmode,1);
     
     // rebuild cartesian coordinates of optimized residues
     for(i=0;i<FA->nors;i++)
@@ -112,510 +113,220 @@ float calc_rmsd(FA_Global* FA,atom* atoms,resid* residue, gridpoint* cleftgrid,i
     return rmsd;
 }
 
+/********************************************************************************
+ * Symmetry-corrected RMSD : ligand atoms of the same type may be swapped. The   *
+ * atom type blocks and the assignment workspace are built once per ligand      *
+ * (FA->hungarian_rmsd) and each block is solved by the Hungarian algorithm     *
+ * unless matching every atom to itself is already optimal.                     *
+ ********************************************************************************/
 float calc_Hungarian_RMSD(FA_Global* FA, atom* atoms, resid* residue, gridpoint* cleftgrid,int npar, const double* icv)
 {
-    int i,j,k;
-    float rmsd = 0.0f;
+    int b;
     float total_assignment = 0.0f;
-    int nTypes = 0;
-    int nUniqueTypes = 0;
-    bool unique_flag = true;
+    hungarian* H;
+    
+    if(FA->hungarian_rmsd == NULL) FA->hungarian_rmsd = build_Hungarian(FA,atoms,residue);
+    H = FA->hungarian_rmsd;
+    if(H->natoms == 0) return(0.0f);
+    
+    for(b = 0; b < H->nblocks; b++) total_assignment += Hungarian_block_assignment(H,atoms,b);
+    
+    // Return symetry corrected RMSD
+    return( sqrtf(total_assignment/(float)H->natoms) );
+}
+
+hungarian* build_Hungarian(FA_Global* FA, atom* atoms, resid* residue)
+{
+    int i,j,k,t;
+    int n = 0, ntypes = 0;
+    int* types;
+    hungarian* H;
+    
+    // count typed ligand atoms (with reference coordinates)
+    for(i = 1; i <= FA->num_het; i++)
+    {
+        j = FA->het_res[i];
+        for(k=residue[j].fatm[0]; k<=residue[j].latm[0]; k++)
+            if(atoms[k].type > 0 && atoms[k].coor_ref != NULL) n++;
+    }
     
-    // Counting the number of unique atom types
-    // Declaration and Memory Allocation for (int*)unique_atom_type[]
-    int *unique_atom_type;
-    unique_atom_type = (int*) malloc(sizeof(int) * FA->num_het_atm);
-    if(!unique_atom_type)
-    {   
-        fprintf(stderr,"ERROR: memory allocation error in calc_Hungarian_RMSD (calc_rmsd.c).\n");
+    H = (hungarian*) malloc(sizeof(hungarian));
+    types = (int*) malloc(sizeof(int) * (n+1));
+    if(H == NULL || types == NULL)
+    {
+        fprintf(stderr,"ERROR: memory allocation error in build_Hungarian (calc_rmsd.c).\n");
         Terminate(2);
     }
-    // Initilization of the 'unique_atom_type[]' -> 0
-    memset(unique_atom_type, 0, FA->num_het_atm * sizeof(unique_atom_type[0]) );
     
+    // unique atom types in order of first appearance
     for(i = 1; i <= FA->num_het; i++)
     {
-        for(j = 1; j<=FA->res_cnt; j++)
+        j = FA->het_res[i];
+        for(k=residue[j].fatm[0]; k<=residue[j].latm[0]; k++)
         {
-            if(j == FA->het_res[i])
-            {
-                // The 'for loop' below iterates through all the atoms of the ligand
-                for(k=residue[j].fatm[0]; k<=residue[j].latm[0]; k++)
-                {
-                    for(int jj=0; jj < nUniqueTypes+1; jj++)
-                    {
-                        if(atoms[k].type == unique_atom_type[jj])
-                        {
-                            unique_flag = false;
-                            break;
-                        }
-                    }
-                    if(unique_flag)
-                    {
-                        unique_atom_type[nUniqueTypes] = atoms[k].type;
-                        nUniqueTypes++;
-                    }
-                    unique_flag = true;
-                }
-                // Counting the number of unique atom types
-                for(int z = 0; z < nUniqueTypes; z++)
-                {
-                    nTypes = 0;
-                    for(k=residue[j].fatm[0]; k<=residue[j].latm[0]; k++)
-                    {
-                        if(atoms[k].type > 0 && atoms[k].type == unique_atom_type[z]) nTypes++;
-                    }
-                    
-                    // Declaration, Memory Allocation and Initialization of the Hungarian algorihm arrays
-                    // ~declare + MemAlloc
-                    int **matrix_case;
-                    float **matrix, **matrix_original;
-                    int *row_count, *column_count, *row_assigned, *column_assigned, *matrix_match;
-                    matrix = (float**) malloc(sizeof(float*) * nTypes);
-                    matrix_original = (float**) malloc(sizeof(float*) * nTypes);
-                    matrix_case = (int**) malloc(sizeof(int*) * nTypes);
-                    if(matrix == NULL || matrix_original == NULL || matrix_case == NULL)
-                    {
-                        printf("ERROR: memory allocation error for hungarian algorithm.\n");
-                        fprintf(stderr,"ERROR: memory allocation error for hungarian algorithm.\n");
-                        Terminate(2);
-                    }
-                    for(k = 0; k < nTypes; k++)
-                    {
-                        matrix[k] = (float*) malloc(sizeof(float) * nTypes);
-                        matrix_original[k] = (float*) malloc(sizeof(float) * nTypes);
-                        matrix_case[k] = (int*) malloc(sizeof(int) * nTypes);
-                        if(matrix[k] == NULL || matrix_original[k] == NULL || matrix_case[k] == NULL)
-                        {
-                            printf("ERROR: memory allocation error for hungarian algorithm.\n");
-                            fprintf(stderr,"ERROR: memory allocation error for hungarian algorithm.\n");
-                            Terminate(2);
-                        }
-                    }
-                    row_count = (int*) malloc(sizeof(int) * nTypes);
-                    column_count = (int*) malloc(sizeof(int) * nTypes);
-                    row_assigned = (int*) malloc(sizeof(int) * nTypes);
-                    column_assigned = (int*) malloc(sizeof(int) * nTypes);
-                    matrix_match = (int*) malloc(sizeof(int) * nTypes);
-                    if(row_count == NULL || column_count == NULL || column_assigned == NULL || row_assigned == NULL || matrix_match == NULL)
-                    {
-                        fprintf(stderr,"ERROR: memory allocation error for hungarian algorithm.\n");
-                        Terminate(2);
-                    }
-                    // ~initialize() arrays
-                    // 1D array initialization (set to 0) for int arrays
-                    memset( row_count, 0, nTypes * sizeof(row_count[0]) );
-                    memset( column_count, 0, nTypes * sizeof(column_count[0]) );
-                    memset( row_assigned, 0, nTypes * sizeof(row_assigned[0]) );
-                    memset( column_assigned, 0, nTypes * sizeof(column_assigned[0]) );
-                    memset( matrix_match, 0, nTypes * sizeof(matrix_match[0]) );
-                    // 2D array init for floats arrays (matrix[][] && matrix_original[][]) and int array (matrix_case[][])
-                    for(k = 0; k < nTypes; k++)
-                    {
-                        for(int kk = 0; kk < nTypes; kk++)
-                        {
-                            matrix[k][kk] = 0.0f;
-                            matrix_original[k][kk] = 0.0f;
-                            matrix_case[k][kk] = 0; 
-                        }
-                    }
-
-                    // Init
-                    int count_i = -1;
-                    int count_j = -1;
-                    
-                    // Filling the matrix
-                    for(k=residue[j].fatm[0]; k<=residue[j].latm[0]; k++) // Foreach Atom in Lig
-                    {
-                        if(atoms[k].type == unique_atom_type[z])
-                        {
-                            count_i++;
-                            count_j = -1;
-
-                            for(int l = 0; l < FA->num_het_atm; l++)
-                            {
-                                if(atoms[k+l].type == unique_atom_type[z])
-                                {
-                                    count_j++;
-                                    matrix[count_i][count_j] = sqrdist(atoms[k].coor,atoms[k+l].coor_ref);
-                                }
-                            }
-                        }
-                    }
-                    
-                    // run the Hungarian assignment algorithm. matrix[][], matrix_case[][], matrix_match[], row_count[]. column_count[], row_assigned[] && column_assigned[] memory adresses will
-                    Hungarian(matrix, matrix_original, matrix_case, unique_atom_type, row_count, column_count, row_assigned, column_assigned, matrix_match, nTypes, FA->num_het_atm);
-                    
-                    // calculate the assignment for 
-                    float assignment = 0.0f;
-                    for(int ii = 0; ii < nTypes; ii++)
-                    {
-                        assignment += matrix_original[ii][matrix_match[ii]];
-                        // printf("(%d:%d)=%f (total=%f)\n",ii, matrix_match[ii], matrix_original[ii][matrix_match[ii]], assignment);
-                    }
-                    total_assignment += assignment;
-                    
-                    // FREEING DYNAMICALLY ALLOCATED MEMORY below
-                    if(matrix != NULL)
-                    {
-                        for(int ii = 0; ii < nTypes; ii++) {free(matrix[ii]);}
-                        free(matrix);
-                    }
-                    if(matrix_original != NULL)
-                    {
-                        for(int ii = 0; ii < nTypes; ii++) {free(matrix_original[ii]);}
-                        free(matrix_original);
-                    }
-                    if(matrix_case != NULL)
-                    {
-                        for(int ii = 0; ii < nTypes; ii++) {free(matrix_case[ii]);}
-                        free(matrix_case);
-                    }
-                    if(row_count != NULL) {free(row_count);}
-                    if(column_count != NULL) {free(column_count);}
-                    if(row_assigned != NULL) {free(row_assigned);}
-                    if(column_assigned != NULL) {free(column_assigned);}
-                    if(matrix_match != NULL) {free(matrix_match);}
-                }
-                
-                // Freeing the unique_atom_type[] dynamically allocated memory (check if it could be placed elsewhere)
-                if(unique_atom_type != NULL) {free(unique_atom_type);}
-                
-                // Return symetry corrected RMSD
-//                rmsd = sqrt(total_assignment/FA->num_het_atm);
-//                return(rmsd);
-            }
+            if(atoms[k].type <= 0 || atoms[k].coor_ref == NULL) continue;
+            for(t = 0; t < ntypes; t++) if(types[t] == atoms[k].type) break;
+            if(t == ntypes) types[ntypes++] = atoms[k].type;
         }
     }
-    // Return symetry corrected RMSD
-     rmsd = sqrt(total_assignment/(float)FA->num_het_atm);
-     return(rmsd);
-}
-
-void Hungarian(float** matrix, float** matrix_original, int** matrix_case, int* unique_atom_type, int* row_count, int* column_count, int* row_assigned, int* column_assigned, int* matrix_match, int nTypes, int num_het_atoms)
-{
-    // Step 1. Copy and Reduce the matrix
-    Hungarian_reduce_matrix(matrix, matrix_original, nTypes);
     
-    int cycle_counter = 0;
-    while( cycle_counter < (num_het_atoms * num_het_atoms) )
+    H->natoms = n;
+    H->nblocks = ntypes;
+    H->maxblock = 0;
+    H->block = (int*) malloc(sizeof(int) * (ntypes+1));
+    H->atm = (int*) malloc(sizeof(int) * (n > 0 ? n : 1));
+    if(H->block == NULL || H->atm == NULL)
     {
-        // Step 2. Attemp to assign one job to each worker
-        int number_assigned = Hungarian_assign_jobs(matrix, matrix_original, matrix_case, unique_atom_type, row_count, column_count, row_assigned, column_assigned, matrix_match, nTypes, num_het_atoms);
-        if(number_assigned == nTypes) {break;}
-        // Step 3. Draw the minimum number of lines required to cross out all 0s from matrix[][]
-        Hungarian_draw_line(matrix, matrix_original, matrix_case, row_count, column_count, row_assigned, column_assigned, matrix_match, nTypes);
-        // Step 4. Update cells of matrix[][] from lines drawn
-        Hungarian_update_matrix(matrix, matrix_case, nTypes);
-        cycle_counter++;
+        fprintf(stderr,"ERROR: memory allocation error in build_Hungarian (calc_rmsd.c).\n");
+        Terminate(2);
     }
-}
-int Hungarian_assign_jobs(float** matrix, float** matrix_original, int** matrix_case, int* unique_atom_type, int* row_count, int* column_count, int* row_assigned, int* column_assigned, int* matrix_match, int nTypes, int num_het_atoms)
-{
-    // Reset the matrices to be used in this loop and initilizing number_assigned -> 0
-    Hungarian_reset_match(matrix_match, nTypes);
-    Hungarian_reset_assigned_row(row_assigned, nTypes);
-    Hungarian_reset_assigned_column(column_assigned, nTypes);
-    int number_assigned = 0;
-    while(number_assigned < nTypes+1)
+    
+    // group atoms by type (blocks follow the order of first appearance)
+    n = 0;
+    for(t = 0; t < ntypes; t++)
     {
-        // 0. Reset the row_count[] && column_count[]
-        Hungarian_reset_row_count(row_count, nTypes);
-        Hungarian_reset_column_count(column_count, nTypes);
-        
-        // 1. Count the number of 0s in each row and column
-        for(int i=0; i<nTypes; i++)
-        {
-            for(int j=0; j<nTypes;j++)
-            {
-                if(matrix[i][j] == 0)
-                {
-                    if(row_assigned[i] == 0 && column_assigned[j] == 0)
-                    {
-                        row_count[i]++;
-                        column_count[j]++;
-                    }
-                }
-            }
-        }
-        
-        // 2. Identify the row OR column with the lowest number of 0s
-        float minimal_value = 1000000;
-        int row_col = 0; // Value of 0 : no more 0s left in matrix; Value of 1 : least number of 0s found in a row; Value of 2 : least number of 0s found in a col
-        
-        int row = -1;
-        int col = -1;
-        
-        for(int i=0; i<nTypes; i++)
-        {
-            if(row_count[i] != 0 && row_count[i] < minimal_value)
-            {
-                minimal_value = row_count[i];
-                row = i;
-                row_col = 1;
-                col = -1;
-            }
-            if(column_count[i] != 0 && column_count[i] < minimal_value)
-            {
-                minimal_value = column_count[i];
-                col = i;
-                row_col = 2;
-                row = -1;
-            }
-        }
-        
-        // 3. Make an assignment in the row or column with the least number of 0s
-        if(row_col == 0) { break; }
-        else if(row_col == 1)
+        H->block[t] = n;
+        for(i = 1; i <= FA->num_het; i++)
         {
-            for(int i=0; i<nTypes; i++)
+            j = FA->het_res[i];
+            for(k=residue[j].fatm[0]; k<=residue[j].latm[0]; k++)
             {
-                if(matrix[row][i] == 0 && column_assigned[i] == 0)
-                {
-                    matrix_match[row] = i;
-                    row_assigned[row] = 1;
-                    column_assigned[i] = 1;
-                    break; // breaks the for loop
-                }
+                if(atoms[k].type == types[t] && atoms[k].coor_ref != NULL) H->atm[n++] = k;
             }
         }
-        else if(row_col == 2)
-        {
-            for(int i=0; i<nTypes; i++)
-            {
-                if(matrix[i][col] == 0 && row_assigned[i] == 0)
-                {
-                    matrix_match[i] = col;
-                    column_assigned[col] = 1;
-                    row_assigned[i] = 1;
-                    break; // breaks the for loop
-                }
-            }
-        }
-        number_assigned++;
-    } // End of While loop : this will loop until all possible worker / job pairs are formed
-    return(number_assigned);
-}
-
-void Hungarian_reset_match(int* matrix_match, int nTypes)
-{
-    for(int i=0; i<nTypes; i++)
-    {
-        matrix_match[i] = -100;
-    }
-}
-
-void Hungarian_reset_assigned_row(int* row_assigned, int nTypes)
-{
-    // memset( row_assigned, 0, nTypes * sizeof(row_assigned[0]) );
-    for(int i=0; i<nTypes; i++)
-    {
-        row_assigned[i] = 0;
-    }
-}
-
-void Hungarian_reset_assigned_column(int* column_assigned, int nTypes)
-{
-    // memset( column_assigned, 0, nTypes * sizeof(column_assigned[0]) );
-    for(int i=0; i<nTypes; i++)
-    {
-        column_assigned[i] = 0;
+        if(n - H->block[t] > H->maxblock) H->maxblock = n - H->block[t];
     }
-}
-
-void Hungarian_reset_row_count(int* row_count, int nTypes)
-{
-    // memset( row_count, 0, nTypes * sizeof(row_count[0]) );
-    for(int i=0; i<nTypes; i++)
+    H->block[ntypes] = n;
+    free(types);
+    
+    // assignment workspace (sized for the largest block)
+    k = H->maxblock + 1;
+    H->cost = (float*) malloc(sizeof(float) * (H->maxblock > 0 ? H->maxblock*H->maxblock : 1));
+    H->u = (double*) malloc(sizeof(double) * k);
+    H->v = (double*) malloc(sizeof(double) * k);
+    H->minv = (double*) malloc(sizeof(double) * k);
+    H->p = (int*) malloc(sizeof(int) * k);
+    H->way = (int*) malloc(sizeof(int) * k);
+    H->used = (bool*) malloc(sizeof(bool) * k);
+    if(H->cost == NULL || H->u == NULL || H->v == NULL || H->minv == NULL ||
+       H->p == NULL || H->way == NULL || H->used == NULL)
     {
-        row_count[i] = 0;
+        fprintf(stderr,"ERROR: memory allocation error for hungarian algorithm.\n");
+        Terminate(2);
     }
+    
+    return(H);
 }
 
-void Hungarian_reset_column_count(int* column_count, int nTypes)
+void free_Hungarian(hungarian* H)
 {
-     // memset( column_count, 0, nTypes * sizeof(column_count[0]) );
-    for(int i=0; i<nTypes; i++)
-    {
-        column_count[i] = 0;
-    }
+    if(H == NULL) return;
+    
+    if(H->block != NULL) free(H->block);
+    if(H->atm != NULL) free(H->atm);
+    if(H->cost != NULL) free(H->cost);
+    if(H->u != NULL) free(H->u);
+    if(H->v != NULL) free(H->v);
+    if(H->minv != NULL) free(H->minv);
+    if(H->p != NULL) free(H->p);
+    if(H->way != NULL) free(H->way);
+    if(H->used != NULL) free(H->used);
+    free(H);
 }
 
-void Hungarian_reset_case(int** matrix_case, int nTypes)
+float Hungarian_block_identity(const hungarian* H, const atom* atoms, int b)
 {
-    for(int i=0;i<nTypes;i++)
+    int i,k;
+    float d, cost = 0.0f;
+    
+    for(i = H->block[b]; i < H->block[b+1]; i++)
     {
-        for(int j=0; j<nTypes;j++)
-        {
-            matrix_case[i][j] = 0;
-        }
+        const atom* a = &atoms[H->atm[i]];
+        for(k = 0; k < 3; k++) { d = a->coor[k] - a->coor_ref[k]; cost += d*d; }
     }
+    return(cost);
 }
 
-void Hungarian_update_matrix(float** matrix, int** matrix_case, int nTypes)
+float Hungarian_block_bound(hungarian* H, const atom* atoms, int b)
 {
-    // 0. Initialization of the variable used to store the minimal value of the matrix
-    float minimal_value = 1000000;
-    // 1. Find the minimal_value in matrix
-    for(int i=0; i<nTypes; i++)
+    int i,j,k;
+    int n = H->block[b+1] - H->block[b];
+    const int* atm = &H->atm[H->block[b]];
+    float d, sqd;
+    float rowmin, colmin, rowsum = 0.0f, colsum = 0.0f;
+    
+    // cost[i*n+j] : squared distance between atom i and the reference position of atom j
+    for(i = 0; i < n; i++)
     {
-        for(int j=0; j<nTypes; j++)
+        for(j = 0; j < n; j++)
         {
-            if(matrix_case[i][j] == 0)
-            {
-                if(matrix[i][j] < minimal_value)
-                {
-                    minimal_value = matrix[i][j];
-                }
-            }
+            for(k = 0, sqd = 0.0f; k < 3; k++) { d = atoms[atm[i]].coor[k] - atoms[atm[j]].coor_ref[k]; sqd += d*d; }
+            H->cost[i*n+j] = sqd;
         }
     }
-    // 2. Update every element of the matrix[][]
-    for(int i=0; i<nTypes; i++)
+    for(i = 0; i < n; i++)
     {
-        for(int j=0; j<nTypes; j++)
+        rowmin = colmin = FLT_MAX;
+        for(j = 0; j < n; j++)
         {
-            if(matrix_case[i][j] == 0)
-            {
-                matrix[i][j] -= minimal_value;
-            }
-            else if(matrix_case[i][j] == 1)
-            {
-                // Nothing to do here !
-            }
-            else if(matrix_case[i][j] == 2)
-            {
-                matrix[i][j] += minimal_value;
-            }
+            if(H->cost[i*n+j] < rowmin) rowmin = H->cost[i*n+j];
+            if(H->cost[j*n+i] < colmin) colmin = H->cost[j*n+i];
         }
+        rowsum += rowmin;
+        colsum += colmin;
     }
-    return;
+    return(rowsum > colsum ? rowsum : colsum);
 }
 
-void Hungarian_draw_line(float** matrix, float** matrix_original, int** matrix_case, int* row_count, int* column_count, int* row_assigned, int* column_assigned, int* matrix_match, int nTypes)
+float Hungarian_block_assignment(hungarian* H, const atom* atoms, int b)
 {
-    int lines = 0; // the number of lines required to cross out all 0s in matrix[][]
-                   // 0. reset the matrices used in this function
-    Hungarian_reset_assigned_row(row_assigned, nTypes);
-    Hungarian_reset_assigned_column(column_assigned, nTypes);
-    Hungarian_reset_case(matrix_case, nTypes);
+    int i,j,i0,j0,j1;
+    int n = H->block[b+1] - H->block[b];
+    float identity, bound, assignment = 0.0f;
+    double cur, delta;
     
-    // 1. Find/Mark rows without assignment
-    for(int i=0; i<nTypes; i++)
-    {
-        if(matrix_match[i] == -100)
-        {
-            row_assigned[i] = 1;
-        }
-    }
-    
-    bool flag_update = true; // Flag indicating that an update was made during last iter
-    int count_updates = 0;	 // Loop counter
+    identity = Hungarian_block_identity(H,atoms,b);
+    if(n == 1) return(identity);
     
-    // Looping until which line to be drawn is decided
-    while(flag_update && count_updates < nTypes*2)
-    {
-        flag_update = false;
-        
-        // 2. Mark all columns having 0s in those rows
-        for(int i=0; i<nTypes; i++) // Foreach row in matrix
-        {
-            if(row_assigned[i] == 1) // If this row have been previously assigned
-            {
-                for(int j=0; j < nTypes; j++) // For each column in this row 
-                {
-                    if(matrix[i][j] == 0) // Check wheter there is a 0
-                    {
-                        column_assigned[j] = 1; // Mark && remember this position in colum_assigned
-                    }
-                }
-            }
-        }
-        
-        // 3. Mark all rows having assignments in those coloumns
-        for(int i=0; i< nTypes; i++) // for all the column in the matrix[][]
-        {
-            if(column_assigned[i] == 1) // If a the column have been marked
-            {
-                for(int j=0; j<nTypes; j++) // Then check each row in this column
-                {
-                    if(matrix_match[j] == i && row_assigned[j] != 1) // and see if an assignment have been made :
-                    {
-                        row_assigned[j] = 1; // Mark that row
-                        flag_update = true;  // Flag the update that have been made
-                        count_updates++; 	 // Unsure if I need to update the counter here OR elsewhere OR if I need to get rid of it
-                    } 
-                }
-            }
-        }
-    }
+    // matching every atom to itself is optimal when it reaches the lower bound
+    bound = Hungarian_block_bound(H,atoms,b);
+    if(identity <= bound * (1.0f + FLT_EPSILON)) return(identity);
     
-    // 4. Draw lines through marked columns and unmarked rows
-    for(int i=0; i<nTypes; i++)				// for all of the cells in matrix[][]...
+    // Hungarian algorithm (shortest augmenting paths with row/column potentials), O(n^3), 1-based indices
+    for(j = 0; j <= n; j++) { H->u[j] = 0.0; H->v[j] = 0.0; H->p[j] = 0; H->way[j] = 0; }
+    for(i = 1; i <= n; i++)
     {
-        if(row_assigned[i] == 0)			// if a row has not been marked,
+        H->p[0] = i;
+        j0 = 0;
+        for(j = 0; j <= n; j++) { H->minv[j] = DBL_MAX; H->used[j] = false; }
+        do
         {
-            for(int j=0; j<nTypes; j++)		// draw a line through that row by incrementing every entry in
+            H->used[j0] = true;
+            i0 = H->p[j0];
+            delta = DBL_MAX;
+            j1 = 0;
+            for(j = 1; j <= n; j++)
             {
-                matrix_case[i][j]++;		// matrix_case[row][] by 1
+                if(H->used[j]) continue;
+                cur = H->cost[(i0-1)*n+(j-1)] - H->u[i0] - H->v[j];
+                if(cur < H->minv[j]) { H->minv[j] = cur; H->way[j] = j0; }
+                if(H->minv[j] < delta) { delta = H->minv[j]; j1 = j; }
             }
-            lines++;						// a line was just drawn, increment lines by 1
-        }
-        if(column_assigned[i] == 1)
-        {
-            for(int j=0; j<nTypes; j++)		// if a column has been marked,
-            {								// draw a line through that column by incrementing every entry in
-                matrix_case[j][i]++;		// matrix_case[][column] by 1
-            }
-            lines++;						// a line was just drawn, increment lines by 1
-        }
-    }
-    // every cell in matrix_case[][] will now either be a 0 (no lines covering), 1 (one line covering),
-    // or 2 (two lines covering)
-    return;
-}
-
-void Hungarian_reduce_matrix(float** matrix, float** matrix_original, int nTypes)
-{
-    // 1. Parse matrix[][] and make a backup copy in matrix_original[][]
-    for(int i=0; i<nTypes; i++)
-    {
-        for(int j=0; j < nTypes; j++)
-        {
-            matrix_original[i][j] = matrix[i][j];
-        }
-    }
-    // 2. Find lowest value in each row and substract it from the other elements from the row
-    for(int i=0; i<nTypes; i++)
-    {
-        float minimal_value = 10000000;
-        for(int j=0; j < nTypes; j++)
-        {
-            if(matrix[i][j] < minimal_value)
+            for(j = 0; j <= n; j++)
             {
-                minimal_value = matrix[i][j];
+                if(H->used[j]) { H->u[H->p[j]] += delta; H->v[j] -= delta; }
+                else H->minv[j] -= delta;
             }
-        }
-        for(int j =0; j < nTypes; j++)
+            j0 = j1;
+        } while(H->p[j0] != 0);
+        do
         {
-            matrix[i][j] -= minimal_value;
-        }
+            j1 = H->way[j0];
+            H->p[j0] = H->p[j1];
+            j0 = j1;
+        } while(j0);
     }
-     // 3. Find lowest value in each column and substract it from the other elements from the column
-    for(int j=0; j<nTypes; j++)
-    {
-        float minimal_value = 10000000;
-        for(int i =0; i<nTypes; i++)
-        {
-            if(matrix[i][j] < minimal_value)
-            {
-                minimal_value = matrix[i][j];
-            }
-        }
-        for(int i=0; i<nTypes;i++)
-        {
-            matrix[i][j] -= minimal_value;
-        }
-    }
-    return;
+    
+    for(j = 1; j <= n; j++) assignment += H->cost[(H->p[j]-1)*n+(j-1)];
+    return(assignment < identity ? assignment : identity);
 }
@@ -107,7 +107,7 @@ float calc_rmsd_chrom(FA_Global* FA, GB_Global* GB, const chromosome* chrom, con
 		}
 
 		if(normalmode > -1)
-			alter_mode(atoms,residue,FA->normal_grid[normalmode],FA->res_cnt,FA->normal_modes);
+			alter_mode(FA,atoms,normalmode,0);
   
 		/* rebuild cartesian coordinates of optimized residues*/
 		for(i=0;i<FA->nors;i++){
@@ -0,0 +1,354 @@
+#include "gaboom.h"
+#include "boinc.h"
+
+#ifndef _WIN32
+# include <signal.h>
+#endif
+
+# define CHECKPOINT_MAGIC "FLXCHKPT"
+# define CHECKPOINT_VERSION 1
+
+/*****************************************************************************
+ * GA checkpoint (CHKPOINT) : every CHKPOINT generations, and at the end of
+ * the generation during which SIGTERM was received, the state of the GA is
+ * written to <rrgfile>.chk : generation and replica, population, random
+ * number generators, duplicates table, chrom_snapshot (spilled runs included)
+ * and the convergence counters (rand, whose state cannot be saved, is then
+ * reseeded from the RNG at every generation). The file is written next to
+ * it, then renamed, so that a kill during the write leaves the previous
+ * checkpoint intact.
+ * RESUME (in the configuration file) continues the run from the checkpoint
+ * with the same generations as if it had never stopped. The receptor, grid,
+ * rotamers and DEE structures are rebuilt from the inputs at startup, the GA
+ * does not modify them (OPTIGRID, which does, is not supported).
+ *****************************************************************************/
+
+struct checkpoint_header{
+	char   magic[8];
+	int    version;
+	int    num_genes;
+	int    num_chrom;
+	int    replica;
+	int    generation;			// generations done in the replica
+	unsigned int seed;			// srand of the next generations
+	long   num_evaluations;
+	long   conv_evaluations;
+	double conv_best;
+	int    conv_stall;
+	double elapsed;				// seconds since the start of the replica
+	long   rng_length;			// characters of the state of the RNG
+	long   num_duplicates;		// signatures in the duplicates table
+	int    snap_n;				// chromosomes of chrom_snapshot in memory
+	long   snap_nSaved;
+	long   snap_nDuplicates;
+	long   snap_nDiscarded;
+	long   snap_nsignatures;
+	long   snap_nruns;			// sorted runs spilled to disk
+};
+
+#ifndef _WIN32
+static volatile sig_atomic_t checkpoint_signal = 0;
+
+static void checkpoint_handler(int sig)
+{
+	checkpoint_signal = sig;
+}
+#endif
+
+static void get_checkpoint_file(FA_Global* FA, char* file)
+{
+	strcpy(file,FA->rrgfile);
+	strcat(file,".chk");
+}
+
+static void write_checkpoint_data(FILE* outfile_ptr, const void* data, size_t size, size_t n, const char* file)
+{
+	if(n > 0 && fwrite(data,size,n,outfile_ptr) != n){
+		fprintf(stderr,"ERROR: Cannot write checkpoint file '%s'.\n", file);
+		Terminate(6);
+	}
+}
+
+static void read_checkpoint_data(FILE* infile_ptr, void* data, size_t size, size_t n, const char* file)
+{
+	if(n > 0 && fread(data,size,n,infile_ptr) != n){
+		fprintf(stderr,"ERROR: Cannot read checkpoint file '%s'.\n", file);
+		Terminate(6);
+	}
+}
+
+// same record as the spill file of chrom_snapshot
+static void write_checkpoint_chrom(FILE* outfile_ptr, const chromosome* chrom, int num_genes, const char* file)
+{
+	write_checkpoint_data(outfile_ptr,&chrom->cf,sizeof(cfstr),1,file);
+	write_checkpoint_data(outfile_ptr,&chrom->evalue,sizeof(double),1,file);
+	write_checkpoint_data(outfile_ptr,&chrom->app_evalue,sizeof(double),1,file);
+	write_checkpoint_data(outfile_ptr,&chrom->fitnes,sizeof(double),1,file);
+	write_checkpoint_data(outfile_ptr,&chrom->status,sizeof(char),1,file);
+	write_checkpoint_data(outfile_ptr,chrom->genes,sizeof(gene),num_genes,file);
+}
+
+static void read_checkpoint_chrom(FILE* infile_ptr, chromosome* chrom, int num_genes, const char* file)
+{
+	read_checkpoint_data(infile_ptr,&chrom->cf,sizeof(cfstr),1,file);
+	read_checkpoint_data(infile_ptr,&chrom->evalue,sizeof(double),1,file);
+	read_checkpoint_data(infile_ptr,&chrom->app_evalue,sizeof(double),1,file);
+	read_checkpoint_data(infile_ptr,&chrom->fitnes,sizeof(double),1,file);
+	read_checkpoint_data(infile_ptr,&chrom->status,sizeof(char),1,file);
+	read_checkpoint_data(infile_ptr,chrom->genes,sizeof(gene),num_genes,file);
+}
+
+
+/* SIGTERM (preemption, wall-time limit of the scheduler) asks for a last checkpoint
+   at the end of the generation, terminate_after_checkpoint then kills the process
+   with SIGTERM (the run is seen as interrupted, not finished) */
+void install_checkpoint_signals(bool install)
+{
+#ifndef _WIN32
+	signal(SIGTERM,install ? checkpoint_handler : SIG_DFL);
+#endif
+}
+
+// restores the default action of SIGTERM and raises it (never returns)
+void terminate_after_checkpoint(void)
+{
+	fflush(stdout);
+	fflush(stderr);
+#ifndef _WIN32
+	signal(SIGTERM,SIG_DFL);
+	raise(SIGTERM);
+#endif
+	// not reached (SIGTERM is never caught on Windows)
+	Terminate(1);
+}
+
+int checkpoint_requested(void)
+{
+#ifdef _WIN32
+	return 0;
+#else
+	return (checkpoint_signal != 0);
+#endif
+}
+
+
+/* writes the state of the GA after generation gen of the replica.
+   srand was last called with seed (the state of rand cannot be saved) */
+void write_checkpoint(FA_Global* FA, GB_Global* GB, const chromosome* chrom, int replica, int gen, time_t start, unsigned int seed,
+		      boost::variate_generator< RNGType, boost::uniform_int<> > & dice, const map<string, int> & duplicates)
+{
+	int i;
+	long j;
+	char file[MAX_PATH__];
+	char tmpfile[MAX_PATH__];
+	FILE* outfile_ptr = NULL;
+	FILE* spill_ptr = NULL;
+	checkpoint_header header;
+	snapshot* snap = GB->snapshot;
+	stringstream rng;
+
+	get_checkpoint_file(FA,file);
+	strcpy(tmpfile,file);
+	strcat(tmpfile,".tmp");
+
+	header.seed = seed;
+	rng << dice.engine();
+	string rng_state = rng.str();
+
+	memcpy(header.magic,CHECKPOINT_MAGIC,8);
+	header.version = CHECKPOINT_VERSION;
+	header.num_genes = GB->num_genes;
+	header.num_chrom = GB->num_chrom;
+	header.replica = replica;
+	header.generation = gen;
+	header.num_evaluations = GB->num_evaluations;
+	header.conv_evaluations = GB->conv_evaluations;
+	header.conv_best = GB->conv_best;
+	header.conv_stall = GB->conv_stall;
+	header.elapsed = difftime(time(NULL),start);
+	header.rng_length = (long)rng_state.size();
+	header.num_duplicates = (long)duplicates.size();
+	header.snap_n = snap->n;
+	header.snap_nSaved = snap->nSaved;
+	header.snap_nDuplicates = snap->nDuplicates;
+	header.snap_nDiscarded = snap->nDiscarded;
+	header.snap_nsignatures = (long)snap->signatures.size();
+	header.snap_nruns = (long)snap->runs.size();
+
+	if(!OpenFile_B(tmpfile,"wb",&outfile_ptr)){
+		fprintf(stderr,"ERROR: Cannot open checkpoint file '%s'.\n", tmpfile);
+		Terminate(6);
+	}
+
+	write_checkpoint_data(outfile_ptr,&header,sizeof(header),1,tmpfile);
+	write_checkpoint_data(outfile_ptr,rng_state.c_str(),1,rng_state.size(),tmpfile);
+
+	for(i=0;i<GB->num_chrom;i++) write_checkpoint_chrom(outfile_ptr,&chrom[i],GB->num_genes,tmpfile);
+
+	for(map<string, int>::const_iterator it=duplicates.begin(); it!=duplicates.end(); ++it){
+		long length = (long)it->first.size();
+		write_checkpoint_data(outfile_ptr,&length,sizeof(long),1,tmpfile);
+		write_checkpoint_data(outfile_ptr,it->first.c_str(),1,it->first.size(),tmpfile);
+	}
+
+	// chrom_snapshot : chromosomes in memory, signatures, then the spilled runs
+	for(i=0;i<snap->n;i++) write_checkpoint_chrom(outfile_ptr,&snap->chrom[i],snap->num_genes,tmpfile);
+	for(boost::unordered_set<unsigned long long>::const_iterator it=snap->signatures.begin(); it!=snap->signatures.end(); ++it){
+		write_checkpoint_data(outfile_ptr,&(*it),sizeof(unsigned long long),1,tmpfile);
+	}
+
+	if(!snap->runs.empty()){
+		chromosome record;
+		vector<gene> genes(snap->num_genes);
+		record.genes = &genes[0];
+
+		if(!OpenFile_B(snap->spillfile,"rb",&spill_ptr)){
+			fprintf(stderr,"ERROR: Cannot open spill file '%s'.\n", snap->spillfile);
+			Terminate(6);
+		}
+		for(i=0;i<(int)snap->runs.size();i++){
+			write_checkpoint_data(outfile_ptr,&snap->runs[i].second,sizeof(long),1,tmpfile);
+			fseek(spill_ptr,snap->runs[i].first,SEEK_SET);
+			for(j=0;j<snap->runs[i].second;j++){
+				read_snapshot_record(snap,spill_ptr,&record);
+				write_checkpoint_chrom(outfile_ptr,&record,snap->num_genes,tmpfile);
+			}
+		}
+		CloseFile_B(&spill_ptr,"rb");
+	}
+
+	if(fflush(outfile_ptr) != 0){
+		fprintf(stderr,"ERROR: Cannot write checkpoint file '%s'.\n", tmpfile);
+		Terminate(6);
+	}
+	CloseFile_B(&outfile_ptr,"wb");
+
+	// rename replaces the previous checkpoint atomically (not on Windows)
+#ifdef _WIN32
+	remove(file);
+#endif
+	if(rename(tmpfile,file) != 0){
+		fprintf(stderr,"ERROR: Cannot rename checkpoint file '%s' to '%s'.\n", tmpfile, file);
+		Terminate(6);
+	}
+}
+
+
+/* restores the state of the GA written by write_checkpoint.
+   returns 1 when the run is resumed, 0 when there is no checkpoint (a new run starts) */
+int read_checkpoint(FA_Global* FA, GB_Global* GB, chromosome* chrom, int* replica, int* gen, double* elapsed,
+		    boost::variate_generator< RNGType, boost::uniform_int<> > & dice, map<string, int> & duplicates)
+{
+	int i;
+	long j,k,length;
+	char file[MAX_PATH__];
+	FILE* infile_ptr = NULL;
+	checkpoint_header header;
+	snapshot* snap = GB->snapshot;
+
+	get_checkpoint_file(FA,file);
+
+	infile_ptr = fopen(file,"rb");
+	if(infile_ptr == NULL){
+		fprintf(stderr,"WARNING: no checkpoint file '%s' to resume from, starting a new run.\n", file);
+		return 0;
+	}
+	fclose(infile_ptr);
+	infile_ptr = NULL;
+
+	if(!OpenFile_B(file,"rb",&infile_ptr)){
+		fprintf(stderr,"ERROR: Cannot open checkpoint file '%s'.\n", file);
+		Terminate(6);
+	}
+
+	read_checkpoint_data(infile_ptr,&header,sizeof(header),1,file);
+	if(memcmp(header.magic,CHECKPOINT_MAGIC,8) != 0 || header.version != CHECKPOINT_VERSION){
+		fprintf(stderr,"ERROR: '%s' is not a checkpoint file of this version.\n", file);
+		Terminate(6);
+	}
+	if(header.num_genes != GB->num_genes || header.num_chrom != GB->num_chrom ||
+	   header.snap_n > snap->capacity || header.replica >= GB->num_replicas){
+		fprintf(stderr,"ERROR: checkpoint file '%s' does not match the inputs (genes, NUMCHROM, SNAPSIZE or REPLICAS).\n", file);
+		Terminate(6);
+	}
+
+	string rng_state(header.rng_length,' ');
+	read_checkpoint_data(infile_ptr,&rng_state[0],1,header.rng_length,file);
+	stringstream rng(rng_state);
+	rng >> dice.engine();
+	srand(header.seed);
+
+	for(i=0;i<GB->num_chrom;i++) read_checkpoint_chrom(infile_ptr,&chrom[i],GB->num_genes,file);
+
+	duplicates.clear();
+	for(j=0;j<header.num_duplicates;j++){
+		read_checkpoint_data(infile_ptr,&length,sizeof(long),1,file);
+		string sig(length,' ');
+		read_checkpoint_data(infile_ptr,&sig[0],1,length,file);
+		duplicates[sig] = 1;
+	}
+
+	grow_snapshot(snap,header.snap_n);
+	for(i=0;i<header.snap_n;i++) read_checkpoint_chrom(infile_ptr,&snap->chrom[i],snap->num_genes,file);
+	snap->n = header.snap_n;
+	snap->nSaved = header.snap_nSaved;
+	snap->nDuplicates = header.snap_nDuplicates;
+	snap->nDiscarded = header.snap_nDiscarded;
+
+	snap->signatures.clear();
+	for(j=0;j<header.snap_nsignatures;j++){
+		unsigned long long sig;
+		read_checkpoint_data(infile_ptr,&sig,sizeof(unsigned long long),1,file);
+		snap->signatures.insert(sig);
+	}
+
+	// the spilled runs are written again (the temporary directory may be gone)
+	snap->runs.clear();
+	if(header.snap_nruns > 0){
+		chromosome record;
+		vector<gene> genes(snap->num_genes);
+		record.genes = &genes[0];
+
+		if(snap->spill_ptr != NULL) CloseFile_B(&snap->spill_ptr,"wb");
+		snap->spill_ptr = NULL;
+		if(!OpenFile_B(snap->spillfile,"wb",&snap->spill_ptr)){
+			fprintf(stderr,"ERROR: Cannot open spill file '%s'.\n", snap->spillfile);
+			Terminate(6);
+		}
+		for(k=0;k<header.snap_nruns;k++){
+			read_checkpoint_data(infile_ptr,&length,sizeof(long),1,file);
+			snap->runs.push_back(make_pair(ftell(snap->spill_ptr),length));
+			for(j=0;j<length;j++){
+				read_checkpoint_chrom(infile_ptr,&record,snap->num_genes,file);
+				write_snapshot_record(snap,&record);
+			}
+		}
+		fflush(snap->spill_ptr);
+	}
+
+	CloseFile_B(&infile_ptr,"rb");
+
+	GB->num_evaluations = header.num_evaluations;
+	GB->conv_evaluations = header.conv_evaluations;
+	GB->conv_best = header.conv_best;
+	GB->conv_stall = header.conv_stall;
+
+	*replica = header.replica;
+	*gen = header.generation;
+	*elapsed = header.elapsed;
+
+	printf("resuming replica %d at generation %d from '%s' (%ld evaluations, %ld poses in chrom_snapshot)\n",
+	       header.replica+1, header.generation, file, header.num_evaluations, header.snap_nSaved);
+
+	return 1;
+}
+
+
+/* the run is over : a later RESUME must not restart it */
+void remove_checkpoint(FA_Global* FA)
+{
+	char file[MAX_PATH__];
+
+	get_checkpoint_file(FA,file);
+	remove(file);
+}
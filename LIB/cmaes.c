@@ -0,0 +1,275 @@
+#include "gaboom.h"
+#include "boinc.h"
+
+// probability of redrawing a mapped gene instead of taking it from the best individual
+# define CMA_MAP_RESET 0.1
+
+/*****************************************************************************
+ * Separable CMA-ES with IPOP restarts (METOPT CM) : the genes that are not
+ * mapped into an array are normalized to [0,1] over their opt_par range and
+ * sampled from N(m, sigma^2 diag(D^2)). The mean, the diagonal covariance and
+ * the step size follow Ros & Hansen (sep-CMA-ES), whose cost grows linearly
+ * with the number of genes (flexible ligands). A run restarts from a random
+ * mean with a doubled population (IPOP, up to CMRESTRT times) when the step
+ * size falls below half a bin or when the best CF stagnates.
+ * Mapped genes (grid points, rotamers) are taken from the best individual of
+ * the previous generation or redrawn at random.
+ * The first run starts from the best individual of the initial population,
+ * which may be read from the _par.res of a GA (POPINIMT IPFILE) to refine its
+ * poses. Each generation is scored as one batch and saved in chrom_snapshot
+ * for the clustering, like the GA population.
+ *****************************************************************************/
+
+/***********************************************************************/
+/*        1         2         3         4         5         6          */
+/*234567890123456789012345678901234567890123456789012345678901234567890*/
+/*        1         2         3         4         5         6         7*/
+/***********************************************************************/
+int CMAES(FA_Global* FA, GB_Global* GB,VC_Global* VC,chromosome** chrom,chromosome** chrom_snapshot,
+	  genlim** gene_lim,atom* atoms,resid* residue,gridpoint** cleftgrid,char gainpfile[],
+	  int* memchrom, cfstr (*target)(FA_Global*,VC_Global*,atom*,resid*,gridpoint*,int,double*)){
+
+	int i,j,k,g=0;
+	int print=0;
+	int n=0,lambda0,lambda_max;
+	int restart;
+	int n_chrom_snapshot=0;
+	bool stop=false;
+	chromosome* incumbent;
+
+	int  state=0;
+	char PAUSEFILE[MAX_PATH__];
+	char ABORTFILE[MAX_PATH__];
+	char STOPFILE[MAX_PATH__];
+
+	boost::variate_generator< RNGType, boost::uniform_int<> >
+		dice(RNGType(), boost::uniform_int<>(0, MAX_RANDOM_VALUE));
+
+	*memchrom=0;
+
+	init_optimizer(FA,GB,"CMA-ES",gainpfile,PAUSEFILE,ABORTFILE,STOPFILE,NULL,NULL,dice);
+
+	if(FA->opt_grid){
+		fprintf(stderr,"WARNING: OPTIGRID is ignored by CMA-ES.\n");
+		FA->opt_grid = 0;
+	}
+
+	long int at = init_gene_lim(FA,GB,gene_lim);
+
+	validate_dups(GB, (*gene_lim), GB->num_genes);
+	build_gene_decoding(GB, (*gene_lim));
+
+	// continuous genes
+	std::vector<int> cont;
+	double tolx = 1.0;
+	for(j=0;j<GB->num_genes;j++){
+		if((*gene_lim)[j].map || !((*gene_lim)[j].max > (*gene_lim)[j].min)) continue;
+		cont.push_back(j);
+		// half a bin on the normalized gene
+		if(0.5*(*gene_lim)[j].del/((*gene_lim)[j].max-(*gene_lim)[j].min) < tolx)
+			tolx = 0.5*(*gene_lim)[j].del/((*gene_lim)[j].max-(*gene_lim)[j].min);
+	}
+	n = (int)cont.size();
+	if(n == 0){
+		fprintf(stderr,"ERROR: CMA-ES needs at least one gene that is not mapped into an array.\n");
+		Terminate(10);
+	}
+
+	lambda0 = (GB->cma_popsize > 0) ? GB->cma_popsize : 4 + (int)floor(3.0*log((double)n));
+	if(lambda0 < 4) lambda0 = 4;
+	if(lambda0 > MAX_NUM_CHROM || GB->cma_sigma <= 0.0 || GB->cma_restarts < 0){
+		fprintf(stderr,"ERROR: invalid CMA-ES parameters (CMPOPSIZ, CMSIGMA0 or CMRESTRT).\n");
+		Terminate(10);
+	}
+	lambda_max = lambda0;
+	for(restart=0;restart<GB->cma_restarts && 2*lambda_max<=MAX_NUM_CHROM;restart++) lambda_max *= 2;
+
+	// positional fitness : only used to print the population
+	strcpy(GB->fitness_model,"LINEAR");
+	if(GB->print_int < 0){ GB->print_int = 1; }
+
+	// populations and the best individual over all the restarts
+	(*memchrom) = lambda_max+1;
+	alloc_chromosomes(GB,chrom,(*memchrom));
+	incumbent = &(*chrom)[lambda_max];
+
+	// *** chrom_snapshot (sized for the largest population)
+	GB->num_chrom = lambda_max;
+	init_snapshot(FA,GB,atoms,residue);
+
+	printf("sep-CMA-ES on %d continuous genes, population %d (up to %d with %d IPOP restarts), sigma0=%.3f\n",
+	       n, lambda0, lambda_max, GB->cma_restarts, GB->cma_sigma);
+	fflush(stdout);
+
+	map<string, int> duplicates;
+
+	time_t cma_start = time(NULL);
+	GB->conv_best = DBL_MAX;
+	GB->conv_stall = 0;
+
+	GB->num_chrom = lambda0;
+	if(GB->num_print > GB->num_chrom){ GB->num_print = GB->num_chrom; }
+	populate_chromosomes(FA,GB,VC,(*chrom),(*gene_lim),atoms,residue,(*cleftgrid),
+			     GB->pop_init_method,target,GB->pop_init_file,at,0,print,dice,duplicates);
+	n_chrom_snapshot += save_poses(FA,GB,(*chrom),(*gene_lim),atoms,residue,(*cleftgrid),GB->num_chrom);
+	copy_chrom(incumbent,&(*chrom)[0],GB->num_genes);
+
+	std::vector<double> m(n),D2(n),ps(n),pc(n),yw(n),lo(n),range(n);
+	std::vector<double> weights;
+	std::vector<gene> elite((*chrom)[0].genes,(*chrom)[0].genes+GB->num_genes);
+
+	for(i=0;i<n;i++){
+		lo[i] = (*gene_lim)[cont[i]].min;
+		range[i] = (*gene_lim)[cont[i]].max - lo[i];
+	}
+
+	// expected norm of a N(0,I) vector
+	const double chin = sqrt((double)n)*(1.0-1.0/(4.0*n)+1.0/(21.0*n*n));
+
+	////////////////////////////////
+	//////      CMA-ES      ////////
+	////////////////////////////////
+	for(restart=0;restart<=GB->cma_restarts && !stop;restart++)
+	{
+		int lambda = lambda0 << restart;
+		if(lambda > lambda_max) lambda = lambda_max;
+		int mu = lambda/2;
+		int gen_restart = 0;
+		int stall = 0;
+		double best = DBL_MAX;
+		double sigma = GB->cma_sigma;
+		double mueff,cs,ds,cc,c1,cmu,sum,norm,hsig;
+
+		weights.resize(mu);
+		for(sum=0.0,i=0;i<mu;i++){ weights[i] = log(mu+0.5)-log(i+1.0); sum += weights[i]; }
+		for(norm=0.0,i=0;i<mu;i++){ weights[i] /= sum; norm += weights[i]*weights[i]; }
+		mueff = 1.0/norm;
+
+		cs = (mueff+2.0)/(n+mueff+5.0);
+		ds = 1.0 + 2.0*std::max(0.0,sqrt((mueff-1.0)/(n+1.0))-1.0) + cs;
+		cc = (4.0+mueff/n)/(n+4.0+2.0*mueff/n);
+		c1 = 2.0/((n+1.3)*(n+1.3)+mueff);
+		cmu = std::min(1.0-c1,2.0*(mueff-2.0+1.0/mueff)/((n+2.0)*(n+2.0)+mueff));
+		// separable (diagonal) learning rates
+		c1 *= (n+2.0)/3.0;
+		cmu *= (n+2.0)/3.0;
+		if(c1+cmu > 1.0){ cmu = 1.0-c1; if(cmu < 0.0){ c1 = 1.0; cmu = 0.0; } }
+
+		// the first run starts from the best initial individual, the next ones at random
+		for(i=0;i<n;i++){
+			m[i] = (restart == 0) ? ((*chrom)[0].genes[cont[i]].to_ic - lo[i])/range[i] : RandomDouble(dice());
+			D2[i] = 1.0;
+			ps[i] = 0.0;
+			pc[i] = 0.0;
+		}
+		if(restart > 0) generate_random_individual(FA,GB,atoms,&elite[0],(*gene_lim),dice,0,GB->num_genes);
+
+		GB->num_chrom = lambda;
+		if(GB->num_print > GB->num_chrom){ GB->num_print = GB->num_chrom; }
+		if(restart > 0) printf("CMA-ES restart %d with a population of %d at generation %d\n", restart, lambda, g);
+
+		while(g < GB->max_generations)
+		{
+			state=check_state(PAUSEFILE,ABORTFILE,STOPFILE,STATE_INTERVAL);
+
+			if(state == -1){
+				return(state);
+			}else if(state == 1){
+				stop = true;
+				break;
+			}
+
+#ifdef ENABLE_BOINC
+			boinc_fraction_done((double)(g+1)/(double)GB->max_generations);
+#endif
+
+			print = ( (g+1) % GB->print_int == 0 ) ? 1 : 0;
+
+			// sampling (mirrored into [0,1])
+			for(k=0;k<lambda;k++){
+				gene* genes = (*chrom)[k].genes;
+
+				memcpy(genes,&elite[0],GB->num_genes*sizeof(gene));
+				for(j=0;j<GB->num_genes;j++){
+					if((*gene_lim)[j].map && RandomDouble(dice()) < CMA_MAP_RESET)
+						generate_random_individual(FA,GB,atoms,genes,(*gene_lim),dice,j,j+1);
+				}
+
+				for(i=0;i<n;i++){
+					double x = m[i] + sigma*sqrt(D2[i])*RandomNormal(dice);
+					x = fmod(fabs(x),2.0);
+					if(x > 1.0) x = 2.0-x;
+
+					genes[cont[i]].to_ic = lo[i] + x*range[i];
+					genes[cont[i]].to_int32 = encode_continuous_gene(&GB->gene_decoding[cont[i]],genes[cont[i]].to_ic);
+				}
+				(*chrom)[k].status = ' ';
+			}
+
+			// batch evaluation, then sorted by CF (and printed)
+			calculate_fitness(FA,GB,VC,(*chrom),(*gene_lim),atoms,residue,(*cleftgrid),
+					  GB->fitness_model,lambda,print,target);
+			g++;
+			gen_restart++;
+
+			// recombination of the mu best (steps of the mirrored points)
+			for(i=0;i<n;i++){
+				yw[i] = 0.0;
+				for(k=0;k<mu;k++) yw[i] += weights[k]*((((*chrom)[k].genes[cont[i]].to_ic - lo[i])/range[i] - m[i])/sigma);
+			}
+
+			for(norm=0.0,i=0;i<n;i++){
+				m[i] += sigma*yw[i];
+				ps[i] = (1.0-cs)*ps[i] + sqrt(cs*(2.0-cs)*mueff)*yw[i]/sqrt(D2[i]);
+				norm += ps[i]*ps[i];
+			}
+			norm = sqrt(norm);
+			hsig = (norm/sqrt(1.0-pow(1.0-cs,2.0*gen_restart)) < (1.4+2.0/(n+1.0))*chin) ? 1.0 : 0.0;
+
+			for(i=0;i<n;i++){
+				double rankmu = 0.0;
+				for(k=0;k<mu;k++){
+					double y = (((*chrom)[k].genes[cont[i]].to_ic - lo[i])/range[i] - (m[i]-sigma*yw[i]))/sigma;
+					rankmu += weights[k]*y*y;
+				}
+				pc[i] = (1.0-cc)*pc[i] + hsig*sqrt(cc*(2.0-cc)*mueff)*yw[i];
+				D2[i] = (1.0-c1-cmu)*D2[i] + c1*(pc[i]*pc[i] + (1.0-hsig)*cc*(2.0-cc)*D2[i]) + cmu*rankmu;
+			}
+			sigma *= exp((cs/ds)*(norm/chin-1.0));
+
+			memcpy(&elite[0],(*chrom)[0].genes,GB->num_genes*sizeof(gene));
+			if((*chrom)[0].evalue < incumbent->evalue) copy_chrom(incumbent,&(*chrom)[0],GB->num_genes);
+
+			n_chrom_snapshot += save_poses(FA,GB,(*chrom),(*gene_lim),atoms,residue,(*cleftgrid),lambda);
+
+			if(check_convergence(GB,(*chrom),g,cma_start)){
+				stop = true;
+				break;
+			}
+
+			// restart criteria
+			if((*chrom)[0].evalue < best - 1.0e-6*fabs(best)){
+				best = (*chrom)[0].evalue;
+				stall = 0;
+			}else{
+				stall++;
+			}
+
+			double dmax = 0.0;
+			for(i=0;i<n;i++) if(D2[i] > dmax) dmax = D2[i];
+			if(!(sigma*sqrt(dmax) >= tolx) || stall > 10+(int)ceil(30.0*n/lambda)) break;
+		}
+
+		if(g >= GB->max_generations) break;
+	}
+
+	// a restart may end above the best individual of a previous one
+	if(incumbent->evalue < (*chrom)[0].evalue){
+		insert_chrom(GB,(*chrom),incumbent->genes,&incumbent->cf,incumbent->evalue,incumbent->app_evalue);
+	}
+
+	printf("best CF after %d generations: %.3f\n", g, (*chrom)[0].app_evalue);
+	printf("%ld evaluations of the scoring function\n", GB->num_evaluations);
+
+	return close_optimizer(FA,GB,(*chrom),(*gene_lim),g,GB->num_chrom,n_chrom_snapshot,chrom_snapshot);
+}
@@ -0,0 +1,485 @@
+#include "gaboom.h"
+#include "boinc.h"
+
+// in milliseconds
+# define SLEEP 25
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <unistd.h>
+# include <signal.h>
+# include <errno.h>
+# include <sys/time.h>
+#endif
+
+#ifdef __linux__
+# include <poll.h>
+# include <sys/inotify.h>
+#endif
+
+# define CONTROL_POLL    0
+# define CONTROL_SIGNAL  1
+# define CONTROL_INOTIFY 2
+
+/*****************************************************************************
+ * Job control (CONTRL in the configuration file) : check_state is called at
+ * every generation of the GA, MC, DE and CMA-ES.
+ *  POLL [ms] : the .pause, .abort and .stop files of the state directory
+ *              (STATEP) are opened at most every ms milliseconds (default 0,
+ *              at every generation as before)
+ *  SIGNAL    : SIGUSR1 pauses and resumes the run, SIGUSR2 stops it (.stop)
+ *              and SIGTERM aborts it (or writes the checkpoint, CHKPOINT).
+ *              The islands and asynchronous workers are forked processes,
+ *              signal the process group (kill -USR2 -- -<pgid>)
+ *  INOTIFY   : the files come and go with the inotify events of the state
+ *              directory (Linux). Falls back to POLL when the directory
+ *              cannot be watched. Changes made on another host of a network
+ *              filesystem are not notified
+ * No file is opened at each generation with SIGNAL and INOTIFY, a pause
+ * waits in sigsuspend or poll instead of sleeping.
+ * The updates of the NRGsuite (.update) are written in memory and published
+ * (written next to .update, then renamed) once the NRGsuite has removed the
+ * previous one : the generations do not wait for it, an update that could
+ * not be published is replaced by the next one, and the last one is flushed
+ * at the end of the run.
+ *****************************************************************************/
+
+struct controlstate{
+	int    mode;
+	int    interval;				// POLL : milliseconds between two checks of the files
+	double last_check;
+	int    stop;					// .stop seen (the remaining replicas are not run either)
+	char   path[MAX_PATH__];		// state directory
+#ifndef _WIN32
+	pid_t  pid;						// process owning the inotify descriptor
+#endif
+	int    fd;						// INOTIFY : descriptor of the state directory
+	int    pause_file;				// INOTIFY : files present in the state directory
+	int    abort_file;
+	int    stop_file;
+	int    update_file;
+	char*  buffer;					// update being written
+	size_t buffer_size;
+	char*  pending;					// update not published yet
+	size_t pending_size;
+	double wait_start;				// since when .update was not removed by the NRGsuite (ms)
+};
+
+static controlstate control;
+
+// milliseconds
+static double control_clock(void)
+{
+#ifdef _WIN32
+	return (double)GetTickCount();
+#else
+	struct timeval tv;
+	gettimeofday(&tv,NULL);
+	return tv.tv_sec*1000.0 + tv.tv_usec/1000.0;
+#endif
+}
+
+#ifndef _WIN32
+static volatile sig_atomic_t control_paused = 0;
+static volatile sig_atomic_t control_stopped = 0;
+
+static void control_handler(int sig)
+{
+	if(sig == SIGUSR1) control_paused = !control_paused;
+	else if(sig == SIGUSR2) control_stopped = 1;
+}
+#endif
+
+#ifdef __linux__
+static int state_file_exists(const char* name)
+{
+	char file[MAX_PATH__];
+
+	strcpy(file,control.path);
+	strcat(file,"/");
+	strcat(file,name);
+
+	return access(file,F_OK) == 0;
+}
+
+static void scan_state_files(void)
+{
+	control.pause_file = state_file_exists(".pause");
+	control.abort_file = state_file_exists(".abort");
+	control.stop_file = state_file_exists(".stop");
+	control.update_file = state_file_exists(".update");
+}
+
+static void open_state_watch(void)
+{
+	control.pid = getpid();
+	control.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(control.fd == -1 ||
+	   inotify_add_watch(control.fd,control.path,IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO) == -1){
+		fprintf(stderr,"WARNING: cannot watch the state directory '%s' (%s), its files are polled.\n",
+			control.path, strerror(errno));
+		if(control.fd != -1) close(control.fd);
+		control.mode = CONTROL_POLL;
+		return;
+	}
+
+	// the watch is set first, no change can be missed
+	scan_state_files();
+}
+
+static void read_state_events(void)
+{
+	long buffer[1024];
+	ssize_t length;
+
+	// the islands are forked : each process reads its own events
+	if(control.pid != getpid()){
+		close(control.fd);
+		open_state_watch();
+		if(control.mode != CONTROL_INOTIFY) return;
+	}
+
+	while((length = read(control.fd,buffer,sizeof(buffer))) > 0){
+		char* p = (char*)buffer;
+		while(p < (char*)buffer + length){
+			const struct inotify_event* event = (const struct inotify_event*)p;
+			p += sizeof(struct inotify_event) + event->len;
+
+			if(event->mask & IN_Q_OVERFLOW){
+				scan_state_files();
+			}else if(event->mask & IN_IGNORED){
+				// the state directory was removed
+				close(control.fd);
+				control.mode = CONTROL_POLL;
+				control.pause_file = control.abort_file = control.stop_file = control.update_file = 0;
+				return;
+			}else if(event->len > 0){
+				int present = (event->mask & (IN_CREATE | IN_MOVED_TO)) ? 1 : 0;
+				if(!strcmp(event->name,".pause")) control.pause_file = present;
+				else if(!strcmp(event->name,".abort")) control.abort_file = present;
+				else if(!strcmp(event->name,".stop")) control.stop_file = present;
+				else if(!strcmp(event->name,".update")) control.update_file = present;
+			}
+		}
+	}
+}
+#endif
+
+void init_control(FA_Global* FA)
+{
+	control.mode = CONTROL_POLL;
+	control.interval = FA->control_interval;
+	control.last_check = -1.0e30;
+	control.stop = 0;
+	control.pending = NULL;
+	control.buffer = NULL;
+	control.wait_start = -1.0;
+	strcpy(control.path,FA->state_path);
+
+	if(!strcmp(FA->control,"POLL")){
+		if(control.interval > 0) printf("state files polled every %d ms\n", control.interval);
+	}else if(!strcmp(FA->control,"SIGNAL")){
+#ifdef _WIN32
+		fprintf(stderr,"WARNING: CONTRL SIGNAL is not available on Windows, the state files are polled.\n");
+#else
+		control.mode = CONTROL_SIGNAL;
+		signal(SIGUSR1,control_handler);
+		signal(SIGUSR2,control_handler);
+		printf("job control by signals of process %d: USR1 (pause/resume), USR2 (stop), TERM (abort)\n", (int)getpid());
+#endif
+	}else if(!strcmp(FA->control,"INOTIFY")){
+#ifdef __linux__
+		control.mode = CONTROL_INOTIFY;
+		open_state_watch();
+#else
+		fprintf(stderr,"WARNING: CONTRL INOTIFY is only available on Linux, the state files are polled.\n");
+#endif
+	}else{
+		fprintf(stderr,"ERROR: unknown job control '%s' (POLL, SIGNAL or INOTIFY).\n", FA->control);
+		Terminate(2);
+	}
+
+	if(FA->nrg_suite && control.mode == CONTROL_SIGNAL){
+		fprintf(stderr,"WARNING: the NRGsuite pauses and stops the run with the state files, ignored with CONTRL SIGNAL.\n");
+	}
+}
+
+/***********************************************************************/
+/*        1         2         3         4         5         6          */
+/*234567890123456789012345678901234567890123456789012345678901234567890*/
+/*        1         2         3         4         5         6         7*/
+/***********************************************************************/
+int check_state(char* pausefile, char* abortfile, char* stopfile, int interval){
+	FILE* STATE;
+
+	if(control.stop){
+		printf("simulation stopped prematurely\n");
+		return 1;
+	}
+
+#ifndef _WIN32
+	if(control.mode == CONTROL_SIGNAL){
+		if(control_paused){
+			sigset_t mask,unblocked;
+			sigemptyset(&mask);
+			sigaddset(&mask,SIGUSR1);
+			sigaddset(&mask,SIGUSR2);
+			sigaddset(&mask,SIGTERM);
+			sigprocmask(SIG_BLOCK,&mask,&unblocked);
+			while(control_paused && !control_stopped && !checkpoint_requested()) sigsuspend(&unblocked);
+			sigprocmask(SIG_SETMASK,&unblocked,NULL);
+		}
+
+		if(control_stopped){
+			control.stop = 1;
+			printf("simulation stopped prematurely\n");
+			return 1;
+		}
+
+		return 0;
+	}
+#endif
+
+#ifdef __linux__
+	if(control.mode == CONTROL_INOTIFY){
+		read_state_events();
+	}
+	if(control.mode == CONTROL_INOTIFY){
+		while(control.pause_file && !checkpoint_requested()){
+			struct pollfd pfd;
+			pfd.fd = control.fd;
+			pfd.events = POLLIN;
+			pfd.revents = 0;
+			poll(&pfd,1,-1);
+			read_state_events();
+			if(control.mode != CONTROL_INOTIFY) return check_state(pausefile,abortfile,stopfile,interval);
+		}
+
+		if(control.abort_file){
+			printf("manual aborting\n");
+			return -1;
+		}
+
+		if(control.stop_file){
+			control.stop = 1;
+			printf("simulation stopped prematurely\n");
+			return 1;
+		}
+
+		return 0;
+	}
+#endif
+
+	if(control.interval > 0){
+		double now = control_clock();
+		if(now - control.last_check < control.interval) return 0;
+		control.last_check = now;
+	}
+
+	STATE = NULL;
+
+	// try and open pause/stop file
+	// (works with PyMOL interface)
+
+	STATE = fopen(pausefile,"r");
+	if(STATE != NULL) {
+		do {
+			fclose(STATE);
+
+# ifdef _WIN32
+			Sleep(SLEEP);
+# else
+			usleep(SLEEP*1000);
+# endif
+			STATE = fopen(pausefile,"r");
+
+		}while(STATE != NULL && !checkpoint_requested());
+		if(STATE != NULL) fclose(STATE);
+	}
+
+	STATE = fopen(abortfile,"r");
+	if(STATE != NULL) {
+		fclose(STATE);
+		printf("manual aborting\n");
+		return -1;
+	}
+
+	STATE = fopen(stopfile,"r");
+	if(STATE != NULL) {
+		fclose(STATE);
+		control.stop = 1;
+		printf("simulation stopped prematurely\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+/***********************************************************************/
+/*        1         2         3         4         5         6          */
+/*234567890123456789012345678901234567890123456789012345678901234567890*/
+/*        1         2         3         4         5         6         7*/
+/***********************************************************************/
+static void get_update_file(FA_Global* FA, char* file)
+{
+	strcpy(file,FA->state_path);
+#ifdef _WIN32
+	strcat(file,"\\.update");
+#else
+	strcat(file,"/.update");
+#endif
+}
+
+#ifndef _WIN32
+// the NRGsuite removes .update once it has read it
+static int update_consumed(const char* file)
+{
+#ifdef __linux__
+	if(control.mode == CONTROL_INOTIFY) read_state_events();
+	if(control.mode == CONTROL_INOTIFY) return !control.update_file;
+#endif
+	return access(file,F_OK) != 0;
+}
+
+/* publishes the pending update when the NRGsuite has read the previous one.
+   returns 1 when no update is left pending */
+static int publish_update(FA_Global* FA)
+{
+	char UPDATEFILE[MAX_PATH__];
+	char TMPFILE[MAX_PATH__];
+	FILE* outfile_ptr;
+
+	if(control.pending == NULL) return 1;
+
+	get_update_file(FA,UPDATEFILE);
+	if(!update_consumed(UPDATEFILE)){
+		if(control.wait_start < 0.0) control.wait_start = control_clock();
+		return 0;
+	}
+
+	strcpy(TMPFILE,UPDATEFILE);
+	strcat(TMPFILE,".tmp");
+
+	outfile_ptr = fopen(TMPFILE,"w");
+	if(outfile_ptr == NULL){
+		fprintf(stderr,"ERROR: Cannot open update file '%s' for writing.\n", TMPFILE);
+		Terminate(10);
+	}
+	if(control.pending_size > 0 && fwrite(control.pending,1,control.pending_size,outfile_ptr) != control.pending_size){
+		fprintf(stderr,"ERROR: Cannot write update file '%s'.\n", TMPFILE);
+		Terminate(10);
+	}
+	fclose(outfile_ptr);
+
+	if(rename(TMPFILE,UPDATEFILE) != 0){
+		fprintf(stderr,"ERROR: Cannot rename update file '%s' to '%s'.\n", TMPFILE, UPDATEFILE);
+		Terminate(10);
+	}
+
+	free(control.pending);
+	control.pending = NULL;
+	control.wait_start = -1.0;
+	control.update_file = 1;
+
+	return 1;
+}
+#endif
+
+/***********************************************************************/
+/*        1         2         3         4         5         6          */
+/*234567890123456789012345678901234567890123456789012345678901234567890*/
+/*        1         2         3         4         5         6         7*/
+/***********************************************************************/
+void close_update_file_ptr(FA_Global* FA, FILE* outfile_ptr)
+{
+
+	if(FA->nrg_suite){
+		fclose(outfile_ptr);
+
+#ifndef _WIN32
+		// the latest update replaces the one the NRGsuite did not read yet
+		free(control.pending);
+		control.pending = control.buffer;
+		control.pending_size = control.buffer_size;
+		control.buffer = NULL;
+
+		publish_update(FA);
+#endif
+	}
+
+}
+/***********************************************************************/
+/*        1         2         3         4         5         6          */
+/*234567890123456789012345678901234567890123456789012345678901234567890*/
+/*        1         2         3         4         5         6         7*/
+/***********************************************************************/
+FILE* get_update_file_ptr(FA_Global* FA)
+{
+
+	if(!FA->nrg_suite){
+		return stdout;
+	}
+
+	FILE* outfile_ptr = NULL;
+
+#ifdef _WIN32
+	char UPDATEFILE[MAX_PATH__];
+	long long timeout = 0;
+
+	get_update_file(FA,UPDATEFILE);
+
+	outfile_ptr = fopen(UPDATEFILE,"r");
+	if(outfile_ptr != NULL) {
+		do {
+			fclose(outfile_ptr);
+
+			Sleep(SLEEP);
+
+			timeout += SLEEP;
+			if(timeout >= FA->nrg_suite_timeout*1000){
+				return NULL;
+			}
+
+			outfile_ptr = fopen(UPDATEFILE,"r");
+
+		}while(outfile_ptr != NULL);
+	}
+
+	outfile_ptr = fopen(UPDATEFILE,"w");
+	if(outfile_ptr == NULL){
+		fprintf(stderr,"ERROR: Cannot open update file '%s' for reading.\n", UPDATEFILE);
+		Terminate(10);
+	}
+#else
+	// the NRGsuite has not read an update for too long
+	if(!publish_update(FA) && control_clock() - control.wait_start >= FA->nrg_suite_timeout*1000.0){
+		return NULL;
+	}
+
+	outfile_ptr = open_memstream(&control.buffer,&control.buffer_size);
+	if(outfile_ptr == NULL){
+		fprintf(stderr,"ERROR: Cannot open the buffer of the update file.\n");
+		Terminate(10);
+	}
+#endif
+
+	return outfile_ptr;
+
+}
+
+// the last update is delivered before the results are written
+void flush_update_file(FA_Global* FA)
+{
+#ifndef _WIN32
+	if(!FA->nrg_suite) return;
+
+	while(!publish_update(FA)){
+		if(control_clock() - control.wait_start >= FA->nrg_suite_timeout*1000.0){
+			fprintf(stderr,"ERROR: The NRGsuite failed to update within the timeout.\n");
+			Terminate(10);
+		}
+		usleep(SLEEP*1000);
+	}
+#endif
+}
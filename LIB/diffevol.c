@@ -0,0 +1,206 @@
+#include "gaboom.h"
+#include "boinc.h"
+
+/*****************************************************************************
+ * Differential evolution (METOPT DE) : the NUMCHROM vectors of internal
+ * coordinates (gene.to_ic) evolve by differences of other vectors instead of
+ * bit operators, so that torsions and translations stay continuous within the
+ * opt_par ranges. At each of the NUMGENER generations, every target vector
+ * competes with one trial vector (binomial crossover with probability
+ * DECROSSR of a mutant built with the weight DEWEIGHT) :
+ *   RAND1BIN  : x_r1 + F*(x_r2 - x_r3)
+ *   BEST1BIN  : x_best + F*(x_r1 - x_r2)
+ *   RAND2BIN  : x_r1 + F*(x_r2 - x_r3) + F*(x_r4 - x_r5)
+ *   CURTOBEST : x_i + F*(x_best - x_i) + F*(x_r1 - x_r2)
+ * The trial vectors of a generation are built first and scored as one batch.
+ * Genes mapped into an array (grid points, rotamers) have no meaningful
+ * difference : they are taken from x_r1. The to_int32 of a trial gene decodes
+ * into the bin of its value, at a position within the bin that follows the
+ * value, so that the signatures of chrom_snapshot tell close values apart.
+ *****************************************************************************/
+
+// number of distinct random vectors used by the strategy
+static int de_num_vectors(const char* strategy)
+{
+	if(strcmp(strategy,"RAND2BIN") == 0) return 5;
+	if(strcmp(strategy,"RAND1BIN") == 0) return 3;
+	return 2;
+}
+
+// builds the trial vector of target i (chrom is sorted : chrom[0] is the best)
+static void de_trial(GB_Global* GB, const genlim* gene_lim, const chromosome* chrom, int i, chromosome* trial,
+		     boost::variate_generator< RNGType, boost::uniform_int<> > & dice)
+{
+	int j,k,jrand;
+	int r[5];
+	int nr = de_num_vectors(GB->de_strategy);
+	double v,base;
+	const gene* x = chrom[i].genes;
+	const gene* best = chrom[0].genes;
+
+	// distinct vectors, all different from the target
+	for(k=0;k<nr;k++){
+		bool unique;
+		do{
+			r[k] = (int)(RandomDouble(dice())*GB->num_chrom);
+			unique = (r[k] != i);
+			for(int l=0;l<k && unique;l++) unique = (r[k] != r[l]);
+		}while(!unique);
+	}
+
+	memcpy(trial->genes,x,GB->num_genes*sizeof(gene));
+
+	jrand = (int)(RandomDouble(dice())*GB->num_genes);
+	for(j=0;j<GB->num_genes;j++){
+		if(j != jrand && RandomDouble(dice()) >= GB->de_crossover) continue;
+
+		if(gene_lim[j].map){
+			trial->genes[j] = chrom[r[0]].genes[j];
+			continue;
+		}
+
+		if(strcmp(GB->de_strategy,"BEST1BIN") == 0){
+			base = best[j].to_ic;
+			v = base + GB->de_weight*(chrom[r[0]].genes[j].to_ic - chrom[r[1]].genes[j].to_ic);
+		}else if(strcmp(GB->de_strategy,"CURTOBEST") == 0){
+			base = x[j].to_ic;
+			v = base + GB->de_weight*(best[j].to_ic - base)
+				 + GB->de_weight*(chrom[r[0]].genes[j].to_ic - chrom[r[1]].genes[j].to_ic);
+		}else{
+			base = chrom[r[0]].genes[j].to_ic;
+			v = base + GB->de_weight*(chrom[r[1]].genes[j].to_ic - chrom[r[2]].genes[j].to_ic);
+			if(nr == 5) v += GB->de_weight*(chrom[r[3]].genes[j].to_ic - chrom[r[4]].genes[j].to_ic);
+		}
+
+		// out of range : between the base vector and the bound it crossed
+		if(v < gene_lim[j].min) v = gene_lim[j].min + RandomDouble(dice())*(base - gene_lim[j].min);
+		if(v > gene_lim[j].max) v = gene_lim[j].max - RandomDouble(dice())*(gene_lim[j].max - base);
+
+		trial->genes[j].to_ic = v;
+		trial->genes[j].to_int32 = encode_continuous_gene(&GB->gene_decoding[j],v);
+	}
+}
+
+/***********************************************************************/
+/*        1         2         3         4         5         6          */
+/*234567890123456789012345678901234567890123456789012345678901234567890*/
+/*        1         2         3         4         5         6         7*/
+/***********************************************************************/
+int DE(FA_Global* FA, GB_Global* GB,VC_Global* VC,chromosome** chrom,chromosome** chrom_snapshot,
+       genlim** gene_lim,atom* atoms,resid* residue,gridpoint** cleftgrid,char gainpfile[],
+       int* memchrom, cfstr (*target)(FA_Global*,VC_Global*,atom*,resid*,gridpoint*,int,double*)){
+
+	int i,g;
+	int print=0;
+	int n;
+	int n_chrom_snapshot=0;
+
+	int  state=0;
+	char PAUSEFILE[MAX_PATH__];
+	char ABORTFILE[MAX_PATH__];
+	char STOPFILE[MAX_PATH__];
+
+	chromosome* trials;
+
+	boost::variate_generator< RNGType, boost::uniform_int<> >
+		dice(RNGType(), boost::uniform_int<>(0, MAX_RANDOM_VALUE));
+
+	*memchrom=0;
+
+	init_optimizer(FA,GB,"DE",gainpfile,PAUSEFILE,ABORTFILE,STOPFILE,NULL,NULL,dice);
+
+	if(strcmp(GB->de_strategy,"RAND1BIN") != 0 && strcmp(GB->de_strategy,"BEST1BIN") != 0 &&
+	   strcmp(GB->de_strategy,"RAND2BIN") != 0 && strcmp(GB->de_strategy,"CURTOBEST") != 0){
+		fprintf(stderr,"ERROR: Unknown differential evolution strategy '%s' (RAND1BIN, BEST1BIN, RAND2BIN or CURTOBEST).\n", GB->de_strategy);
+		Terminate(10);
+	}
+	n = GB->num_chrom;
+	if(n < de_num_vectors(GB->de_strategy)+1 || GB->de_weight <= 0.0 || GB->de_crossover < 0.0 || GB->de_crossover > 1.0){
+		fprintf(stderr,"ERROR: invalid differential evolution parameters (NUMCHROM, DEWEIGHT or DECROSSR).\n");
+		Terminate(10);
+	}
+	if(FA->opt_grid){
+		fprintf(stderr,"WARNING: OPTIGRID is ignored by the differential evolution.\n");
+		FA->opt_grid = 0;
+	}
+
+	// positional fitness : only used to print the population
+	strcpy(GB->fitness_model,"LINEAR");
+	if(GB->print_int < 0){ GB->print_int = 1; }
+	if(GB->num_print > n){ GB->num_print = n; }
+
+	long int at = init_gene_lim(FA,GB,gene_lim);
+
+	validate_dups(GB, (*gene_lim), GB->num_genes);
+	build_gene_decoding(GB, (*gene_lim));
+
+	// target and trial vectors
+	(*memchrom) = 2*n;
+	alloc_chromosomes(GB,chrom,(*memchrom));
+	trials = &(*chrom)[n];
+
+	// *** chrom_snapshot
+	init_snapshot(FA,GB,atoms,residue);
+
+	printf("differential evolution %s with %d vectors, F=%.2f CR=%.2f\n", GB->de_strategy, n, GB->de_weight, GB->de_crossover);
+	fflush(stdout);
+
+	map<string, int> duplicates;
+
+	time_t de_start = time(NULL);
+	GB->conv_best = DBL_MAX;
+	GB->conv_stall = 0;
+
+	populate_chromosomes(FA,GB,VC,(*chrom),(*gene_lim),atoms,residue,(*cleftgrid),
+			     GB->pop_init_method,target,GB->pop_init_file,at,0,print,dice,duplicates);
+
+	int save_num_chrom = (int)(n*SAVE_CHROM_FRACTION);
+
+	////////////////////////////////
+	//// Differential Evolution ////
+	////////////////////////////////
+	for(g=0;g<GB->max_generations;g++)
+	{
+		state=check_state(PAUSEFILE,ABORTFILE,STOPFILE,STATE_INTERVAL);
+
+		if(state == -1){
+			return(state);
+		}else if(state == 1){
+			break;
+		}
+
+#ifdef ENABLE_BOINC
+		boinc_fraction_done((double)(g+1)/(double)GB->max_generations);
+#endif
+
+		print = ( (g+1) % GB->print_int == 0 ) ? 1 : 0;
+
+		for(i=0;i<n;i++) de_trial(GB,(*gene_lim),(*chrom),i,&trials[i],dice);
+
+		// batch evaluation
+		for(i=0;i<n;i++){
+			trials[i].cf = eval_chromosome(FA,GB,VC,(*gene_lim),atoms,residue,(*cleftgrid),trials[i].genes,target);
+			trials[i].evalue = get_cf_evalue(&trials[i].cf);
+			trials[i].app_evalue = get_apparent_cf_evalue(&trials[i].cf);
+			trials[i].status = 'n';
+		}
+
+		// one-to-one selection
+		for(i=0;i<n;i++){
+			if(trials[i].evalue <= (*chrom)[i].evalue) swap_chrom(&(*chrom)[i],&trials[i]);
+		}
+
+		// sorts (the best vector comes first) and prints the population
+		calculate_fitness(FA,GB,VC,(*chrom),(*gene_lim),atoms,residue,(*cleftgrid),
+				  GB->fitness_model,n,print,target);
+
+		n_chrom_snapshot += save_poses(FA,GB,(*chrom),(*gene_lim),atoms,residue,(*cleftgrid),save_num_chrom);
+
+		if(check_convergence(GB,(*chrom),g+1,de_start)){ g++; break; }
+	}
+
+	printf("best CF after %d generations: %.3f\n", g, (*chrom)[0].app_evalue);
+	printf("%ld evaluations of the scoring function\n", GB->num_evaluations);
+
+	return close_optimizer(FA,GB,(*chrom),(*gene_lim),g,n,n_chrom_snapshot,chrom_snapshot);
+}
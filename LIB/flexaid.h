@@ -163,6 +163,35 @@ struct constraint_str{
 };
 typedef struct constraint_str constraint;
 
+struct hungarian_struct{               // symmetry-corrected RMSD workspace (built once per ligand)
+	int     nblocks;                     // number of atom type blocks (atoms of a block may be swapped)
+	int     natoms;                      // number of ligand atoms in blocks
+	int     maxblock;                    // size of the largest block (workspace dimension)
+	int*    block;                       // offsets of each block in atm[] (nblocks+1)
+	int*    atm;                         // ligand atom numbers grouped by type
+	float*  cost;                        // maxblock x maxblock squared distances
+	double* u;                           // row potentials (maxblock+1)
+	double* v;                           // column potentials (maxblock+1)
+	double* minv;                        // (maxblock+1)
+	int*    p;                           // row matched to each column (maxblock+1)
+	int*    way;                         // (maxblock+1)
+	bool*   used;                        // (maxblock+1)
+};
+typedef struct hungarian_struct hungarian;
+
+struct nmacache_struct{                // displaced binding sites by row of the normal grid (least recently used evicted)
+	int     size;                        // number of slots
+	int     stride;                      // floats per slot (3*nma_nsite, padded)
+	float*  coor;                        // displaced coordinates of the binding site [size][stride] (aligned)
+	int*    row;                         // row of the normal grid in each slot (-1 when free)
+	long*   stamp;                       // last use of each slot
+	int*    slot;                        // slot of each row of the normal grid (-1 when not cached)
+	long    clock;
+	long    hits;                        // displacements read from the cache
+	long    misses;                      // displacements computed
+};
+typedef struct nmacache_struct nmacache;
+
 struct optmap_struct{  // optimization residues structure
 	int typ; // type of atom to be optimized
 	int atm; // number of atom to be optimized
@@ -193,7 +222,6 @@ struct atom_struct{  // atom structure
 	optmap* par;    // if this atom defines a variable (translational/rotational or dihedrals)
 	constraint** cons; // points to constraint , if NULL no constraint to atom
 	OptRes* optres;  // pointer to optimised residue list
-	float** eigen;   // eigen vectors
 	
 	int    rec[4];  // atom number to be used when reconstructing the atom coordinates from internal coordinates
 	char   name[5]; // atom name
@@ -355,6 +383,7 @@ struct FA_Global_struct{
 
 	int   rotobs;                        // use rotamer observations, otherwise default Lovell's LIBrary
 	int   rotout;                        // output rotamers in rotamers.pdb as pdb models
+	int   resume;                        // resume the GA from its checkpoint (<rrgfile>.chk)
 	
 	int   num_het;                       // number of hetero groups read
 	int   num_het_atm;                   // number of hetero atoms
@@ -384,6 +413,7 @@ struct FA_Global_struct{
 	int   nrg_suite_timeout;             // specifies the maximum time for the suite to update the visuals (in seconds)
 	int   translational;                 // flag indicating if translation degrees of freedom are enabled
 	int   refstructure;                  // reference structure for rmsd calculation
+	hungarian* hungarian_rmsd;           // symmetry-corrected RMSD workspace (NULL until first use)
   
 	int* contacts;                       // matrix used for not calculating the same interaction twice
 	struct energy_matrix* energy_matrix;        // potential energy parameters
@@ -417,6 +447,20 @@ struct FA_Global_struct{
 	float**  normal_grid;                        // 2-dimensional grid containing amplitudes of eigenvectors
 	float**  eigenvector;                        // 2-dimensional grid containing eigen vectors
 	int      num_eigen;
+	int      nma_natoms;                         // protein atoms moved by the normal modes (binding site first)
+	int      nma_nsite;                          // atoms of the binding site, the only ones moved when scoring
+	int      nma_noptres;                        // atoms of the optimized residues, leading the binding site
+	int*     nma_atoms;                          // their atom numbers
+	float*   nma_eigen;                          // eigen vectors packed by mode [modes][nma_natoms][3] (aligned)
+	float*   nma_coor_ori;                       // original coordinates [nma_natoms][3]
+	float*   nma_coor;                           // displaced coordinates [nma_natoms][3]
+	float    nma_cutoff;                         // reach of the ligand defining the binding site (-1: from its bonds, 0: whole protein)
+	char*    nma_insite;                         // atoms of the binding site [atm_cnt+1]
+	int      nma_applied;                        // row of the normal grid displacing the protein coordinates (-1: none)
+	int      nma_applied_whole;                  // the whole protein is displaced by that row (else the binding site only)
+	int      nma_moved;                          // protein moved since the last indexing of Vcontacts (1: binding site, 2: whole)
+	int      nma_cache_size;                     // binding sites kept displaced (NMACHE)
+	nmacache* nma_cache;
 	
 	double normalindex_min;                // boundaries of IC for normal mode in GA
 	double normalindex_max;                // ...
@@ -434,7 +478,7 @@ struct FA_Global_struct{
 
 	float sphere[MAX_SPHERE_POINTS][3];  // coordinates of the unit sphere
 
-	char  metopt[3];                     // string for defining optimization method GA or other.
+	char  metopt[3];                     // string for defining optimization method GA, MC (Monte Carlo), DE (differential evolution) or CM (CMA-ES).
 	char  bpkenm[3];                     // string for defining binding pocket enumeration (XS or PB).
 	char  complf[4];                     // string for defining complementarity function (SPH or VCT)
 	char  rngopt[7];                     // range of search
@@ -457,6 +501,8 @@ struct FA_Global_struct{
 	// if dependencies path is not set, dependencies will be searched in base_path unless forced
 
 	char  state_path[MAX_PATH__];          // path leading to files .pause, .stop, .abort
+	char  control[8];                      // job control: POLL (state files), SIGNAL or INOTIFY
+	int   control_interval;                // milliseconds between two polls of the state files
 	char  temp_path[MAX_PATH__];           // path where target.pdb is written, range files (grid/sphere), defaults to working dir
 
 	// minimums used for dynamic allocation
@@ -504,8 +550,11 @@ void   read_pdb(FA_Global* FA,atom** atoms,resid** residue, char* pdb_name);
 void   read_grid(FA_Global* FA,gridpoint** cleftgrid,char file[]);                             // reads cleft sphere file
 void   read_normalgrid(FA_Global* FA,char file[]);                       // reads normal mode grid file
 void   read_eigen(FA_Global* FA,char file[]);                            // reads normal mode grid file
-void   assign_eigen(FA_Global* FA,atom* atoms,resid* residue,int rescnt, int nmodes);  // assigns vector to atoms structure
-void   alter_mode(atom *atoms, resid* residue, float *grid,int res_cnt, int nmodes);  // alter the backbone of the protein using normal mode
+void   assign_eigen(FA_Global* FA,atom* atoms,resid* residue,const gridpoint* cleftgrid);  // packs the eigen vectors of the protein atoms (binding site first)
+void   free_eigen(FA_Global* FA);
+void   alter_mode(FA_Global* FA, atom* atoms, int normalmode, int whole);  // alter the backbone of the protein (binding site or whole) using normal mode
+void   complete_mode(FA_Global* FA, atom* atoms);                          // deforms the rest of the protein by the applied row (output)
+void   print_nma_cache(const FA_Global* FA);
 
 void   wif083(FA_Global* FA);                                            // generates surface points for cffunction
 void   residue_conect(FA_Global* FA,atom* atoms,resid* residue,char file[]);                    // assigns covalent bonds for protein atoms
@@ -532,17 +581,11 @@ void   write_grid(FA_Global* FA, const gridpoint* cleftgrid,char filename[]);
 void   calc_center(FA_Global* FA,atom* atoms,resid* residue);            // calculates center of geometry of protein
 float  calc_rmsd(FA_Global* FA,atom* atoms,resid* residue, gridpoint* cleftgrid, int npar, const double* icv, bool Hungarian);       // calculates rmsd
 float  calc_Hungarian_RMSD(FA_Global* FA, atom* atoms, resid* residue, gridpoint* cleftgrid,int npar, const double* icv); 			// Hungarian algorithm for RMSD calculation
-void   Hungarian(float** matrix, float** matrix_original, int** matrix_cases, int* unique_atom_type, int* row_count, int* column_count, int* row_assigned, int* column_assigned, int* matrix_match, int nTypes, int num_het_atoms);
-int    Hungarian_assign_jobs(float** matrix, float** matrix_original, int** matrix_cases, int* unique_atom_type, int* row_count, int* column_count, int* row_assigned, int* column_assigned, int* matrix_match, int nTypes, int num_het_atoms);
-void   Hungarian_reset_match(int* matrix_match, int nTypes);
-void   Hungarian_reset_assigned_row(int* row_assigned, int nTypes);
-void   Hungarian_reset_assigned_column(int* column_assigned, int nTypes);
-void   Hungarian_reset_row_count(int* row_count, int nTypes);
-void   Hungarian_reset_column_count(int* column_count, int nTypes);
-void   Hungarian_reset_case(int** matrix_case, int nTypes);
-void   Hungarian_update_matrix(float** matrix, int** matrix_case, int nTypes);
-void   Hungarian_draw_line(float** matrix, float** matrix_original, int** matrix_case, int* row_count, int* column_count, int* row_assigned, int* column_assigned, int* matrix_match, int nTypes);
-void   Hungarian_reduce_matrix(float** matrix, float** matrix_original, int nTypes);
+hungarian* build_Hungarian(FA_Global* FA, atom* atoms, resid* residue);  // partitions ligand atoms in type blocks and allocates workspace
+void   free_Hungarian(hungarian* H);
+float  Hungarian_block_identity(const hungarian* H, const atom* atoms, int b); // block cost with atoms matched to themselves (upper bound)
+float  Hungarian_block_bound(hungarian* H, const atom* atoms, int b);     // fills block costs and returns its row/column minima lower bound
+float  Hungarian_block_assignment(hungarian* H, const atom* atoms, int b); // optimal assignment cost of block b
 void   ic_bounds(FA_Global* FA, char* rngopt);              // determines internal coordinates bounds for GA opt.
 void   buildic_point(FA_Global* FA,float coor[],float *dis, float *ang, float *dih); // builds IC for one atom
 void   buildcc_point(FA_Global* FA,float coor[], float dis, float ang, float dih);   // builds CC for one atom
@@ -2,9 +2,6 @@
 #include "Vcontacts.h"
 #include "boinc.h"
 
-// in milliseconds
-# define SLEEP 25
-
 #ifdef _WIN32
 # include <windows.h>
 #else
@@ -29,10 +26,7 @@ int GA(FA_Global* FA, GB_Global* GB,VC_Global* VC,chromosome** chrom,chromosome*
 	//int rrg_flag;
 	//int rrg_skip=100;
 
-	char outfile[MAX_PATH__];
 	int n_chrom_snapshot=0;
-	char gridfile[MAX_PATH__];
-	char gridfilename[MAX_PATH__];
 
 	int geninterval=50;
 	int popszpartition=100;
@@ -42,84 +36,28 @@ int GA(FA_Global* FA, GB_Global* GB,VC_Global* VC,chromosome** chrom,chromosome*
 	char ABORTFILE[MAX_PATH__];
 	char STOPFILE[MAX_PATH__];
 
-	const int INTERVAL = 1; // sleep interval between checking file state
-
-	unsigned int tt = static_cast<unsigned int>(time(0));
-	//tt = (unsigned)1;
-	printf("srand=%u\n", tt);
-	srand(tt);
-	RNGType rng(tt);
-	
-	boost::uniform_int<> one_to_max_int32( 0, MAX_RANDOM_VALUE );
 	boost::variate_generator< RNGType, boost::uniform_int<> >
-		dice(rng, one_to_max_int32);
+		dice(RNGType(), boost::uniform_int<>(0, MAX_RANDOM_VALUE));
     
 	*memchrom=0; //num chrom allocated in memory
 	
-	// for generation random doubles from [0,1[ (mutation crossover operators)   
-	strcpy(PAUSEFILE,FA->state_path);
-#ifdef _WIN32
-	strcat(PAUSEFILE,"\\.pause");
-#else
-	strcat(PAUSEFILE,"/.pause");
-#endif
-    
-  
-	strcpy(ABORTFILE,FA->state_path);
-#ifdef _WIN32
-	strcat(ABORTFILE,"\\.abort");
-#else
-	strcat(ABORTFILE,"/.abort");
-#endif
+	unsigned int tt = init_optimizer(FA,GB,"GA",gainpfile,PAUSEFILE,ABORTFILE,STOPFILE,&geninterval,&popszpartition,dice);
 
-	strcpy(STOPFILE,FA->state_path);
-#ifdef _WIN32
-	strcat(STOPFILE,"\\.stop");
-#else
-	strcat(STOPFILE,"/.stop");
-#endif
-
-	GB->num_genes=FA->npar;
-	if(GB->num_genes == 0){
-		fprintf(stderr,"ERROR: no parameters to optimize.\n");
-		Terminate(1);
+	if(strcmp(GB->selection_model,"ROULETTE") != 0 &&
+	   strcmp(GB->selection_model,"TOURNAMENT") != 0 &&
+	   strcmp(GB->selection_model,"SUS") != 0){
+		fprintf(stderr,"ERROR: Unknown selection model '%s' (ROULETTE, TOURNAMENT or SUS).\n", GB->selection_model);
+		Terminate(10);
 	}
-    
-	printf("num_genes=%d\n",GB->num_genes);
-  
-	//GB->rrg_skip=0;
-	GB->adaptive_ga=0;
-	GB->num_print=10;
-	GB->print_int=1;
-	
-	GB->ssnum = 1000;
-	GB->pbfrac = 1.0;
-	GB->duplicates = 0;
-	GB->intragenes = 0;
-	
-	printf("file in GA is <%s>\n",gainpfile);
-  
-	read_gainputs(FA,GB,&geninterval,&popszpartition,gainpfile);
-
-	(*gene_lim) = (genlim*)malloc(GB->num_genes*sizeof(genlim));
-	if(!(*gene_lim)){
-		fprintf(stderr,"ERROR: memory allocation error for gene_lim.\n");	
-		Terminate(2);
-	}
-	
-	long int at = 0;
-    
-	if(strcmp(GB->pop_init_method,"RANDOM") == 0){
-		set_gene_lim(FA, GB, (*gene_lim));
-		set_bins((*gene_lim),GB->num_genes);
-        
-	}else if(strcmp(GB->pop_init_method,"IPFILE") == 0){
-		at = read_pop_init_file(FA, GB, (*gene_lim), GB->pop_init_file);
-		if(!at){
-			fprintf(stderr,"ERROR: Unknown format for pop init file.\n");
-			Terminate(10);   
-		}
+	if(GB->ls_fraction > 0.0){
+		printf("local search (Solis-Wets) on %.1f%% of the offspring, %d evaluations each\n",
+		       100.0*GB->ls_fraction, GB->ls_max_evals);
 	}
+	printf("selection model is %s", GB->selection_model);
+	if(strcmp(GB->selection_model,"TOURNAMENT") == 0) printf(" (size %d)", GB->tournament_size);
+	printf("\n");
+
+	long int at = init_gene_lim(FA,GB,gene_lim);
         
 	if(GB->print_int < 0){ GB->print_int = 1; }
   
@@ -133,8 +71,61 @@ int GA(FA_Global* FA, GB_Global* GB,VC_Global* VC,chromosome** chrom,chromosome*
 		printf("will partition grid every %d generations considering %d individuals\n",
 		       geninterval, popszpartition);
 	}
+	
+	// the asynchronous engine has no generation barrier at which the grid could be partitioned
+	if(GB->async_workers > 0 && (FA->opt_grid ||
+	   (strcmp(GB->rep_model,"STEADY")!=0 && strcmp(GB->rep_model,"BOOM")!=0))){
+		fprintf(stderr,"WARNING: ASYNCWRK requires REPMODEL STEADY or BOOM and no OPTIGRID, using the generational GA.\n");
+		GB->async_workers = 0;
+	}
+	
+	// islands exchange genes : they must be decoded with the same grid, and the poses are merged from chrom_snapshot
+	if(GB->num_islands > 1 && (FA->opt_grid || strcmp(FA->clustering_algorithm,"OL") == 0)){
+		fprintf(stderr,"WARNING: NUMISLND requires no OPTIGRID and a clustering other than OL, using a single population.\n");
+		GB->num_islands = 1;
+	}
+	if(GB->num_islands > 1 && GB->async_workers > 0){
+		fprintf(stderr,"WARNING: NUMISLND and ASYNCWRK cannot be combined, using the generational GA on each island.\n");
+		GB->async_workers = 0;
+	}
+	if(GB->migration_interval < 1){ GB->migration_interval = 1; }
+	if(GB->migration_size < 0){ GB->migration_size = 0; }
+	
+	// replicas share the grid (OPTIGRID would slice it for the next ones), parallel ones are merged from chrom_snapshot
+	if(GB->num_replicas > 1){
+		if(FA->opt_grid){
+			fprintf(stderr,"WARNING: REPLICAS requires no OPTIGRID, using a single population.\n");
+			GB->num_replicas = 1;
+		}else if(GB->num_islands > 1){
+			fprintf(stderr,"WARNING: REPLICAS and NUMISLND cannot be combined, using the islands.\n");
+			GB->num_replicas = 1;
+		}else if(GB->replica_procs > 1 && (GB->async_workers > 0 || strcmp(FA->clustering_algorithm,"OL") == 0)){
+			fprintf(stderr,"WARNING: parallel REPLICAS require no ASYNCWRK and a clustering other than OL, running them serially.\n");
+			GB->replica_procs = 1;
+		}
+	}
+	if(GB->num_replicas < 1){ GB->num_replicas = 1; }
+	
+	// the checkpoint holds a single population, its grid and chrom_snapshot
+	if((GB->checkpoint_interval > 0 || FA->resume) &&
+	   (FA->opt_grid || GB->num_islands > 1 || (GB->num_replicas > 1 && GB->replica_procs > 1) ||
+	    GB->async_workers > 0 || strcmp(FA->clustering_algorithm,"OL") == 0)){
+		fprintf(stderr,"WARNING: CHKPOINT and RESUME require no OPTIGRID, NUMISLND, parallel REPLICAS, ASYNCWRK or CLUSTA OL, the GA is not checkpointed.\n");
+		GB->checkpoint_interval = 0;
+		FA->resume = 0;
+	}
+	if(GB->checkpoint_interval > 0){
+		printf("checkpoint of the GA every %d generations (and on SIGTERM) in %s.chk\n", GB->checkpoint_interval, FA->rrgfile);
+	}
+	
+	// the replicas are run by islands without migration
+	if(GB->num_replicas > 1 && GB->replica_procs > 1){
+		GB->num_islands = (GB->replica_procs < GB->num_replicas) ? GB->replica_procs : GB->num_replicas;
+		GB->migration_size = 0;
+	}
         
 	validate_dups(GB, (*gene_lim), GB->num_genes);
+	build_gene_decoding(GB, (*gene_lim));
 
 	(*memchrom) = GB->num_chrom;
 	if(strcmp(GB->rep_model,"STEADY")==0){
@@ -147,49 +138,20 @@ int GA(FA_Global* FA, GB_Global* GB,VC_Global* VC,chromosome** chrom,chromosome*
 	//printf("num_genes=%d\n",GB->num_genes);
 
 	// *** chrom
-	(*chrom) = (chromosome*)malloc((*memchrom)*sizeof(chromosome));
-	if(!(*chrom)){
-		fprintf(stderr,"ERROR: memory allocation error for chrom.\n");
-		Terminate(2);
-	}
-	
-	for(i=0;i<(*memchrom);++i)
-	{
-		(*chrom)[i].genes = (gene*)malloc(GB->num_genes*sizeof(gene));
-
-		if(!(*chrom)[i].genes){
-			fprintf(stderr,"ERROR: memory allocation error for chrom[%d].genes.\n",i);	
-			Terminate(2);
-		}
-
-		(*chrom)[i].app_evalue = 0.0;
-		(*chrom)[i].evalue = 0.0;
-		(*chrom)[i].fitnes = 0.0;
-		(*chrom)[i].status = ' ';
-	}
+	alloc_chromosomes(GB,chrom,(*memchrom));
 
 	// *** chrom_snapshot
-	(*chrom_snapshot) = (chromosome*)malloc((GB->num_chrom*GB->max_generations)*sizeof(chromosome));
-	if(!(*chrom_snapshot))
-	{
-		fprintf(stderr,"ERROR: memory allocation error for chrom_snapshot.\n");
-		Terminate(2);
-	}
+	init_snapshot(FA,GB,atoms,residue);
 	
-	for(i=0;i<(GB->num_chrom*GB->max_generations);++i)
-	{
-		(*chrom_snapshot)[i].genes = (gene*)malloc(GB->num_genes*sizeof(gene));
-
-		if(!(*chrom_snapshot)[i].genes){
-			fprintf(stderr,"ERROR: memory allocation error for chrom_snapshot[%d].genes.\n",i);	
-			Terminate(2);
+	// the surrogate learns from chrom_snapshot and screens the offspring of reproduce
+	if(GB->surrogate_k > 0){
+		if(GB->snapshot == NULL || GB->async_workers > 0){
+			fprintf(stderr,"WARNING: SURROGAT requires a clustering other than OL and no ASYNCWRK, all offspring are scored.\n");
+		}else{
+			GB->surrogate = build_surrogate(GB);
+			printf("offspring screened by a surrogate of the CF (%d nearest neighbours, margin %.2f)\n",
+			       GB->surrogate_k, GB->surrogate_margin);
 		}
-
-		(*chrom_snapshot)[i].app_evalue = 0.0;
-		(*chrom_snapshot)[i].evalue = 0.0;
-		(*chrom_snapshot)[i].fitnes = 0.0;
-		(*chrom_snapshot)[i].status = ' ';
-		//printf("chrom_snapshot[%d] allocated at address %p!\n", i, &(*chrom_snapshot)[i]);
 	}
 	
 	printf("alpha %lf peaks %lf scale %lf\n",GB->alpha,GB->peaks,GB->scale);
@@ -213,165 +175,491 @@ int GA(FA_Global* FA, GB_Global* GB,VC_Global* VC,chromosome** chrom,chromosome*
   
 	map<string, int> duplicates;
 	
-	populate_chromosomes(FA,GB,VC,(*chrom),(*gene_lim),atoms,residue,(*cleftgrid),
-			     GB->pop_init_method,target,GB->pop_init_file,at,0,print,dice,duplicates);
-	//}
+	// each island evolves its own population from its own seed (replicas are seeded below)
+	if(build_islands(FA,GB) > 0 && GB->num_replicas == 1){
+		tt += (unsigned int)GB->island;
+		srand(tt);
+		dice.engine().seed(tt);
+	}
 	
-	//print_pop((*chrom),(*gene_lim),GB->num_chrom,GB->num_genes);
-  
-	/*
-	  for(i=0;i<GB->num_genes;i++){
-	  printf("%d %f %f %f\n",i,GB->min_opt_par[i],GB->max_opt_par[i],GB->del_opt_par[i]);
-	  PAUSE;
-	  }
-	*/
-    
 	int save_num_chrom = (int)(GB->num_chrom*SAVE_CHROM_FRACTION);
 	int nrejected = 0;
+	int num_generations;
 	
-	////////////////////////////////
-	////// Genetic Algorithm ///////
-	////////////////////////////////
-	for(i=0;i<GB->max_generations;i++)
+	// each process runs its share of the replicas (a single population without REPLICAS)
+	int first_replica = (GB->num_replicas > 1) ? GB->island : 0;
+	int step_replica = (GB->num_replicas > 1) ? GB->num_islands : 1;
+	
+	int resume_replica = -1;
+	int resume_generation = 0;
+	double resume_elapsed = 0.0;
+	if(FA->resume && read_checkpoint(FA,GB,(*chrom),&resume_replica,&resume_generation,&resume_elapsed,dice,duplicates)){
+		first_replica = resume_replica;
+	}
+	
+	if(GB->checkpoint_interval > 0) install_checkpoint_signals(true);
+	
+	for(int replica=first_replica; replica<GB->num_replicas; replica+=step_replica)
 	{
-		///////////////////////////////////////////////////
+		int first_generation = 0;
+		
+		// .stop also ends the remaining replicas
+		if(replica != first_replica){
+			state=check_state(PAUSEFILE,ABORTFILE,STOPFILE,STATE_INTERVAL);
+			if(state == -1){
+				abort_islands(GB);
+				return(state);
+			}else if(state == 1){
+				break;
+			}
+		}
+		
+		time_t ga_start = time(NULL);
+		
+		if(replica == resume_replica){
+			// the population, generators and counters come from the checkpoint
+			ga_start -= (time_t)resume_elapsed;
+			first_generation = resume_generation;
+		}else{
+			// each replica starts from its own seed
+			if(GB->num_replicas > 1){
+				srand(tt + (unsigned int)replica);
+				dice.engine().seed(tt + (unsigned int)replica);
+				duplicates.clear();
+				printf("replica %d of %d (srand=%u)\n", replica+1, GB->num_replicas, tt + (unsigned int)replica);
+			}
+			
+			GB->conv_best = DBL_MAX;
+			GB->conv_stall = 0;
+			GB->conv_evaluations = GB->num_evaluations;
+			
+			populate_chromosomes(FA,GB,VC,(*chrom),(*gene_lim),atoms,residue,(*cleftgrid),
+					     GB->pop_init_method,target,GB->pop_init_file,at,0,print,dice,duplicates);
+		}
+		//}
+	
+		//print_pop((*chrom),(*gene_lim),GB->num_chrom,GB->num_genes);
+  
+		/*
+		  for(i=0;i<GB->num_genes;i++){
+		  printf("%d %f %f %f\n",i,GB->min_opt_par[i],GB->max_opt_par[i],GB->del_opt_par[i]);
+		  PAUSE;
+		  }
+		*/
+    
+		num_generations = GB->max_generations;
+	
+		// the asynchronous engine replaces the generational loop
+		if(GB->async_workers > 0){
+			state = async_GA(FA,GB,VC,(*chrom),(*gene_lim),atoms,residue,(*cleftgrid),dice,duplicates,
+					 PAUSEFILE,ABORTFILE,STOPFILE,STATE_INTERVAL,ga_start,&n_chrom_snapshot,target);
+			if(state == -1){
+				abort_islands(GB);
+				return(state);
+			}else if(state == 1){
+				num_generations = 0;
+			}
+		}
+	
+		////////////////////////////////
+		////// Genetic Algorithm ///////
+		////////////////////////////////
+		for(i=first_generation;i<num_generations;i++)
+		{
+			///////////////////////////////////////////////////
 
-		state=check_state(PAUSEFILE,ABORTFILE,STOPFILE,INTERVAL);
+			state=check_state(PAUSEFILE,ABORTFILE,STOPFILE,STATE_INTERVAL);
     
-		if(state == -1){ 
-			return(state); 
-		}else if(state == 1){ 
-			break;
+			if(state == -1){ 
+				abort_islands(GB);
+				return(state); 
+			}else if(state == 1){ 
+				break;
+			}
+
+			state = GA_generation(FA,GB,VC,chrom,gene_lim,atoms,residue,cleftgrid,i,replica,ga_start,
+					      at,geninterval,popszpartition,save_num_chrom,&print,&nrejected,
+					      &n_chrom_snapshot,dice,duplicates,target);
+			if(state == 1) break;
 		}
+		
+		if(GB->num_replicas > 1){
+			sort_population((*chrom),GB->num_chrom);
+			printf("replica %d: best CF %.3f after %d generations\n", replica+1, (*chrom)[0].app_evalue, (i < num_generations) ? i+1 : i);
+		}
+	}
+	
+	// the islands exit here, the master merges their chrom_snapshot
+	n_chrom_snapshot += join_islands(FA,GB);
+	
+	// the run is over : RESUME would start a new one
+	if(GB->checkpoint_interval > 0){
+		install_checkpoint_signals(false);
+		remove_checkpoint(FA);
+	}
+	
+	printf("%d ligand conformers rejected\n", nrejected);
+	printf("%ld evaluations of the scoring function\n", GB->num_evaluations);
+	print_surrogate(GB->surrogate,GB->num_evaluations);
+	
+	sort_population((*chrom),GB->num_chrom);
 
-		////////////////////////////////
+	return close_optimizer(FA,GB,(*chrom),(*gene_lim),i+1,GB->num_chrom,n_chrom_snapshot,chrom_snapshot);
+}
+
+/***********************************************************************/
+/*        1         2         3         4         5         6          */
+/*234567890123456789012345678901234567890123456789012345678901234567890*/
+/*        1         2         3         4         5         6         7*/
+/***********************************************************************/
+/* one generation of the GA (after check_state) : grid partition, reproduction,
+   snapshot, migration, convergence and checkpoint.
+   Returns 1 when the population has converged, 0 otherwise (after the
+   checkpoint asked by SIGTERM, the process is terminated).
+*/
+int GA_generation(FA_Global* FA,GB_Global* GB,VC_Global* VC,chromosome** chrom,genlim** gene_lim,
+		  atom* atoms,resid* residue,gridpoint** cleftgrid,int gen,int replica,time_t ga_start,
+		  long int at,int geninterval,int popszpartition,int save_num_chrom,int* print,int* nrejected,
+		  int* n_chrom_snapshot,boost::variate_generator< RNGType, boost::uniform_int<> > & dice,
+		  map<string, int> & duplicates,
+		  cfstr (*target)(FA_Global*,VC_Global*,atom*,resid*,gridpoint*,int,double*)){
+
+	char gridfile[MAX_PATH__];
+	char gridfilename[MAX_PATH__];
 
-		// BOINC CLIENT GUI PROGRESS BAR
+	// BOINC CLIENT GUI PROGRESS BAR
 #ifdef ENABLE_BOINC
-		boinc_fraction_done((double)(i+1)/(double)GB->max_generations);
+	boinc_fraction_done((double)(gen+1)/(double)GB->max_generations);
 #endif
 
-		////////////////////////////////
-		
-		//printf("chrom_snapshot[%d] at address %p\n", i*GB->num_chrom, chrom_snapshot[i*GB->num_chrom]);
-		if (	FA->opt_grid                    &&     // if a OPTGRD line was specified
-		    	((i+1) % geninterval) == 0      &&     // is factor of
-		    	(i+1) != GB->max_generations 	)      // discard the last generation
-		{
+	////////////////////////////////
+
+	//printf("chrom_snapshot[%d] at address %p\n", gen*GB->num_chrom, chrom_snapshot[gen*GB->num_chrom]);
+	if (	FA->opt_grid                    &&     // if a OPTGRD line was specified
+	    	((gen+1) % geninterval) == 0      &&     // is factor of
+	    	(gen+1) != GB->max_generations 	)      // discard the last generation
+	{
       
-			//need to sort in decreasing order of energy
-			QuickSort((*chrom),0,GB->num_chrom-1,true);
-			
-			//printf("Partionning grid...(%d)\n",FA->popszpartition);
-			partition_grid(FA,(*chrom),(*gene_lim),atoms,residue,cleftgrid,popszpartition,1);
-			
-			if(FA->output_range){
+		//need to sort in decreasing order of energy
+		sort_population((*chrom),GB->num_chrom);
+	
+		//printf("Partionning grid...(%d)\n",FA->popszpartition);
+		partition_grid(FA,(*chrom),(*gene_lim),atoms,residue,cleftgrid,popszpartition,1);
+	
+		if(FA->output_range){
 #ifdef _WIN32
-				sprintf(gridfilename,"\\grid.%d.prt.pdb",i+1);
+			sprintf(gridfilename,"\\grid.%d.prt.pdb",gen+1);
 #else
-				sprintf(gridfilename,"/grid.%d.prt.pdb",i+1);
+			sprintf(gridfilename,"/grid.%d.prt.pdb",gen+1);
 #endif
-				strcpy(gridfile,FA->temp_path);
-				strcat(gridfile,gridfilename);
+			strcpy(gridfile,FA->temp_path);
+			strcat(gridfile,gridfilename);
 
-				write_grid(FA,(*cleftgrid),gridfile);
-			}
+			write_grid(FA,(*cleftgrid),gridfile);
+		}
       
-			slice_grid(FA,(*gene_lim),atoms,residue,cleftgrid);
+		slice_grid(FA,(*gene_lim),atoms,residue,cleftgrid);
       
-			if(FA->output_range){
+		if(FA->output_range){
                 
 #ifdef _WIN32
-				sprintf(gridfilename,"\\grid.%d.slc.pdb",i+1);
+			sprintf(gridfilename,"\\grid.%d.slc.pdb",gen+1);
 #else
-				sprintf(gridfilename,"/grid.%d.slc.pdb",i+1);
+			sprintf(gridfilename,"/grid.%d.slc.pdb",gen+1);
 #endif
                 
-				strcpy(gridfile,FA->temp_path);
-				strcat(gridfile,gridfilename);
+			strcpy(gridfile,FA->temp_path);
+			strcat(gridfile,gridfilename);
                 
-				write_grid(FA,(*cleftgrid),gridfile);
-			}
+			write_grid(FA,(*cleftgrid),gridfile);
+		}
       
-			validate_dups(GB, (*gene_lim), GB->num_genes);
+		validate_dups(GB, (*gene_lim), GB->num_genes);
+		build_gene_decoding(GB, (*gene_lim));
 
-			//repopulate unselected individuals
-			populate_chromosomes(FA,GB,VC,(*chrom),(*gene_lim),atoms,residue,(*cleftgrid),
-					     GB->pop_init_method,target,GB->pop_init_file,at,popszpartition,print,dice,duplicates);
+		//repopulate unselected individuals
+		populate_chromosomes(FA,GB,VC,(*chrom),(*gene_lim),atoms,residue,(*cleftgrid),
+				     GB->pop_init_method,target,GB->pop_init_file,at,popszpartition,*print,dice,duplicates);
+	}
+
+	*print = ( (gen+1) % GB->print_int == 0 ) ? 1 : 0;
+	//if(*print) { printf("Generation: %5d\n",gen+1); }
+
+	//print_par(chrom,gene_lim,20,GB->num_genes);
+	//PAUSE;
+
+	/*
+	  rrg_flag=0;
+	  if((gen/rrg_skip)*rrg_skip == gen) rrg_flag=1;
+	  if((rrg_flag==1) && (GB->outgen==1)){
+	  if(FA->refstructure == 1){
+	  sprintf(tmp_rrgfile,"%s_%d.rrg",FA->rrgfile,gen);
+	  //printf("%s\n",tmp_rrgfile);
+	  //PAUSE;
+	  write_rrg(FA,GB,(*chrom),(*gene_lim),atoms,residue,(*cleftgrid),tmp_rrgfile);
+	  }
+	  }
+	*/
+
+
+	//before reproducing for an extra generation, evaluate if population has converged.
+	//before calculating get avg and max fitness of the whole pop.
+	fitness_stats(GB,(*chrom),GB->num_chrom);
+
+	//printf("------fitness stats-------\navg=%8.3f\tmax=%8.3f\n",GB->fit_avg,GB->fit_max);
+	        //getchar();
+
+	*nrejected = reproduce(FA,GB,VC,(*chrom),(*gene_lim),atoms,residue,(*cleftgrid),
+			      GB->rep_model,GB->mut_rate,GB->cross_rate,*print,dice,duplicates,target);
+
+	*n_chrom_snapshot += save_poses(FA,GB,(*chrom),(*gene_lim),atoms,residue,(*cleftgrid),save_num_chrom);
+
+	if(GB->num_islands > 1 && GB->migration_size > 0 && (gen+1) % GB->migration_interval == 0){
+		migrate_islands(GB,(*chrom),gen+1,duplicates);
+	}
+
+	if(check_convergence(GB,(*chrom),gen+1,ga_start)) return(1);
+
+	if(strcmp(GB->fitness_model,"PSHARE")==0){
+		if(*print){
+			QuickSort((*chrom),0,GB->num_chrom-1,false);
+			printf("best by fitnes\n");
+			print_par((*chrom),(*gene_lim),GB->num_print,GB->num_genes, stdout);
+		}else{
+			// fitness_stats only reads the fittest half of the population
+			partition_fitness((*chrom),GB->num_chrom,(GB->num_chrom+1)/2);
 		}
+	}
+	
+	// periodic checkpoint, and a last one when the process is asked to terminate
+	if(GB->checkpoint_interval > 0){
+		// srand is reseeded at each generation, a checkpoint can then be written after any of them
+		unsigned int seed = (unsigned int)dice();
+		srand(seed);
 		
-		print = ( (i+1) % GB->print_int == 0 ) ? 1 : 0;
-		//if(print) { printf("Generation: %5d\n",i+1); }
+		if((gen+1) % GB->checkpoint_interval == 0 || checkpoint_requested()){
+			write_checkpoint(FA,GB,(*chrom),replica,gen+1,ga_start,seed,dice,duplicates);
+		}
+		if(checkpoint_requested()){
+			printf("checkpoint written at generation %d, terminating on SIGTERM\n", gen+1);
+			terminate_after_checkpoint();
+		}
+	}
 
-		//print_par(chrom,gene_lim,20,GB->num_genes);
-		//PAUSE;
+	return(0);
+}
 
-		/*
-		  rrg_flag=0;
-		  if((i/rrg_skip)*rrg_skip == i) rrg_flag=1;
-		  if((rrg_flag==1) && (GB->outgen==1)){
-		  if(FA->refstructure == 1){
-		  sprintf(tmp_rrgfile,"%s_%d.rrg",FA->rrgfile,i);
-		  //printf("%s\n",tmp_rrgfile);
-		  //PAUSE;
-		  write_rrg(FA,GB,(*chrom),(*gene_lim),atoms,residue,(*cleftgrid),tmp_rrgfile);
-		  }
-		  }
-		*/
-		
-		
-		//before reproducing for an extra generation, evaluate if population has converged.
-		//before calculating get avg and max fitness of the whole pop.
-		fitness_stats(GB,(*chrom),GB->num_chrom);
-		
-		//printf("------fitness stats-------\navg=%8.3f\tmax=%8.3f\n",GB->fit_avg,GB->fit_max);
-        //getchar();
+/***********************************************************************/
+/*        1         2         3         4         5         6          */
+/*234567890123456789012345678901234567890123456789012345678901234567890*/
+/*        1         2         3         4         5         6         7*/
+/***********************************************************************/
+// default values of the optimization parameters (before read_gainputs)
+void set_ga_defaults(GB_Global* GB){
+	
+	//GB->rrg_skip=0;
+	GB->adaptive_ga=0;
+	GB->num_print=10;
+	GB->print_int=1;
+	
+	GB->ssnum = 1000;
+	GB->pbfrac = 1.0;
+	GB->duplicates = 0;
+	GB->intragenes = 0;
+	GB->snapshot_size = 0;
+	GB->snapshot_spill = 0;
+	strcpy(GB->selection_model,"ROULETTE");
+	GB->tournament_size = 2;
+	GB->conv_generations = 0;
+	GB->conv_delta = 0.0;
+	GB->conv_diversity = 0.0;
+	GB->max_walltime = 0.0;
+	GB->max_evaluations = 0;
+	GB->num_evaluations = 0;
+	GB->conv_evaluations = 0;
+	GB->ls_fraction = 0.0;
+	GB->ls_max_evals = 30;
+	GB->ls_rho = 2.0;
+	GB->async_workers = 0;
+	GB->num_islands = 1;
+	GB->migration_interval = 10;
+	GB->migration_size = 1;
+	GB->island = 0;
+	GB->island_ring = NULL;
+	GB->num_replicas = 1;
+	GB->replica_procs = 1;
+	GB->checkpoint_interval = 0;
+	GB->mc_replicas = 8;
+	GB->mc_steps = 10000;
+	GB->mc_tmin = 1.0;
+	GB->mc_tmax = 50.0;
+	GB->mc_anneal = 1.0;
+	GB->mc_swap_interval = 10;
+	GB->mc_step_size = 2.0;
+	strcpy(GB->de_strategy,"RAND1BIN");
+	GB->de_weight = 0.5;
+	GB->de_crossover = 0.9;
+	GB->cma_popsize = 0;
+	GB->cma_sigma = 0.3;
+	GB->cma_restarts = 5;
+	GB->surrogate_k = 0;
+	GB->surrogate_margin = 0.0;
+	GB->surrogate = NULL;
+}
 
-		nrejected = reproduce(FA,GB,VC,(*chrom),(*gene_lim),atoms,residue,(*cleftgrid),
-				      GB->rep_model,GB->mut_rate,GB->cross_rate,print,dice,duplicates,target);
-		
-		save_snapshot(&(*chrom_snapshot)[i*GB->num_chrom],(*chrom),save_num_chrom,GB->num_genes);
-		n_chrom_snapshot += save_num_chrom;
-		
-		
-		if(strcmp(GB->fitness_model,"PSHARE")==0){
-			QuickSort((*chrom),0,GB->num_chrom-1,false);
+// .pause, .abort and .stop files of the state directory
+void set_state_files(FA_Global* FA, char* pausefile, char* abortfile, char* stopfile){
+	
+	strcpy(pausefile,FA->state_path);
+	strcpy(abortfile,FA->state_path);
+	strcpy(stopfile,FA->state_path);
+#ifdef _WIN32
+	strcat(pausefile,"\\.pause");
+	strcat(abortfile,"\\.abort");
+	strcat(stopfile,"\\.stop");
+#else
+	strcat(pausefile,"/.pause");
+	strcat(abortfile,"/.abort");
+	strcat(stopfile,"/.stop");
+#endif
+}
 
-			if(print){
-				printf("best by fitnes\n");
-				print_par((*chrom),(*gene_lim),GB->num_print,GB->num_genes, stdout);
-			}
+// seeds srand and dice with the time and reads the optimization parameters (returns the seed)
+unsigned int init_optimizer(FA_Global* FA, GB_Global* GB, const char* name, char gainpfile[],
+			    char* pausefile, char* abortfile, char* stopfile, int* geninterval, int* popszpartition,
+			    boost::variate_generator< RNGType, boost::uniform_int<> > & dice){
+	
+	int interval=50;
+	int partition=100;
+	
+	unsigned int tt = static_cast<unsigned int>(time(0));
+	//tt = (unsigned)1;
+	printf("srand=%u\n", tt);
+	srand(tt);
+	dice.engine().seed(tt);
+	
+	set_state_files(FA,pausefile,abortfile,stopfile);
+	
+	GB->num_genes=FA->npar;
+	if(GB->num_genes == 0){
+		fprintf(stderr,"ERROR: no parameters to optimize.\n");
+		Terminate(1);
+	}
+	
+	printf("num_genes=%d\n",GB->num_genes);
+	
+	set_ga_defaults(GB);
+	
+	printf("file in %s is <%s>\n",name,gainpfile);
+	
+	// the grid partition (OPTIGRID) is only done by the GA
+	read_gainputs(FA,GB,(geninterval != NULL) ? geninterval : &interval,
+		      (popszpartition != NULL) ? popszpartition : &partition,gainpfile);
+	
+	return tt;
+}
+
+// allocates the genes limits and sets them from the optimized parameters (RANDOM) or from the population file (IPFILE)
+long int init_gene_lim(FA_Global* FA, GB_Global* GB, genlim** gene_lim){
+	
+	long int at = 0;
+	
+	(*gene_lim) = (genlim*)malloc(GB->num_genes*sizeof(genlim));
+	if(!(*gene_lim)){
+		fprintf(stderr,"ERROR: memory allocation error for gene_lim.\n");	
+		Terminate(2);
+	}
+	
+	if(strcmp(GB->pop_init_method,"RANDOM") == 0){
+		set_gene_lim(FA, GB, (*gene_lim));
+		set_bins((*gene_lim),GB->num_genes);
+        
+	}else if(strcmp(GB->pop_init_method,"IPFILE") == 0){
+		at = read_pop_init_file(FA, GB, (*gene_lim), GB->pop_init_file);
+		if(!at){
+			fprintf(stderr,"ERROR: Unknown format for pop init file.\n");
+			Terminate(10);   
 		}
-		
 	}
 	
-	printf("%d ligand conformers rejected\n", nrejected);
+	return at;
+}
+
+// allocates memchrom chromosomes (parents and offspring) with their genes in one contiguous block
+void alloc_chromosomes(GB_Global* GB, chromosome** chrom, int memchrom){
+	
+	(*chrom) = (chromosome*)malloc(memchrom*sizeof(chromosome));
+	if(!(*chrom)){
+		fprintf(stderr,"ERROR: memory allocation error for chrom.\n");
+		Terminate(2);
+	}
 	
-	QuickSort((*chrom),0,GB->num_chrom-1,true);
+	GB->gene_arena = alloc_gene_arena(memchrom,GB->num_genes);
+	if(!GB->gene_arena){
+		fprintf(stderr,"ERROR: memory allocation error for chrom genes.\n");
+		Terminate(2);
+	}
+	
+	for(int i=0;i<memchrom;++i)
+	{
+		(*chrom)[i].genes = &GB->gene_arena[(size_t)i*GB->num_genes];
 
+		(*chrom)[i].app_evalue = 0.0;
+		(*chrom)[i].evalue = 0.0;
+		(*chrom)[i].fitnes = 0.0;
+		(*chrom)[i].status = ' ';
+	}
+}
+
+// chrom_snapshot (not needed when poses are clustered online)
+void init_snapshot(FA_Global* FA, GB_Global* GB, atom* atoms, resid* residue){
+	
+	GB->online_cluster = NULL;
+	GB->snapshot = NULL;
+	if(strcmp(FA->clustering_algorithm,"OL") == 0)
+	{
+		GB->online_cluster = build_Online_clustering(FA,GB,atoms,residue);
+	}
+	else
+	{
+		GB->snapshot = build_snapshot(FA,GB);
+		printf("chrom_snapshot holds up to %d chromosomes in memory%s\n", GB->snapshot->capacity, (GB->snapshot->spill ? " (spilled to disk when full)" : ""));
+	}
+}
+
+// saves the num_chrom first chromosomes in chrom_snapshot or clusters them online (returns the number of poses added)
+int save_poses(FA_Global* FA, GB_Global* GB, const chromosome* chrom, const genlim* gene_lim,
+	       atom* atoms, resid* residue, gridpoint* cleftgrid, int num_chrom){
+	
+	if(GB->online_cluster != NULL)
+	{
+		return Online_cluster_add(FA,GB,GB->online_cluster,chrom,gene_lim,atoms,residue,cleftgrid,num_chrom);
+	}
+	else
+	{
+		return save_snapshot(GB->snapshot,chrom,num_chrom);
+	}
+}
+
+// writes the final population to <rrgfile>_par.res and closes chrom_snapshot (returns the number of poses)
+int close_optimizer(FA_Global* FA, GB_Global* GB, const chromosome* chrom, const genlim* gene_lim,
+		    int gen, int num_chrom, int n_chrom_snapshot, chromosome** chrom_snapshot){
+	
 #ifndef ENABLE_BOINC
+	char outfile[MAX_PATH__];
+	
         // do not write binary files to continue simulations
 	strcpy(outfile,FA->rrgfile);
 	strcat(outfile,"_par.res");
-	write_par((*chrom),(*gene_lim),i+1,outfile,GB->num_chrom,GB->num_genes);
+	write_par(chrom,gene_lim,gen,outfile,num_chrom,GB->num_genes);
 #endif
 	
-	printf("sorting chrom_snapshot\n");
-	//quicksort_app_evalue((*chrom_snapshot),0,n_chrom_snapshot-1);
-	QuickSort((*chrom_snapshot),0,n_chrom_snapshot-1,true);
-	
-	/*
-	  printf("Save snapshot == END ==\n");
-	  print_par((*chrom_snapshot),(*gene_lim),n_chrom_snapshot,GB->num_genes);
-	*/
-	
-	printf("removing duplicates\n");
-	n_chrom_snapshot = remove_dups((*chrom_snapshot),n_chrom_snapshot,GB->num_genes);
+	// poses were already clustered (and duplicates removed) during the search
+	if(GB->online_cluster != NULL) return n_chrom_snapshot;
 	
-	/*	
-		printf("Save snapshot == END ==\n");
-		print_par((*chrom_snapshot),(*gene_lim),n_chrom_snapshot,GB->num_genes);
-	*/
+	// sort (merging spilled runs) and remove duplicates
+	n_chrom_snapshot = close_snapshot(GB->snapshot);
+	(*chrom_snapshot) = GB->snapshot->chrom;
 	
 	return n_chrom_snapshot;
 }
@@ -384,68 +672,39 @@ void copy_chrom(chromosome* dest, const chromosome* src, int num_genes){
 	dest->fitnes = src->fitnes;
 	dest->status = src->status;
 	
-	for(int j=0; j<num_genes; j++){
-	        dest->genes[j].to_ic = src->genes[j].to_ic;
-		dest->genes[j].to_int32 = src->genes[j].to_int32;
-	}
+	memcpy(dest->genes,src->genes,num_genes*sizeof(gene));
 }
 
-/***********************************************************************/
-/*        1         2         3         4         5         6          */
-/*234567890123456789012345678901234567890123456789012345678901234567890*/
-/*        1         2         3         4         5         6         7*/
-/***********************************************************************/
-void save_snapshot(chromosome* chrom_snapshot, const chromosome* chrom, int num_chrom, int num_genes){
+// allocates the genes of num_chrom chromosomes as one aligned block (NULL on failure)
+gene* alloc_gene_arena(int num_chrom, int num_genes){
+	
+	size_t size = (size_t)num_chrom*num_genes*sizeof(gene);
+	void* arena = NULL;
+	
+	if(size == 0) size = sizeof(gene);
 	
-	for(int i=0; i<num_chrom; i++)
-		copy_chrom(&chrom_snapshot[i],&chrom[i],num_genes);
+#ifdef _WIN32
+	arena = _aligned_malloc(size,GENE_ARENA_ALIGN);
+#else
+	if(posix_memalign(&arena,GENE_ARENA_ALIGN,size) != 0) arena = NULL;
+#endif
+	if(arena != NULL) memset(arena,0,size);
 	
+	return (gene*)arena;
 }
 
-/***********************************************************************/
-/*        1         2         3         4         5         6          */
-/*234567890123456789012345678901234567890123456789012345678901234567890*/
-/*        1         2         3         4         5         6         7*/
-/***********************************************************************/
-int check_state(char* pausefile, char* abortfile, char* stopfile, int interval){
-	FILE* STATE;
-  
-	STATE = NULL;
-
-	// try and open pause/stop file
-	// (works with PyMOL interface)
-  
-	STATE = fopen(pausefile,"r");
-	if(STATE != NULL) {
-		do {
-			fclose(STATE);
-
-# ifdef _WIN32
-			Sleep(SLEEP);
-# else
-			usleep(SLEEP*1000);
-# endif
-			STATE = fopen(pausefile,"r");
+void free_gene_arena(gene* arena){
+	
+	if(arena == NULL) return;
+	
+#ifdef _WIN32
+	_aligned_free(arena);
+#else
+	free(arena);
+#endif
+}
 
-		}while(STATE != NULL);
-	}
-  
-	STATE = fopen(abortfile,"r");
-	if(STATE != NULL) {
-		fclose(STATE);
-		printf("manual aborting\n");
-		return -1;
-	}
 
-	STATE = fopen(stopfile,"r");
-	if(STATE != NULL) {
-		fclose(STATE);
-		printf("simulation stopped prematurely\n");
-		return 1;
-	}
-  
-	return 0;
-}
 /***********************************************************************/
 /*        1         2         3         4         5         6          */
 /*234567890123456789012345678901234567890123456789012345678901234567890*/
@@ -492,25 +751,151 @@ void adapt_prob(GB_Global* GB,double fit1, double fit2, double* mutp, double* cr
 		GB->fit_high=fit2;
 		GB->fit_low=fit1;
 	}
-
-	//crossp=k1 when high=avg
-	//mutp=k2 when high=avg
-	//crossp/mutp=0 when high=max
-
-	//calculate new probabilities (pc/pm)
-	if (GB->fit_high > GB->fit_avg) *crossp = GB->k1*(GB->fit_max-GB->fit_high)/(GB->fit_max-GB->fit_avg);
-	else *crossp = GB->k3;
-  
-	if (GB->fit_low > GB->fit_avg) *mutp = GB->k2*(GB->fit_max-GB->fit_low)/(GB->fit_max-GB->fit_avg);
-	else *mutp = GB->k4;
-  
-	/*
-	  printf("f'=%.1f\tf=%.1f\tfmax=%.1f\tfavg=%.1f\t\tPc=%5.3f\tPm=%5.3f\n",
-	  GB->fit_high,GB->fit_low,GB->fit_max,GB->fit_avg,*crossp,*mutp);
-	*/
-
-	return;
+
+	//crossp=k1 when high=avg
+	//mutp=k2 when high=avg
+	//crossp/mutp=0 when high=max
+
+	//calculate new probabilities (pc/pm)
+	if (GB->fit_high > GB->fit_avg) *crossp = GB->k1*(GB->fit_max-GB->fit_high)/(GB->fit_max-GB->fit_avg);
+	else *crossp = GB->k3;
+  
+	if (GB->fit_low > GB->fit_avg) *mutp = GB->k2*(GB->fit_max-GB->fit_low)/(GB->fit_max-GB->fit_avg);
+	else *mutp = GB->k4;
+  
+	/*
+	  printf("f'=%.1f\tf=%.1f\tfmax=%.1f\tfavg=%.1f\t\tPc=%5.3f\tPm=%5.3f\n",
+	  GB->fit_high,GB->fit_low,GB->fit_max,GB->fit_avg,*crossp,*mutp);
+	*/
+
+	return;
+}
+/***********************************************************************/
+/*        1         2         3         4         5         6          */
+/*234567890123456789012345678901234567890123456789012345678901234567890*/
+/*        1         2         3         4         5         6         7*/
+/***********************************************************************/
+/* returns 1 when the GA should stop after generation gen:
+   CONVGENS : the best apparent CF did not improve by more than conv_delta for conv_generations generations
+   CONVDIVR : the mean RMSP of the population to its best chromosome is below conv_diversity
+   MAXWTIME : the wall-clock time exceeds max_walltime seconds
+   MAXEVALS : the number of evaluations exceeds max_evaluations
+*/
+int check_convergence(GB_Global* GB, const chromosome* chrom, int gen, time_t start){
+	
+	int i,best=0;
+	double diversity=0.0;
+	double elapsed;
+	
+	for(i=1;i<GB->num_chrom;i++){
+		if(chrom[i].app_evalue < chrom[best].app_evalue) best = i;
+	}
+	
+	if(chrom[best].app_evalue < GB->conv_best - GB->conv_delta){
+		GB->conv_best = chrom[best].app_evalue;
+		GB->conv_stall = 0;
+	}else{
+		GB->conv_stall++;
+	}
+	
+	if(GB->conv_generations > 0 && GB->conv_stall >= GB->conv_generations){
+		printf("GA converged at generation %d: best apparent CF (%.3f) did not improve for %d generations\n",
+		       gen, GB->conv_best, GB->conv_stall);
+		return 1;
+	}
+	
+	if(GB->conv_diversity > 0.0){
+		for(i=0;i<GB->num_chrom;i++){
+			diversity += calc_rmsp(GB->num_genes,chrom[i].genes,chrom[best].genes,NULL,NULL);
+		}
+		diversity /= (double)GB->num_chrom;
+		
+		if(diversity < GB->conv_diversity){
+			printf("GA converged at generation %d: population diversity (RMSP=%.3f) is below %.3f\n",
+			       gen, diversity, GB->conv_diversity);
+			return 1;
+		}
+	}
+	
+	elapsed = difftime(time(NULL),start);
+	if(GB->max_walltime > 0.0 && elapsed >= GB->max_walltime){
+		printf("GA stopped at generation %d: wall-clock budget of %.0f s reached\n", gen, GB->max_walltime);
+		return 1;
+	}
+	
+	if(GB->max_evaluations > 0 && GB->num_evaluations - GB->conv_evaluations >= GB->max_evaluations){
+		printf("GA stopped at generation %d: budget of %ld evaluations reached\n", gen, GB->max_evaluations);
+		return 1;
+	}
+	
+	return 0;
+}
+
+/***********************************************************************/
+/*        1         2         3         4         5         6          */
+/*234567890123456789012345678901234567890123456789012345678901234567890*/
+/*        1         2         3         4         5         6         7*/
+/***********************************************************************/
+// selects two parents, then creates two decoded offspring by crossover and mutation
+void make_offspring(FA_Global* FA,GB_Global* GB,const chromosome* chrom,resid* residue,
+		    const selection* sel,int* npick,double* mutprob,double* crossprob,
+		    boost::variate_generator< RNGType, boost::uniform_int<> > & dice,
+		    gene* chrop1_gen,gene* chrop2_gen){
+	
+	int j,k,p1,p2;
+	int num_genes_wo_sc=0;
+	
+	/************************************/
+	/****** SELECTION OF PARENTS ********/
+	/************************************/
+	p1=select_parent(sel,chrom,(*npick)++,dice);
+	p2=select_parent(sel,chrom,(*npick)++,dice);
+	if (GB->adaptive_ga) adapt_prob(GB,chrom[p1].fitnes,chrom[p2].fitnes,mutprob,crossprob);
+		
+	/************************************/
+	/******  CROSSOVER OPERATOR  ********/
+	/************************************/
+	// create temporary genes
+	memcpy(chrop1_gen,chrom[p1].genes,GB->num_genes*sizeof(gene));
+	memcpy(chrop2_gen,chrom[p2].genes,GB->num_genes*sizeof(gene));
+		
+	if(RandomDouble() < (*crossprob)){
+		crossover(chrop1_gen,chrop2_gen,GB->num_genes,GB->intragenes);
+	}
+		
+	/************************************/
+	/******   MUTATION OPERATOR  ********/
+	/************************************/			
+	num_genes_wo_sc = GB->num_genes-FA->nflxsc_real;
+		
+	mutate(chrop1_gen,GB->num_genes-FA->nflxsc_real,(*mutprob),dice);
+	k=0;
+	for(j=0;j<FA->nflxsc;j++){
+		if(residue[FA->flex_res[j].inum].trot != 0){
+			if(RandomDouble() < FA->flex_res[j].prob){
+				mutate(&chrop1_gen[num_genes_wo_sc+k],1,(*mutprob),dice);
+			}
+			k++;
+		}
+	}
+	
+	mutate(chrop2_gen,GB->num_genes-FA->nflxsc_real,(*mutprob),dice);
+	k=0;
+	for(j=0;j<FA->nflxsc;j++){
+		if(residue[FA->flex_res[j].inum].trot != 0){
+			if(RandomDouble() < FA->flex_res[j].prob){
+				mutate(&chrop2_gen[num_genes_wo_sc+k],1,(*mutprob),dice);
+			}
+			k++;
+		}
+	}
+		
+	for(j=0; j<GB->num_genes; j++){
+		chrop1_gen[j].to_ic = decode_gene(&GB->gene_decoding[j],chrop1_gen[j].to_int32);
+		chrop2_gen[j].to_ic = decode_gene(&GB->gene_decoding[j],chrop2_gen[j].to_int32);
+	}
 }
+
 /***********************************************************************/
 /*        1         2         3         4         5         6          */
 /*234567890123456789012345678901234567890123456789012345678901234567890*/
@@ -525,14 +910,17 @@ int reproduce(FA_Global* FA,GB_Global* GB,VC_Global* VC, chromosome* chrom, cons
 	
 	static int nrejected = 0;
 	
-	int i,j,k;
-	int nnew,p1,p2;
+	int i,j;
+	int nnew;
+	int noffspring=0;
+	int npick=0;
+	bool unique;
+	double threshold=-DBL_MAX;
+	selection sel;
 	
 	gene chrop1_gen[MAX_NUM_GENES];
 	gene chrop2_gen[MAX_NUM_GENES];
 	
-	int num_genes_wo_sc=0;	
-	
 	/*
 	RNGType rng;
 	
@@ -549,58 +937,18 @@ int reproduce(FA_Global* FA,GB_Global* GB,VC_Global* VC, chromosome* chrom, cons
 		nnew = 0;
 	}
 	
+	// the selection table is built once per generation and only read afterwards
+	build_selection(GB,chrom,GB->num_chrom,2*nnew,dice,&sel);
+	
+	// replacement threshold of the surrogate
+	if(GB->surrogate != NULL){
+		for(j=0;j<GB->num_chrom;j++) if(chrom[j].evalue > threshold) threshold = chrom[j].evalue;
+	}
+	
 	i=0;
-	while(i<nnew){
+	while(noffspring<nnew){
 
-		/************************************/
-		/****** SELECTION OF PARENTS ********/
-		/************************************/
-		p1=roullete_wheel(chrom,GB->num_chrom);
-		p2=roullete_wheel(chrom,GB->num_chrom);
-		if (GB->adaptive_ga) adapt_prob(GB,chrom[p1].fitnes,chrom[p2].fitnes,&mutprob,&crossprob);
-			
-		/************************************/
-		/******  CROSSOVER OPERATOR  ********/
-		/************************************/
-		// create temporary genes
-		memcpy(chrop1_gen,chrom[p1].genes,GB->num_genes*sizeof(gene));
-		memcpy(chrop2_gen,chrom[p2].genes,GB->num_genes*sizeof(gene));
-			
-		if(RandomDouble() < crossprob){
-			crossover(chrop1_gen,chrop2_gen,GB->num_genes,GB->intragenes);
-		}
-			
-		/************************************/
-		/******   MUTATION OPERATOR  ********/
-		/************************************/			
-		num_genes_wo_sc = GB->num_genes-FA->nflxsc_real;
-			
-		mutate(chrop1_gen,GB->num_genes-FA->nflxsc_real,mutprob);
-		k=0;
-		for(j=0;j<FA->nflxsc;j++){
-			if(residue[FA->flex_res[j].inum].trot != 0){
-				if(RandomDouble() < FA->flex_res[j].prob){
-					mutate(&chrop1_gen[num_genes_wo_sc+k],1,mutprob);
-				}
-				k++;
-			}
-		}
-		
-		mutate(chrop2_gen,GB->num_genes-FA->nflxsc_real,mutprob);
-		k=0;
-		for(j=0;j<FA->nflxsc;j++){
-			if(residue[FA->flex_res[j].inum].trot != 0){
-				if(RandomDouble() < FA->flex_res[j].prob){
-					mutate(&chrop2_gen[num_genes_wo_sc+k],1,mutprob);
-				}
-				k++;
-			}
-		}
-			
-		for(j=0; j<GB->num_genes; j++){
-			chrop1_gen[j].to_ic = genetoic(&gene_lim[j],chrop1_gen[j].to_int32);
-			chrop2_gen[j].to_ic = genetoic(&gene_lim[j],chrop2_gen[j].to_int32);
-		}
+		make_offspring(FA,GB,chrom,residue,&sel,&npick,&mutprob,&crossprob,dice,chrop1_gen,chrop2_gen);
 		
 		string sig1 = generate_sig(chrop1_gen,GB->num_genes);
 		string sig2 = generate_sig(chrop2_gen,GB->num_genes);
@@ -608,7 +956,17 @@ int reproduce(FA_Global* FA,GB_Global* GB,VC_Global* VC, chromosome* chrom, cons
 		/************************************/
 		/******   CHECK DUPLICATION  ********/
 		/************************************/
-		if(GB->duplicates || duplicates.find(sig1) == duplicates.end()){
+		unique = GB->duplicates || duplicates.find(sig1) == duplicates.end();
+		if(unique) noffspring++;
+		
+		// not scored (nor tried again) when predicted clearly worse than the worst parent
+		if(unique && GB->surrogate != NULL &&
+		   surrogate_screen(FA,GB,gene_lim,cleftgrid,chrop1_gen,threshold,dice)){
+			duplicates[sig1] = 1;
+			unique = false;
+		}
+		
+		if(unique){
 			
 			/*
 			  if(!FA->useflexdee || 
@@ -624,14 +982,31 @@ int reproduce(FA_Global* FA,GB_Global* GB,VC_Global* VC, chromosome* chrom, cons
 			chrom[GB->num_chrom+i].evalue=get_cf_evalue(&chrom[GB->num_chrom+i].cf);
 			chrom[GB->num_chrom+i].app_evalue=get_apparent_cf_evalue(&chrom[GB->num_chrom+i].cf);
 			chrom[GB->num_chrom+i].status='n';
+			surrogate_observe(GB->surrogate,chrom[GB->num_chrom+i].evalue);
+			
+			// Lamarckian local search on a fraction of the offspring
+			if(GB->ls_fraction > 0.0 && RandomDouble(dice()) < GB->ls_fraction){
+				if(local_search(FA,GB,VC,gene_lim,atoms,residue,cleftgrid,&chrom[GB->num_chrom+i],dice,target))
+					duplicates[generate_sig(chrom[GB->num_chrom+i].genes,GB->num_genes)] = 1;
+			}
 			
 			duplicates[sig1] = 1;
 			i++;
 		}
 		
-		if(i==nnew) break;
+		if(noffspring==nnew) break;
+		
+		unique = GB->duplicates || duplicates.find(sig2) == duplicates.end();
+		if(unique) noffspring++;
+		
+		// not scored (nor tried again) when predicted clearly worse than the worst parent
+		if(unique && GB->surrogate != NULL &&
+		   surrogate_screen(FA,GB,gene_lim,cleftgrid,chrop2_gen,threshold,dice)){
+			duplicates[sig2] = 1;
+			unique = false;
+		}
 		
-		if(GB->duplicates || duplicates.find(sig2) == duplicates.end()){
+		if(unique){
 	  
 			/*
 			  if(!FA->useflexdee || 
@@ -646,16 +1021,27 @@ int reproduce(FA_Global* FA,GB_Global* GB,VC_Global* VC, chromosome* chrom, cons
 			chrom[GB->num_chrom+i].evalue=get_cf_evalue(&chrom[GB->num_chrom+i].cf);
 			chrom[GB->num_chrom+i].app_evalue=get_apparent_cf_evalue(&chrom[GB->num_chrom+i].cf);
 			chrom[GB->num_chrom+i].status='n';
+			surrogate_observe(GB->surrogate,chrom[GB->num_chrom+i].evalue);
+			
+			// Lamarckian local search on a fraction of the offspring
+			if(GB->ls_fraction > 0.0 && RandomDouble(dice()) < GB->ls_fraction){
+				if(local_search(FA,GB,VC,gene_lim,atoms,residue,cleftgrid,&chrom[GB->num_chrom+i],dice,target))
+					duplicates[generate_sig(chrom[GB->num_chrom+i].genes,GB->num_genes)] = 1;
+			}
 			
 			duplicates[sig2] = 1;
 			i++;
 		}
 	}
 	
+	// skipped offspring leave their parents in the population
+	nnew = i;
+	
 	if(strcmp(repmodel,"STEADY")==0){
 		// replace the n individuals from the old population with the new one (elitism)
-		QuickSort(chrom,0,GB->num_chrom-1,true);
-		for(i=0;i<nnew;i++) chrom[GB->num_chrom-1-i]=chrom[GB->num_chrom+i];
+		sort_population(chrom,GB->num_chrom);
+		// swap (not copy) so that each chromosome keeps its own genes in the arena
+		for(i=0;i<nnew;i++) swap_chrom(&chrom[GB->num_chrom-1-i],&chrom[GB->num_chrom+i]);
 		calculate_fitness(FA,GB,VC,chrom,gene_lim,atoms,residue,cleftgrid,
 				  GB->fitness_model,GB->num_chrom,print,target);
 	}else if(strcmp(repmodel,"BOOM")==0){
@@ -676,6 +1062,19 @@ string generate_sig(gene genes[], int num_genes){
 	return ss.str();
 }
 
+// 64-bit FNV-1a hash of the integer genes (identical chromosomes have identical hashes)
+unsigned long long hash_genes(const gene* genes, int num_genes){
+	unsigned long long hash = 14695981039346656037ULL;
+	for(int i=0;i<num_genes;i++){
+		boost::uint32_t value = (boost::uint32_t)genes[i].to_int32;
+		for(int k=0;k<4;k++){
+			hash ^= (unsigned long long)((value >> (8*k)) & 0xFF);
+			hash *= 1099511628211ULL;
+		}
+	}
+	return hash;
+}
+
 /***********************************************************************/
 /*        1         2         3         4         5         6          */
 /*234567890123456789012345678901234567890123456789012345678901234567890*/
@@ -787,30 +1186,80 @@ int deelig_search(struct deelig_node_struct* root_node, int* deelig_list, int fd
 /*234567890123456789012345678901234567890123456789012345678901234567890*/
 /*        1         2         3         4         5         6         7*/
 /***********************************************************************/
-int roullete_wheel(const chromosome* chrom,int n){
-	double r;
+/* builds the selection table of the generation for n chromosomes:
+   ROULETTE   : prefix sums of the fitness (binary search per pick)
+   SUS        : nparents picks by stochastic universal sampling (shuffled)
+   TOURNAMENT : nothing to build (GB->tournament_size random contestants per pick)
+*/
+void build_selection(const GB_Global* GB, const chromosome* chrom, int n, int nparents,
+		     boost::variate_generator< RNGType, boost::uniform_int<> > & dice, selection* sel){
+	
+	int i,k;
 	double tot=0.0;
-	int i;
-
-	for(i=0;i<n;i++){tot += chrom[i].fitnes;}
-	//printf("tot=%f\n",tot);
-	//PAUSE;
-
-	r=RandomDouble()*tot;
-  
-	i=0;
-	tot=0.0;
-	while(tot <= r){
+	double step,ptr;
+	
+	sel->n = n;
+	sel->toursize = GB->tournament_size;
+	if(sel->toursize < 1) sel->toursize = 1;
+	if(sel->toursize > n) sel->toursize = n;
+	
+	if(strcmp(GB->selection_model,"TOURNAMENT") == 0) sel->model = SELECT_TOURNAMENT;
+	else if(strcmp(GB->selection_model,"SUS") == 0) sel->model = SELECT_SUS;
+	else sel->model = SELECT_ROULETTE;
+	
+	sel->cumfit.resize(n);
+	for(i=0;i<n;i++){
 		tot += chrom[i].fitnes;
-		i++;
+		sel->cumfit[i] = tot;
+	}
+	
+	sel->sus.clear();
+	if(sel->model == SELECT_SUS && nparents > 0){
+		step = tot/(double)nparents;
+		ptr = RandomDouble(dice())*step;
+		i = 0;
+		for(k=0;k<nparents;k++,ptr+=step){
+			while(i < n-1 && sel->cumfit[i] <= ptr) i++;
+			sel->sus.push_back(i);
+		}
+		// the picks are in fitness order: shuffle them so that mates are not neighbours
+		for(k=nparents-1;k>0;k--){
+			i = (int)(RandomDouble(dice())*(double)(k+1));
+			std::swap(sel->sus[k],sel->sus[i]);
+		}
 	}
-	//printf("r=%f tot=%f i=%d\n",r,tot,i);
-	i--;
+}
 
-	//PAUSE;
-  
-	return i;
+/* returns the index of the k-th parent of the generation.
+   sel is not modified: concurrent calls are safe as long as each thread uses its own dice.
+*/
+int select_parent(const selection* sel, const chromosome* chrom,int k,
+		  boost::variate_generator< RNGType, boost::uniform_int<> > & dice){
+	
+	int i,c,best;
+	
+	switch(sel->model){
+	case SELECT_SUS:
+		if(!sel->sus.empty()) return sel->sus[k % sel->sus.size()];
+		break;
+	case SELECT_TOURNAMENT:
+		best = (int)(RandomDouble(dice())*(double)sel->n);
+		for(i=1;i<sel->toursize;i++){
+			c = (int)(RandomDouble(dice())*(double)sel->n);
+			if(chrom[c].fitnes > chrom[best].fitnes) best = c;
+		}
+		return best;
+	default:
+		break;
+	}
+	
+	// roulette wheel : first chromosome whose cumulative fitness exceeds r
+	i = (int)(std::upper_bound(sel->cumfit.begin(),sel->cumfit.end(),
+				   RandomDouble(dice())*sel->cumfit[sel->n-1]) - sel->cumfit.begin());
+	
+	return (i < sel->n) ? i : sel->n-1;
 }
+
 /***********************************************************************/
 /*        1         2         3         4         5         6          */
 /*234567890123456789012345678901234567890123456789012345678901234567890*/
@@ -821,9 +1270,8 @@ void calculate_fitness(FA_Global* FA,GB_Global* GB,VC_Global* VC,chromosome* chr
                        cfstr (*target)(FA_Global*,VC_Global*,atom*,resid*,gridpoint*,int,double*)){
 	
 	static int gen_id = 0;
-	int i,j;
+	int i;
 	//float tot=0.0;
-	double share,rmsp;
 
 	for(i=0;i<pop_size;i++){
 		if(chrom[i].status != 'n'){
@@ -834,7 +1282,8 @@ void calculate_fitness(FA_Global* FA,GB_Global* GB,VC_Global* VC,chromosome* chr
 		}
 	}
 	
-	QuickSort(chrom,0,pop_size-1,true);
+	// offspring are appended (BOOM) or replace the worst (STEADY) of a sorted population
+	sort_population(chrom,pop_size);
 	
 	//print_par(chrom,gene_lim,5,GB->num_genes);
 	//PAUSE;
@@ -857,24 +1306,14 @@ void calculate_fitness(FA_Global* FA,GB_Global* GB,VC_Global* VC,chromosome* chr
 		   each chromosome's fitness is lowered by sharing.
 		*/
 		
+		std::vector<double> share(GB->num_chrom);
+		
+		calc_share(GB,chrom,GB->num_chrom,&share[0]);
+		
 		for(i=0;i<GB->num_chrom;i++){
-			
-			share=0.0;
-			for(j=0;j<GB->num_chrom;j++){
-				
-				rmsp=calc_rmsp(GB->num_genes,chrom[i].genes,chrom[j].genes,
-					       FA->map_par,cleftgrid);
-				
-				//printf("i=%d j=%d rmsp=%f\n",i,j,rmsp);
-				if(rmsp <= GB->sig_share){
-					share += (1.0 - pow((rmsp/GB->sig_share),GB->alpha));
-				}
-				//share=1.0;
-				chrom[i].fitnes = (GB->num_chrom-i)/share;
-				//printf("i=%d lf=%d share=%f fit=%f\n",i,(GB->num_chrom-i),
-				//       share,chrom[i].fitnes);
-				//PAUSE;
-			}
+			chrom[i].fitnes = (GB->num_chrom-i)/share[i];
+			//printf("i=%d lf=%d share=%f fit=%f\n",i,(GB->num_chrom-i),
+			//       share[i],chrom[i].fitnes);
 		}
 	}
 
@@ -903,73 +1342,6 @@ void calculate_fitness(FA_Global* FA,GB_Global* GB,VC_Global* VC,chromosome* chr
 	return;
 }
 
-/***********************************************************************/
-/*        1         2         3         4         5         6          */
-/*234567890123456789012345678901234567890123456789012345678901234567890*/
-/*        1         2         3         4         5         6         7*/
-/***********************************************************************/
-void close_update_file_ptr(FA_Global* FA, FILE* outfile_ptr)
-{
-
-	if(FA->nrg_suite){
-		fclose(outfile_ptr);
-	}
-    
-}
-/***********************************************************************/
-/*        1         2         3         4         5         6          */
-/*234567890123456789012345678901234567890123456789012345678901234567890*/
-/*        1         2         3         4         5         6         7*/
-/***********************************************************************/
-FILE* get_update_file_ptr(FA_Global* FA)
-{
-    
-	if(!FA->nrg_suite){
-		return stdout;
-	}
-    
-	FILE* outfile_ptr = NULL;
-	char UPDATEFILE[MAX_PATH__];
-	long long timeout = 0;
-    
-	strcpy(UPDATEFILE,FA->state_path);
-#ifdef _WIN32
-	strcat(UPDATEFILE,"\\.update");
-#else
-	strcat(UPDATEFILE,"/.update");
-#endif
-    
-	outfile_ptr = fopen(UPDATEFILE,"r");
-	if(outfile_ptr != NULL) {
-		do {
-			fclose(outfile_ptr);
-            
-# ifdef _WIN32
-			Sleep(SLEEP);
-# else
-			usleep(SLEEP*1000);
-# endif
-            
-			timeout += SLEEP;
-			if(timeout >= FA->nrg_suite_timeout*1000){
-				return NULL;
-			}
-            
-			outfile_ptr = fopen(UPDATEFILE,"r");
-            
-		}while(outfile_ptr != NULL);
-	}
-    
-	outfile_ptr = fopen(UPDATEFILE,"w");
-	if(outfile_ptr == NULL){
-		fprintf(stderr,"ERROR: Cannot open update file '%s' for reading.\n", UPDATEFILE);
-		Terminate(10);
-	}
-    
-	return outfile_ptr;
-    
-}
-
 /***********************************************************************/
 /*        1         2         3         4         5         6          */
 /*234567890123456789012345678901234567890123456789012345678901234567890*/
@@ -981,6 +1353,8 @@ cfstr eval_chromosome(FA_Global* FA,GB_Global* GB,VC_Global* VC,const genlim* ge
 	
 	double icv[MAX_NUM_GENES] = {0};
 	
+	GB->num_evaluations++;
+	
 	for(int i=0;i<GB->num_genes;i++){
 		if(john[i].to_ic > gene_lim[i].max) {
 			fprintf(stderr, "Exceptional out of bounds error at: max: %.5lf when ic: %.5lf\n", gene_lim[i].max, john[i].to_ic);
@@ -1027,7 +1401,7 @@ void generate_random_individual(FA_Global* FA, GB_Global* GB, atom* atoms, gene*
 			genes[j].to_int32 = dice();
 		}
 		
-		genes[j].to_ic = genetoic(&gene_lim[j],genes[j].to_int32);
+		genes[j].to_ic = decode_gene(&GB->gene_decoding[j],genes[j].to_int32);
 	}
 	
 	return;
@@ -1109,7 +1483,7 @@ void populate_chromosomes(FA_Global* FA,GB_Global* GB,VC_Global* VC,chromosome*
 		j=0;
 		while(i<GB->num_chrom && fread(&chrom[i].genes[j].to_int32, 1, sizeof(boost::int32_t), infile_ptr))
 		{
-			chrom[i].genes[j].to_ic = genetoic(&gene_lim[j],chrom[i].genes[j].to_int32);
+			chrom[i].genes[j].to_ic = decode_gene(&GB->gene_decoding[j],chrom[i].genes[j].to_int32);
 			
 			j++;
 			if(j==GB->num_genes){
@@ -1360,6 +1734,70 @@ void read_gainputs(FA_Global* FA,GB_Global* GB,int* gen_int,int* sz_part,char fi
 			sscanf(buffer,"%s %d",field,&GB->print_int);
 		}else if(strncmp(buffer,"PRINTRRG",8) == 0){
 			sscanf(buffer,"%s %d",field,&GB->rrg_skip);
+		}else if(strncmp(buffer,"SNAPSIZE",8) == 0){
+			sscanf(buffer,"%s %d",field,&GB->snapshot_size);
+		}else if(strncmp(buffer,"SNAPSPIL",8) == 0){
+			GB->snapshot_spill = 1;
+		}else if(strncmp(buffer,"SELMODEL",8) == 0){
+			sscanf(buffer,"%s %11s",field,GB->selection_model);
+		}else if(strncmp(buffer,"TOURSIZE",8) == 0){
+			sscanf(buffer,"%s %d",field,&GB->tournament_size);
+		}else if(strncmp(buffer,"CONVGENS",8) == 0){
+			//CONVGENS <generations> [<minimal improvement of the best apparent CF>]
+			sscanf(buffer,"%s %d %lf",field,&GB->conv_generations,&GB->conv_delta);
+		}else if(strncmp(buffer,"CONVDIVR",8) == 0){
+			sscanf(buffer,"%s %lf",field,&GB->conv_diversity);
+		}else if(strncmp(buffer,"MAXWTIME",8) == 0){
+			sscanf(buffer,"%s %lf",field,&GB->max_walltime);
+		}else if(strncmp(buffer,"MAXEVALS",8) == 0){
+			sscanf(buffer,"%s %ld",field,&GB->max_evaluations);
+		}else if(strncmp(buffer,"LSFRACTN",8) == 0){
+			sscanf(buffer,"%s %lf",field,&GB->ls_fraction);
+		}else if(strncmp(buffer,"LSMAXEVL",8) == 0){
+			sscanf(buffer,"%s %d",field,&GB->ls_max_evals);
+		}else if(strncmp(buffer,"LSRHOINI",8) == 0){
+			sscanf(buffer,"%s %lf",field,&GB->ls_rho);
+		}else if(strncmp(buffer,"ASYNCWRK",8) == 0){
+			sscanf(buffer,"%s %d",field,&GB->async_workers);
+		}else if(strncmp(buffer,"NUMISLND",8) == 0){
+			sscanf(buffer,"%s %d",field,&GB->num_islands);
+		}else if(strncmp(buffer,"MIGRINTV",8) == 0){
+			sscanf(buffer,"%s %d",field,&GB->migration_interval);
+		}else if(strncmp(buffer,"MIGRSIZE",8) == 0){
+			sscanf(buffer,"%s %d",field,&GB->migration_size);
+		}else if(strncmp(buffer,"REPLICAS",8) == 0){
+			//REPLICAS <number of populations> [<processes>]
+			sscanf(buffer,"%s %d %d",field,&GB->num_replicas,&GB->replica_procs);
+		}else if(strncmp(buffer,"CHKPOINT",8) == 0){
+			sscanf(buffer,"%s %d",field,&GB->checkpoint_interval);
+		}else if(strncmp(buffer,"MCREPLIC",8) == 0){
+			sscanf(buffer,"%s %d",field,&GB->mc_replicas);
+		}else if(strncmp(buffer,"MCNSTEPS",8) == 0){
+			sscanf(buffer,"%s %d",field,&GB->mc_steps);
+		}else if(strncmp(buffer,"MCTEMPER",8) == 0){
+			//MCTEMPER <temperature of the coldest replica> <temperature of the hottest replica>
+			sscanf(buffer,"%s %lf %lf",field,&GB->mc_tmin,&GB->mc_tmax);
+		}else if(strncmp(buffer,"MCANNEAL",8) == 0){
+			sscanf(buffer,"%s %lf",field,&GB->mc_anneal);
+		}else if(strncmp(buffer,"MCSWAPIN",8) == 0){
+			sscanf(buffer,"%s %d",field,&GB->mc_swap_interval);
+		}else if(strncmp(buffer,"MCSTEPSZ",8) == 0){
+			sscanf(buffer,"%s %lf",field,&GB->mc_step_size);
+		}else if(strncmp(buffer,"DESTRATG",8) == 0){
+			sscanf(buffer,"%s %11s",field,GB->de_strategy);
+		}else if(strncmp(buffer,"DEWEIGHT",8) == 0){
+			sscanf(buffer,"%s %lf",field,&GB->de_weight);
+		}else if(strncmp(buffer,"DECROSSR",8) == 0){
+			sscanf(buffer,"%s %lf",field,&GB->de_crossover);
+		}else if(strncmp(buffer,"CMPOPSIZ",8) == 0){
+			sscanf(buffer,"%s %d",field,&GB->cma_popsize);
+		}else if(strncmp(buffer,"CMSIGMA0",8) == 0){
+			sscanf(buffer,"%s %lf",field,&GB->cma_sigma);
+		}else if(strncmp(buffer,"CMRESTRT",8) == 0){
+			sscanf(buffer,"%s %d",field,&GB->cma_restarts);
+		}else if(strncmp(buffer,"SURROGAT",8) == 0){
+			//SURROGAT <number of neighbours> [<CF margin above the worst parent>]
+			sscanf(buffer,"%s %d %lf",field,&GB->surrogate_k,&GB->surrogate_margin);
 		}else{
 			// ...
 		}
@@ -1540,28 +1978,125 @@ void crossover(gene *john,gene *mary,int num_genes, int intragenes){
 /*234567890123456789012345678901234567890123456789012345678901234567890*/
 /*        1         2         3         4         5         6         7*/
 /***********************************************************************/
-void mutate(gene *john,int num_genes,double mut_rate){
-	/* creates an operator with 1's with rate= mut_rate 
-	   uses it to mutate john.
+void mutate(gene *john,int num_genes,double mut_rate,
+	    boost::variate_generator< RNGType, boost::uniform_int<> > & dice){
+	/* flips each of the 32*num_genes bits of john with probability mut_rate.
+	   Instead of one draw per bit, the number of bits skipped before the next
+	   flip is drawn from the geometric distribution (one draw per flip).
 	*/
-	int i,j;
-	int optr;
-	int test;
+	double skip;
+	double log_keep;
+	long nbits = 32L*num_genes;
+	long bit;
 
-	for(j=0;j<num_genes;j++){
-		optr=0;
-		test=1;
-		for(i=0;i<32;i++){
-			if(RandomDouble() < mut_rate){
-				optr |= test;
-			}
-			test <<= 1;
-		}
-		john[j].to_int32 ^= optr;
+	if(mut_rate <= 0.0 || nbits <= 0) return;
+
+	if(mut_rate >= 1.0){
+		for(int j=0;j<num_genes;j++) john[j].to_int32 = ~john[j].to_int32;
+		return;
+	}
+
+	log_keep = log(1.0-mut_rate);
+
+	bit = -1;
+	while(1){
+		// RandomDouble(dice()) is in [0,1) (dice() may be 0) : 1-u is in (0,1] and the skip is finite
+		skip = floor(log(1.0-RandomDouble(dice()))/log_keep);
+		if(skip >= (double)(nbits-1-bit)) break;
+		
+		bit += (long)skip + 1;
+		john[bit/32].to_int32 ^= (boost::int32_t)(1u << (bit%32));
 	}
   
 	return;
 }
+/***********************************************************************/
+/*        1         2         3         4         5         6          */
+/*234567890123456789012345678901234567890123456789012345678901234567890*/
+/*        1         2         3         4         5         6         7*/
+/***********************************************************************/
+/* Solis-Wets local search on the internal coordinates of chrom.
+   Steps are drawn in units of bins (gene_lim.del) around a bias vector and
+   snapped on the bins, so that the genes can be encoded back (Lamarckian).
+   Genes that map into an array (grid points) are not moved.
+   Returns 1 when chrom was improved (genes, cf and evalues are updated).
+*/
+int local_search(FA_Global* FA,GB_Global* GB,VC_Global* VC,const genlim* gene_lim,
+		 atom* atoms,resid* residue,gridpoint* cleftgrid,chromosome* chrom,
+		 boost::variate_generator< RNGType, boost::uniform_int<> > & dice,
+		 cfstr (*target)(FA_Global*,VC_Global*,atom*,resid*,gridpoint*,int,double*)){
+	
+	int j,k,nevals=0;
+	int success=0,failure=0;
+	int improved=0;
+	bool accepted;
+	double rho=GB->ls_rho;
+	double evalue;
+	cfstr cf;
+	
+	gene trial[MAX_NUM_GENES];
+	double bias[MAX_NUM_GENES];
+	double dev[MAX_NUM_GENES];
+	bool movable[MAX_NUM_GENES];
+	int nmovable=0;
+	
+	for(j=0;j<GB->num_genes;j++){
+		movable[j] = !gene_lim[j].map && !GB->gene_decoding[j].fallback && GB->gene_decoding[j].last > 0;
+		if(movable[j]) nmovable++;
+		bias[j] = 0.0;
+	}
+	if(!nmovable) return 0;
+	
+	while(nevals < GB->ls_max_evals && rho >= 0.5){
+		
+		for(j=0;j<GB->num_genes;j++){
+			dev[j] = 0.0;
+			if(!movable[j]) continue;
+			dev[j] = bias[j] + rho*RandomNormal(dice);
+		}
+		
+		// try x+dev, then x-dev
+		accepted = false;
+		for(k=1;k>=-1 && nevals<GB->ls_max_evals;k-=2){
+			memcpy(trial,chrom->genes,GB->num_genes*sizeof(gene));
+			for(j=0;j<GB->num_genes;j++){
+				if(movable[j]) trial[j].to_ic = snap_gene(&GB->gene_decoding[j],trial[j].to_ic + k*dev[j]*gene_lim[j].del);
+			}
+			
+			cf = eval_chromosome(FA,GB,VC,gene_lim,atoms,residue,cleftgrid,trial,target);
+			evalue = get_cf_evalue(&cf);
+			nevals++;
+			
+			if(evalue < chrom->evalue){
+				for(j=0;j<GB->num_genes;j++){
+					if(movable[j]) trial[j].to_int32 = encode_gene(&GB->gene_decoding[j],trial[j].to_ic);
+				}
+				memcpy(chrom->genes,trial,GB->num_genes*sizeof(gene));
+				chrom->cf = cf;
+				chrom->evalue = evalue;
+				chrom->app_evalue = get_apparent_cf_evalue(&cf);
+				
+				for(j=0;j<GB->num_genes;j++) bias[j] = (k > 0) ? 0.2*bias[j]+0.4*dev[j] : bias[j]-0.4*dev[j];
+				improved = 1;
+				accepted = true;
+				break;
+			}
+		}
+		
+		if(accepted){
+			success++; failure=0;
+		}else{
+			for(j=0;j<GB->num_genes;j++) bias[j] *= 0.5;
+			failure++; success=0;
+		}
+		
+		if(success >= 4){ rho *= 2.0; success=0; }
+		else if(failure >= 4){ rho *= 0.5; failure=0; }
+	}
+	
+	return improved;
+}
+
 /***********************************************************************/
 /*        1         2         3         4         5         6          */
 /*234567890123456789012345678901234567890123456789012345678901234567890*/
@@ -1594,53 +2129,87 @@ void swap_chrom(chromosome *x, chromosome *y){
 	chromosome t=*x;*x=*y;*y=t;
 }
 
+// replaces the worst chromosome of the population sorted by CF, then moves it up
+// to keep the population sorted. Returns its position
+int insert_chrom(GB_Global* GB, chromosome* chrom, const gene* genes, const cfstr* cf, double evalue, double app_evalue){
+	int j,k;
+	int last = GB->num_chrom-1;
+
+	memcpy(chrom[last].genes,genes,GB->num_genes*sizeof(gene));
+	chrom[last].cf = *cf;
+	chrom[last].evalue = evalue;
+	chrom[last].app_evalue = app_evalue;
+	chrom[last].status = 'n';
+
+	for(j=last; j>0 && chrom[j-1].evalue > chrom[j].evalue; j--) swap_chrom(&chrom[j-1],&chrom[j]);
+
+	// the fitness stays positional until the next generation (LINEAR, unshared PSHARE)
+	if(strcmp(GB->fitness_model,"LINEAR")==0){
+		for(k=j;k<=last;k++) chrom[k].fitnes = (double)(GB->num_chrom-k);
+	}else{
+		chrom[j].fitnes = (double)(GB->num_chrom-j);
+	}
+
+	return j;
+}
+
+// sorts list[beg..end] by evalue (ascending) or by fitnes (descending)
+// the keys are sorted with their indexes, then the chromosomes are permuted in place
+// by following the cycles of the permutation (only the structs move, not the genes)
 void QuickSort(chromosome* list, int beg, int end, bool energy)
 {
-    QS_TYPE piv;
+	int i,j,k,n;
+	chromosome t;
 	
-    int  l,r,p;
- 
-    while (beg<end)    // This while loop will avoid the second recursive call
-    {
-        l = beg; p = beg + (end-beg)/2; r = end;
+	if(end <= beg) return;
+	
+	n = end-beg+1;
+	std::vector< std::pair<QS_TYPE,int> > key(n);
+	for(i=0;i<n;i++){
+		key[i].first = energy ? list[beg+i].evalue : -list[beg+i].fitnes;
+		key[i].second = i;
+	}
+	std::sort(key.begin(),key.end());
+	
+	// list[beg+i] receives list[beg+key[i].second]
+	for(i=0;i<n;i++){
+		if(key[i].second < 0 || key[i].second == i) continue;
 		
-		if(energy)
-			piv = list[p].evalue;
-		else
-			piv = list[p].fitnes;			
-
-        while (1)
-        {
-            while ( (l<=r) && ( ( energy && QS_ASC(list[l].evalue,piv) <= 0 ) ||
-								( !energy && QS_DSC(list[l].fitnes,piv) <= 0 ) ) ) l++;
-            while ( (l<=r) && ( ( energy && QS_ASC(list[r].evalue,piv) > 0 ) ||
-								( !energy && QS_DSC(list[r].fitnes,piv) ) ) ) r--;
-			
-            if (l>r) break;
-			
-			swap_chrom(&list[l],&list[r]);
- 
-            if (p==r) p=l;
- 
-            l++; r--;
-        }
- 
-		swap_chrom(&list[p],&list[r]);
-        //list[p]=list[r]; list[r].evalue=piv;
-        r--;
- 
-        // Recursion on the shorter side & loop (with new indexes) on the longer
-        if ((r-beg)<(end-l))
-        {
-            QuickSort(list, beg, r, energy);
-            beg=l;
-        }
-        else
-        {
-            QuickSort(list, l, end, energy);
-            end=r;
-        }
-    }   
+		t = list[beg+i];
+		j = i;
+		while(key[j].second != i){
+			k = key[j].second;
+			list[beg+j] = list[beg+k];
+			key[j].second = -1;
+			j = k;
+		}
+		list[beg+j] = t;
+		key[j].second = -1;
+	}
+}
+
+static bool evalue_less(const chromosome& a, const chromosome& b){ return a.evalue < b.evalue; }
+static bool fitnes_greater(const chromosome& a, const chromosome& b){ return a.fitnes > b.fitnes; }
+
+// sorts chrom[0..n-1] by evalue (ascending). Only the part following the already
+// sorted prefix is sorted, then both are merged in linear time.
+void sort_population(chromosome* chrom, int n)
+{
+	int m=1;
+	
+	while(m < n && chrom[m-1].evalue <= chrom[m].evalue) m++;
+	if(m >= n) return;
+	
+	QuickSort(chrom,m,n-1,true);
+	std::inplace_merge(chrom,chrom+m,chrom+n,evalue_less);
+}
+
+// moves the k chromosomes of highest fitness in front (in no particular order)
+void partition_fitness(chromosome* chrom, int n, int k)
+{
+	if(k <= 0 || k >= n) return;
+	
+	std::nth_element(chrom,chrom+k,chrom+n,fitnes_greater);
 }
 
 /***********************************************************************/
@@ -1830,6 +2399,117 @@ double genetoic(const genlim* gene_lim, boost::int32_t gene){
 	return(ic);
 }
 
+/* builds, for each gene, the bin thresholds that genetoic accumulates
+   (bin, 2*bin, ... summed the same way) until they reach 1.0.
+   Must be called again whenever gene_lim changes (set_bins, slice_grid).
+*/
+void build_gene_decoding(GB_Global* GB, const genlim* gene_lim){
+	
+	double tot;
+	
+	if(GB->gene_decoding == NULL) GB->gene_decoding = new genedecoding[GB->num_genes];
+	
+	for(int j=0;j<GB->num_genes;j++){
+		genedecoding* dec = &GB->gene_decoding[j];
+		
+		dec->min = gene_lim[j].min;
+		dec->del = gene_lim[j].del;
+		dec->tot.clear();
+		
+		// a degenerate bin width falls back on genetoic
+		dec->fallback = !(gene_lim[j].bin > 0.0) || gene_lim[j].nbin > (double)MAX_DECODING_BINS;
+		if(dec->fallback){
+			dec->gene_lim = gene_lim[j];
+			continue;
+		}
+		
+		tot = gene_lim[j].bin;
+		dec->tot.push_back(tot);
+		while(tot < 1.0){
+			tot += gene_lim[j].bin;
+			dec->tot.push_back(tot);
+		}
+		
+		// last bin reachable from a gene and within [min,max] (rounding may add a bin above max)
+		dec->last = (int)(std::lower_bound(dec->tot.begin(),dec->tot.end(),RandomDouble(MAX_RANDOM_VALUE)) - dec->tot.begin());
+		if(dec->last > (int)floor((gene_lim[j].max - gene_lim[j].min)/gene_lim[j].del + 1.0e-9))
+			dec->last = (int)floor((gene_lim[j].max - gene_lim[j].min)/gene_lim[j].del + 1.0e-9);
+		if(dec->last < 0) dec->last = 0;
+	}
+}
+
+void free_gene_decoding(GB_Global* GB){
+	
+	if(GB->gene_decoding != NULL) delete[] GB->gene_decoding;
+	GB->gene_decoding = NULL;
+}
+
+// returns the value of the bin nearest to ic
+double snap_gene(const genedecoding* dec, double ic){
+	
+	double k = floor((ic - dec->min)/dec->del + 0.5);
+	
+	if(k < 0.0) k = 0.0;
+	if(k > (double)dec->last) k = (double)dec->last;
+	
+	return dec->min + dec->del * k;
+}
+
+// returns a gene that decodes into the bin of ic (the inverse of decode_gene)
+boost::int32_t encode_gene(const genedecoding* dec, double ic){
+	
+	int k = (int)floor((ic - dec->min)/dec->del + 0.5);
+	double g;
+	
+	if(k < 0) k = 0;
+	if(k > dec->last) k = dec->last;
+	
+	// upper end of the bin (the thresholds are inclusive), moved inside when needed
+	g = floor(dec->tot[k]*((double)MAX_RANDOM_VALUE+1.0));
+	if(g > (double)MAX_RANDOM_VALUE) g = (double)MAX_RANDOM_VALUE;
+	if(g < 1.0) g = 1.0;
+	
+	while(g > 1.0 && RandomDouble((boost::int32_t)g) > dec->tot[k]) g -= 1.0;
+	while(g < (double)MAX_RANDOM_VALUE && k > 0 && RandomDouble((boost::int32_t)g) <= dec->tot[k-1]) g += 1.0;
+	
+	return (boost::int32_t)g;
+}
+
+// a gene that decodes into the bin of ic, at a position within the bin that follows ic
+// (continuous values of DE and CMA-ES : close values get distinct signatures)
+boost::int32_t encode_continuous_gene(const genedecoding* dec, double ic){
+	
+	int k = (int)floor((ic - dec->min)/dec->del + 0.5);
+	double frac;
+	boost::int32_t lo,hi;
+	
+	if(dec->fallback) return ictogene(&dec->gene_lim,ic);
+	
+	if(k < 0) k = 0;
+	if(k > dec->last) k = dec->last;
+	
+	hi = encode_gene(dec,ic);
+	lo = (k > 0) ? encode_gene(dec,dec->min + (k-1)*dec->del) + 1 : 0;
+	if(lo > hi) return hi;
+	
+	frac = (ic - dec->min)/dec->del - k + 0.5;
+	if(frac < 0.0) frac = 0.0;
+	if(frac > 1.0) frac = 1.0;
+	
+	return lo + (boost::int32_t)(frac*(double)(hi - lo));
+}
+
+// same value as genetoic, the linear scan over the bins is replaced by a binary search
+double decode_gene(const genedecoding* dec, boost::int32_t gene){
+	
+	if(dec->fallback) return genetoic(&dec->gene_lim,gene);
+	
+	// first threshold that is not lower than the random double of the gene
+	int i = (int)(std::lower_bound(dec->tot.begin(),dec->tot.end(),RandomDouble(gene)) - dec->tot.begin());
+	
+	return dec->min + dec->del * (double)i;
+}
+
 int ictogene(const genlim* gene_lim, double ic){
 
 	int i = (int)((ic - gene_lim->min) / gene_lim->del);
@@ -1864,3 +2544,94 @@ double RandomDouble(boost::int32_t gene){
 double RandomDouble(){
 	return rand()/((double)RAND_MAX+1.0);
 }
+
+// standard normal deviate (Box-Muller)
+double RandomNormal(boost::variate_generator< RNGType, boost::uniform_int<> > & dice){
+	double u1 = RandomDouble(dice());
+	double u2 = RandomDouble(dice());
+
+	// RandomDouble(dice()) may be 0
+	if(u1 <= 0.0) u1 = 1.0/((double)MAX_RANDOM_VALUE+1.0);
+
+	return sqrt(-2.0*log(u1))*cos(2.0*PI*u2);
+}
+
+/***********************************************************************/
+/*        1         2         3         4         5         6          */
+/*234567890123456789012345678901234567890123456789012345678901234567890*/
+/*        1         2         3         4         5         6         7*/
+/***********************************************************************/
+/* niche counts of PSHARE : share[i] = sum over j of 1-(rmsp(i,j)/sig_share)^alpha
+   for all pairs with rmsp <= sig_share (including i itself).
+   Chromosomes are sorted by their distance to a first pivot and only those whose
+   distance differs by less than the sharing radius are compared (triangle
+   inequality), after the same test with SHARE_PIVOTS-1 other pivots. The counts
+   are the same as with the all-pairs calc_rmsp loop.
+*/
+void calc_share(const GB_Global* GB, const chromosome* chrom, int num_chrom, double* share){
+	
+	int i,j,k,l,a,b,p;
+	int npiv = (num_chrom < SHARE_PIVOTS) ? num_chrom : SHARE_PIVOTS;
+	int ngenes = GB->num_genes;
+	double d,dist2,maxd;
+	
+	// sharing radius in gene space (rmsp <= sig_share <=> dist <= radius)
+	double radius = sqrt((double)ngenes)*GB->sig_share;
+	double radius2 = radius*radius;
+	double slack = radius*(1.0+1.0e-9);
+	
+	if(num_chrom <= 0) return;
+	
+	std::vector<double> pivdist((size_t)npiv*num_chrom);
+	std::vector<double> mindist(num_chrom,DBL_MAX);
+	std::vector< std::pair<double,int> > order(num_chrom);
+	
+	// pivots : the first chromosome, then the one farthest from the pivots already chosen
+	p = 0;
+	for(k=0;k<npiv;k++){
+		maxd = -1.0;
+		for(i=0;i<num_chrom;i++){
+			dist2 = 0.0;
+			for(l=0;l<ngenes;l++){
+				d = chrom[i].genes[l].to_ic - chrom[p].genes[l].to_ic;
+				dist2 += d*d;
+			}
+			pivdist[(size_t)k*num_chrom+i] = sqrt(dist2);
+			if(pivdist[(size_t)k*num_chrom+i] < mindist[i]) mindist[i] = pivdist[(size_t)k*num_chrom+i];
+		}
+		for(i=0;i<num_chrom;i++){
+			if(mindist[i] > maxd){ maxd = mindist[i]; p = i; }
+		}
+	}
+	
+	for(i=0;i<num_chrom;i++){
+		order[i].first = pivdist[i];
+		order[i].second = i;
+		share[i] = 1.0;
+	}
+	std::sort(order.begin(),order.end());
+	
+	for(a=0;a<num_chrom;a++){
+		i = order[a].second;
+		for(b=a+1;b<num_chrom && order[b].first-order[a].first <= slack;b++){
+			j = order[b].second;
+			
+			for(k=1;k<npiv;k++){
+				if(fabs(pivdist[(size_t)k*num_chrom+i]-pivdist[(size_t)k*num_chrom+j]) > slack) break;
+			}
+			if(k < npiv) continue;
+			
+			dist2 = 0.0;
+			for(l=0;l<ngenes && dist2 <= radius2;l++){
+				d = chrom[i].genes[l].to_ic - chrom[j].genes[l].to_ic;
+				dist2 += d*d;
+			}
+			if(dist2 > radius2) continue;
+			
+			d = (radius2 > 0.0) ? 1.0 - pow(sqrt(dist2/radius2),GB->alpha) : 1.0;
+			share[i] += d;
+			share[j] += d;
+		}
+	}
+}
+
@@ -11,6 +11,7 @@
 #include "boost/generator_iterator.hpp"
 #include "boost/cstdint.hpp"
 #include "boost/math/special_functions/fpclassify.hpp"
+#include "boost/unordered_set.hpp"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -21,6 +22,7 @@
 #include <float.h>
 #include <time.h>
 #include <limits.h>
+#include <set>
 
 #include "flexaid.h"
 #include "Vcontacts.h"
@@ -31,6 +33,10 @@
 #define MAX_RANDOM_VALUE 2147483647              // upper bound of 32-bit integer
 #define SAVE_CHROM_FRACTION 1.0
 
+#define MAX_DECODING_BINS 10000000                // larger genes are decoded with genetoic
+#define SHARE_PIVOTS 4                           // pivots used to prune the PSHARE pairs
+#define GENE_ARENA_ALIGN 64                      // alignment (in bytes) of the chromosome genes
+#define STATE_INTERVAL 1                         // sleep interval (in seconds) between checking file state
 #define QS_TYPE double
 #define QS_ASC(a,b) ((a)-(b))
 #define QS_DSC(a,b) ((b)-(a))
@@ -51,6 +57,17 @@ struct genelimits_struct{
 };
 typedef struct genelimits_struct genlim;
 
+// per-gene decoding table of genetoic (see build_gene_decoding)
+struct genedecoding_struct{
+	double min;
+	double del;
+	std::vector<double> tot;	// cumulated bin thresholds
+	int    last;			// last bin within [min,max]
+	bool   fallback;		// decode with genetoic (degenerate bins)
+	genlim gene_lim;		// copy used by the fallback
+};
+typedef struct genedecoding_struct genedecoding;
+
 struct gene_struct{
 	boost::int32_t  to_int32;
 	double          to_ic;
@@ -69,6 +86,18 @@ struct chromosome_struct{
 };
 typedef struct chromosome_struct chromosome;
 
+// Parents selection (built once per generation, read-only afterwards)
+enum selection_model_enum { SELECT_ROULETTE, SELECT_SUS, SELECT_TOURNAMENT };
+
+struct selection_struct{
+	int    model;			// selection_model_enum
+	int    n;			// number of chromosomes that can be selected
+	int    toursize;		// contestants per tournament
+	std::vector<double> cumfit;	// prefix sums of the fitness
+	std::vector<int> sus;		// parents drawn by stochastic universal sampling
+};
+typedef struct selection_struct selection;
+
 struct GB_Global_struct{
 	//long long    seed;
 
@@ -108,7 +137,73 @@ struct GB_Global_struct{
 	char         pop_init_file[MAX_PATH__];
 	char         fitness_model[9];
 	char         rep_model[9];
+	char         selection_model[12];	// ROULETTE, TOURNAMENT or SUS (SELMODEL)
+	int          tournament_size;		// contestants per tournament (TOURSIZE)
+	
+	// convergence criteria (0 : disabled)
+	int          conv_generations;		// generations without improvement of the best apparent CF (CONVGENS)
+	double       conv_delta;		// minimal improvement of the best apparent CF (CONVGENS)
+	double       conv_diversity;		// minimal mean RMSP to the best chromosome (CONVDIVR)
+	double       max_walltime;		// wall-clock budget in seconds (MAXWTIME)
+	long         max_evaluations;		// evaluations budget (MAXEVALS)
+	long         num_evaluations;		// evaluations done so far
+	long         conv_evaluations;		// evaluations done before the current run (MAXEVALS is per replica)
+	double       conv_best;			// best apparent CF so far
+	int          conv_stall;		// generations since the last improvement
+	
+	// Lamarckian local search (Solis-Wets)
+	double       ls_fraction;		// fraction of the offspring optimized locally (LSFRACTN)
+	int          ls_max_evals;		// evaluations per local search (LSMAXEVL)
+	double       ls_rho;			// initial step size in bins (LSRHOINI)
+	
+	int          async_workers;		// worker processes of the asynchronous steady-state GA (ASYNCWRK)
+	
+	// island model (the master process evolves island 0)
+	int          num_islands;		// populations evolved by forked processes (NUMISLND)
+	int          migration_interval;	// generations between migrations (MIGRINTV)
+	int          migration_size;		// best chromosomes sent to the next island (MIGRSIZE)
+	int          island;			// island evolved by this process
+	struct islandring_struct* island_ring;	// migrants shared between the islands (NULL without islands)
+	
+	// independent populations after a single setup, merged in chrom_snapshot
+	int          num_replicas;		// populations evolved one after the other (REPLICAS)
+	int          replica_procs;		// processes running the replicas, forked like the islands (REPLICAS)
+	
+	int          checkpoint_interval;	// generations between checkpoints of the GA, 0 : none (CHKPOINT)
+	
+	// Monte Carlo / parallel tempering (METOPT MC)
+	int          mc_replicas;		// replicas on the temperature ladder (MCREPLIC)
+	int          mc_steps;			// steps of each replica (MCNSTEPS)
+	double       mc_tmin;			// temperatures of the coldest and hottest replicas (MCTEMPER)
+	double       mc_tmax;
+	double       mc_anneal;			// factor of the ladder at the last step, 1 : no annealing (MCANNEAL)
+	int          mc_swap_interval;		// steps between replica exchanges, 0 : none (MCSWAPIN)
+	double       mc_step_size;		// initial step size in bins (MCSTEPSZ)
+	
+	// differential evolution (METOPT DE)
+	char         de_strategy[12];		// RAND1BIN, BEST1BIN, RAND2BIN or CURTOBEST (DESTRATG)
+	double       de_weight;			// differential weight F (DEWEIGHT)
+	double       de_crossover;		// crossover probability CR (DECROSSR)
+	
+	// sep-CMA-ES with IPOP restarts (METOPT CM)
+	int          cma_popsize;		// initial population, 0 : 4+3ln(n) (CMPOPSIZ)
+	double       cma_sigma;			// initial step size on genes normalized to [0,1] (CMSIGMA0)
+	int          cma_restarts;		// restarts with a doubled population (CMRESTRT)
+	
 	int          duplicates;
+	
+	genedecoding* gene_decoding;		// decoding tables of the genes (NULL until built)
+	gene*        gene_arena;		// contiguous genes of the population (chrom[i].genes points in it)
+	
+	struct OnlineClustering_struct* online_cluster;	// poses clustered during the GA (CLUSTA OL), NULL otherwise
+	
+	int          snapshot_size;		// maximum number of chromosomes kept in chrom_snapshot (0 : num_chrom*max_generations)
+	int          snapshot_spill;	// spill chrom_snapshot to disk instead of discarding the worst poses when full
+	struct snapshot_struct* snapshot;	// poses saved during the GA (NULL with CLUSTA OL)
+	
+	int          surrogate_k;		// neighbours of the surrogate screening the offspring, 0 : none (SURROGAT)
+	double       surrogate_margin;		// CF margin above the worst parent before an offspring is skipped (SURROGAT)
+	struct surrogate_struct* surrogate;	// nearest-neighbour surrogate of the CF (NULL without SURROGAT)
     
 };
 typedef struct GB_Global_struct GB_Global;
@@ -143,18 +238,161 @@ struct Cluster_struct
        ClusterChrom* Center;		 // Queue of ClusterChrom (first element is the cluster center)
 };
 typedef struct Cluster_struct DPcluster;
+
+// Vantage-point tree indexing ClusterChrom coordinates (RMSD metric)
+struct DPvpnode_struct
+{
+	int vantage;					// position in ClusterChrom array of the vantage point
+	int size;						// number of ClusterChrom in subtree (vantage point included)
+	int maxDensity;					// highest Density in subtree (vantage point included)
+	int inner;						// subtree of points closer than mu to the vantage point (-1 if empty)
+	int outer;						// subtree of points farther than mu from the vantage point (-1 if empty)
+	float mu;						// median distance to the vantage point
+	float radius;					// largest distance between the vantage point and its subtree
+};
+typedef struct DPvpnode_struct DPvpnode;
+
+struct DPvptree_struct
+{
+	ClusterChrom* Chrom;			// indexed ClusterChrom array (must not be sorted while the tree is in use)
+	DPvpnode* nodes;				// one node per ClusterChrom
+	int nNodes;
+	int root;
+	int nAtoms;						// number of ligand atoms in ClusterChrom::Coord
+};
+typedef struct DPvptree_struct DPvptree;
+
+// Bounded chromosome snapshot (unique poses saved during the GA)
+struct snapshot_struct
+{
+	chromosome* chrom;				// saved chromosomes (genes point in arena)
+	gene* arena;					// contiguous genes (num_genes per chromosome)
+	int num_genes;
+	int capacity;					// maximum number of chromosomes in memory
+	int allocated;					// number of chromosomes allocated (grows up to capacity)
+	int n;							// number of chromosomes in memory
+	long nSaved;					// unique chromosomes saved
+	long nDuplicates;				// chromosomes skipped as exact duplicates
+	long nDiscarded;				// chromosomes discarded when the snapshot was full
+	bool spill;						// spill sorted runs to spillfile when full
+	FILE* spill_ptr;
+	char spillfile[MAX_PATH__];
+	vector< pair<long,long> > runs;	// offset and number of chromosomes of each sorted run in spillfile
+	boost::unordered_set<unsigned long long> signatures;	// hashes of the chromosomes recently saved (at most 2*capacity)
+};
+typedef struct snapshot_struct snapshot;
+
+// Shared-memory ring of migrants between the islands (NUMISLND)
+struct islandring_struct
+{
+	int num_islands;
+	int num_genes;
+	int num_migrants;				// chromosomes published by each island
+	size_t slot_size;				// bytes of the slot of each island
+	size_t map_size;
+	char* slots;					// shared mapping (one slot per island)
+	vector<long> last_seq;			// version of the last migrants received from each island
+	vector<int> pids;				// island processes (master only)
+};
+typedef struct islandring_struct islandring;
+
+// Nearest-neighbour surrogate of the CF (SURROGAT)
+struct surrogate_struct
+{
+	int k;							// number of neighbours
+	double margin;					// CF margin above the replacement threshold
+	double pred;					// prediction of the last offspring screened
+	double threshold;				// replacement threshold of the last offspring screened
+	int pending;					// 1 : the last prediction awaits its CF, 2 : same for an audited skip
+	long npredicted;				// predictions made
+	long nskipped;					// offspring not scored
+	long naudited;					// skips scored anyway
+	long nfalse;					// audited skips better than the replacement threshold
+	long nscored;					// predictions compared to the CF
+	double sum_err;					// sums of the errors (prediction - CF)
+	double sum_abs_err;
+	double sum_sq_err;
+};
+typedef struct surrogate_struct surrogate;
+
+// Online (leader) clustering data structure definitions
+struct OnlineCluster_struct
+{
+	int Frequency;					// number of unique poses folded in cluster
+	double weightSum;				// sum of Boltzmann weights
+	double enthalpySum;				// sum of Boltzmann weight x CF
+	double entropySum;				// sum of Boltzmann weight x log(Boltzmann weight)
+	double totCF;					// sum of CF
+	double lowestCF;				// CF of the Representative
+	double lowestEvalue;			// CF (not apparent) of the Representative
+	double energy;					// ordering key computed before output (free energy or lowestCF)
+	int index;						// position of the cluster in the Center/Representative arenas
+};
+typedef struct OnlineCluster_struct OLcluster;
+
+struct OnlineClustering_struct
+{
+	int nClusters;
+	int maxClusters;				// allocated capacity of the arrays below
+	int nAtoms;						// number of ligand atoms in each Center
+	int num_genes;
+	long nPoses;					// unique poses folded
+	long nDuplicates;				// poses skipped as exact duplicates
+	double PartitionFunction;		// sum of all Boltzmann weights
+	OLcluster* Clust;
+	float* Center;					// leader coordinates (3*nAtoms per cluster), fixed once the cluster is created
+	gene* Representative;			// genes of the lowest CF pose (num_genes per cluster)
+	float* Coord;					// scratch coordinates of the pose being folded
+	int maxSignatures;				// hashes kept before only those of the Representatives are
+	boost::unordered_set<unsigned long long> signatures;	// hashes of the poses recently folded (at most maxSignatures+nClusters)
+};
+typedef struct OnlineClustering_struct OLclustering;
 /***********************************************************************/
 /*        1         2         3         4         5         6          */
 /*234567890123456789012345678901234567890123456789012345678901234567890*/
 /*        1         2         3         4         5         6         7*/
 /***********************************************************************/
 int   GA(FA_Global* FA,GB_Global* GB,VC_Global* VC,chromosome** chrom,chromosome** chrom_snapshot,genlim** gene_lim,atom* atoms,resid* residue,gridpoint** cleftgrid,char gainpfile[], int* memchrom, cfstr (*target)(FA_Global*,VC_Global*,atom*,resid*,gridpoint*,int, double*));
+int   DE(FA_Global* FA,GB_Global* GB,VC_Global* VC,chromosome** chrom,chromosome** chrom_snapshot,genlim** gene_lim,atom* atoms,resid* residue,gridpoint** cleftgrid,char gainpfile[], int* memchrom, cfstr (*target)(FA_Global*,VC_Global*,atom*,resid*,gridpoint*,int, double*));
+int   CMAES(FA_Global* FA,GB_Global* GB,VC_Global* VC,chromosome** chrom,chromosome** chrom_snapshot,genlim** gene_lim,atom* atoms,resid* residue,gridpoint** cleftgrid,char gainpfile[], int* memchrom, cfstr (*target)(FA_Global*,VC_Global*,atom*,resid*,gridpoint*,int, double*));
+int   MC(FA_Global* FA,GB_Global* GB,VC_Global* VC,chromosome** chrom,chromosome** chrom_snapshot,genlim** gene_lim,atom* atoms,resid* residue,gridpoint** cleftgrid,char gainpfile[], int* memchrom, cfstr (*target)(FA_Global*,VC_Global*,atom*,resid*,gridpoint*,int, double*));
+void  set_ga_defaults(GB_Global* GB);
+void  set_state_files(FA_Global* FA, char* pausefile, char* abortfile, char* stopfile);
+unsigned int init_optimizer(FA_Global* FA, GB_Global* GB, const char* name, char gainpfile[], char* pausefile, char* abortfile, char* stopfile, int* geninterval, int* popszpartition, boost::variate_generator< RNGType, boost::uniform_int<> > & dice);
+long int init_gene_lim(FA_Global* FA, GB_Global* GB, genlim** gene_lim);
+void  alloc_chromosomes(GB_Global* GB, chromosome** chrom, int memchrom);
+void  init_snapshot(FA_Global* FA, GB_Global* GB, atom* atoms, resid* residue);
+int   save_poses(FA_Global* FA, GB_Global* GB, const chromosome* chrom, const genlim* gene_lim, atom* atoms, resid* residue, gridpoint* cleftgrid, int num_chrom);
+int   close_optimizer(FA_Global* FA, GB_Global* GB, const chromosome* chrom, const genlim* gene_lim, int gen, int num_chrom, int n_chrom_snapshot, chromosome** chrom_snapshot);
+void  init_control(FA_Global* FA);
 int   check_state(char* pausefile, char* abortfile, char* stopfile, int interval);
+int   check_convergence(GB_Global* GB, const chromosome* chrom, int gen, time_t start);
+int   GA_generation(FA_Global* FA,GB_Global* GB,VC_Global* VC,chromosome** chrom,genlim** gene_lim,atom* atoms,resid* residue,gridpoint** cleftgrid,int gen,int replica,time_t ga_start,long int at,int geninterval,int popszpartition,int save_num_chrom,int* print,int* nrejected,int* n_chrom_snapshot, boost::variate_generator< RNGType, boost::uniform_int<> > & dice, map<string, int> & duplicates, cfstr (*target)(FA_Global*,VC_Global*,atom*,resid*,gridpoint*,int,double*));
 void  QuickSort(chromosome*, int, int, bool);
+void  sort_population(chromosome* chrom, int n);
+void  partition_fitness(chromosome* chrom, int n, int k);
 void  QuickSort_Clusters(int*, int*, double*, double*, int*, int, int);
 void  swap_clusters(int*, int*, double*, double*, int*, int*, int*, double*, double*, int*);
 void  crossover(gene *john,gene *mary,int num_genes, int intragenes);
-void  mutate(gene *john,int num_genes,double mut_rate);
+void  make_offspring(FA_Global* FA,GB_Global* GB,const chromosome* chrom,resid* residue,const selection* sel,int* npick,double* mutprob,double* crossprob, boost::variate_generator< RNGType, boost::uniform_int<> > & dice,gene* chrop1_gen,gene* chrop2_gen);
+int   async_GA(FA_Global* FA,GB_Global* GB,VC_Global* VC,chromosome* chrom,const genlim* gene_lim,atom* atoms,resid* residue,gridpoint* cleftgrid, boost::variate_generator< RNGType, boost::uniform_int<> > & dice, map<string, int> & duplicates,char* pausefile,char* abortfile,char* stopfile,int interval,time_t start,int* n_chrom_snapshot, cfstr (*target)(FA_Global*,VC_Global*,atom*,resid*,gridpoint*,int,double*));
+int   build_islands(FA_Global* FA, GB_Global* GB);
+int   migrate_islands(GB_Global* GB, chromosome* chrom, int gen, map<string, int> & duplicates);
+int   join_islands(FA_Global* FA, GB_Global* GB);
+void  abort_islands(GB_Global* GB);
+void  install_checkpoint_signals(bool install);
+int   checkpoint_requested(void);
+void  terminate_after_checkpoint(void);
+void  write_checkpoint(FA_Global* FA, GB_Global* GB, const chromosome* chrom, int replica, int gen, time_t start, unsigned int seed, boost::variate_generator< RNGType, boost::uniform_int<> > & dice, const map<string, int> & duplicates);
+int   read_checkpoint(FA_Global* FA, GB_Global* GB, chromosome* chrom, int* replica, int* gen, double* elapsed, boost::variate_generator< RNGType, boost::uniform_int<> > & dice, map<string, int> & duplicates);
+void  remove_checkpoint(FA_Global* FA);
+surrogate* build_surrogate(GB_Global* GB);
+int   surrogate_screen(FA_Global* FA, GB_Global* GB, const genlim* gene_lim, const gridpoint* cleftgrid, const gene* genes, double threshold, boost::variate_generator< RNGType, boost::uniform_int<> > & dice);
+void  surrogate_observe(surrogate* sur, double evalue);
+void  print_surrogate(const surrogate* sur, long num_evaluations);
+void  free_surrogate(surrogate* sur);
+int   local_search(FA_Global* FA,GB_Global* GB,VC_Global* VC,const genlim* gene_lim,atom* atoms,resid* residue,gridpoint* cleftgrid,chromosome* chrom, boost::variate_generator< RNGType, boost::uniform_int<> > & dice, cfstr (*target)(FA_Global*,VC_Global*,atom*,resid*,gridpoint*,int,double*));
+void  mutate(gene *john,int num_genes,double mut_rate, boost::variate_generator< RNGType, boost::uniform_int<> > & dice);
 void  bin_print(int dec,int len);
 void  read_gainputs(FA_Global* FA,GB_Global* GB,int*,int*,char file[]);
 int   deelig_search(struct deelig_node_struct* root_node, int* deelig_list, int fdih);
@@ -169,18 +407,30 @@ double calc_poss(genlim* gene_lim, int num_genes);
 void validate_dups(GB_Global* GB, genlim* gene_lim, int num_genes);
 double genetoic(const genlim* gene_lim, boost::int32_t gene);
 int ictogene(const genlim* gene_lim, double ic);
+void build_gene_decoding(GB_Global* GB, const genlim* gene_lim);
+void free_gene_decoding(GB_Global* GB);
+double decode_gene(const genedecoding* dec, boost::int32_t gene);
+double snap_gene(const genedecoding* dec, double ic);
+boost::int32_t encode_gene(const genedecoding* dec, double ic);
+boost::int32_t encode_continuous_gene(const genedecoding* dec, double ic);
 
 int 	RandomInt(double frac);
 double 	RandomDouble();
 double 	RandomDouble(boost::int32_t dice);
+double 	RandomNormal(boost::variate_generator< RNGType, boost::uniform_int<> > & dice);
 
 void  	swap_chrom(chromosome * x, chromosome * y);
+int   	insert_chrom(GB_Global* GB, chromosome* chrom, const gene* genes, const cfstr* cf, double evalue, double app_evalue);
 void  	copy_chrom(chromosome* dest, const chromosome* src, int num_genes);
+gene* 	alloc_gene_arena(int num_chrom, int num_genes);
+void  	free_gene_arena(gene* arena);
 int   	remove_dups(chromosome* list, int num_chrom, int num_genes);
 
 FILE* 	get_update_file_ptr(FA_Global* FA);
 void 	close_update_file_ptr(FA_Global* FA, FILE* outfile_ptr);
+void 	flush_update_file(FA_Global* FA);
 string 	generate_sig(gene genes[], int num_genes);
+unsigned long long hash_genes(const gene* genes, int num_genes);
 
 void  	generate_random_individual(FA_Global* FA, GB_Global* GB, atom* atoms, gene* genes, const genlim* gene_lim,
 				 boost::variate_generator< RNGType, boost::uniform_int<> > &, int from_gene, int to_gene);
@@ -192,16 +442,18 @@ void  	print_pop(const chromosome* chrom,const genlim* gene_lim,int numc, int nu
 void  	print_chrom(const chromosome* chrom, int num_genes, int real_flag);
 void  	print_chrom(const gene* genes, int num_genes, int real_flag);
 void  	print_par(const chromosome* chrom,const genlim* gene_lim,int num_chrom,int num_genes, FILE* outfile_ptr);
-int   	roullete_wheel(const chromosome* chrom,int n);
+void  	build_selection(const GB_Global* GB, const chromosome* chrom, int n, int nparents, boost::variate_generator< RNGType, boost::uniform_int<> > & dice, selection* sel);
+int   	select_parent(const selection* sel, const chromosome* chrom, int k, boost::variate_generator< RNGType, boost::uniform_int<> > & dice);
 int   	cmp_chrom2pop(chromosome* chrom,chromosome* c, int num_genes,int start, int last);
 int   	cmp_chrom2pop_int(const chromosome* chrom,const gene* genes, int num_genes,int start, int last);
 int   	cmp_chrom2rotlist(psFlexDEE_Node psFlexDEE_INI_Node, const chromosome* chrom, const genlim* gene_lim,int gene_offset, int num_genes, int tot, int num_nodes);
 int   	cmp_chrom2pop(const chromosome* chrom,const gene* genes, int num_genes,int start, int last);
-void  	save_snapshot(chromosome* chrom_snapshot, const chromosome* chrom, int num_chrom, int num_genes);
 void  	cluster(FA_Global* FA, GB_Global* GB, VC_Global* VC,chromosome* chrom, genlim* gene_lim, atom* atoms, resid* residue,gridpoint* cleftgrid, int memchrom, char* end_strfile, char* tmp_end_strfile, char* dockinp, char* gainp);
 void  	DensityPeak_cluster(FA_Global* FA, GB_Global* GB, VC_Global* VC, chromosome* chrom, genlim* gen_lim, atom* atoms, resid* residue, gridpoint* cleftgrid, int memchrom, char* end_strfile, char* tmp_end_strfile, char* dockinp, char* gainp);
 void 	FastOPTICS_cluster(FA_Global* FA, GB_Global* GB, VC_Global* VC, chromosome* chrom, genlim* gene_lim, atom* atoms, resid* residue, gridpoint* cleftgrid, int nChrom, char* end_strfile, char* tmp_end_strfile, char* dockinp, char* gainp);
+void 	Online_cluster(FA_Global* FA, GB_Global* GB, VC_Global* VC, OLclustering* OL, genlim* gene_lim, atom* atoms, resid* residue, gridpoint* cleftgrid, char* end_strfile, char* tmp_end_strfile, char* dockinp, char* gainp);
 //long long time_seed();
+void  	calc_share(const GB_Global* GB, const chromosome* chrom, int num_chrom, double* share);
 double 	calc_rmsp(int npar, const gene* g1, const gene* g2, const optmap* map_par, gridpoint* cleftgrid);
 void 	write_par(const chromosome* chrom,const genlim* gene_lim,int ger, char* outfile,int num_chrom,int num_genes);
 void 	adapt_prob(GB_Global* GB,double fitnes1,double fitnes2, double* mut_prob, double* cross_prob);
@@ -209,20 +461,51 @@ void 	fitness_stats(GB_Global* GB, const chromosome* chrom,int nchrom);
 float  	calc_rmsd_chrom(FA_Global* FA,GB_Global* GB, const chromosome* chrom, const genlim* gene_lim,atom* atoms,resid* residue,gridpoint* cleftgrid,int npar, int chrom_a, int chrom_b, float*, float*, bool calc_rmsd); // calculates RMSD between chromossomes
 int    	write_rrg(FA_Global* FA,GB_Global* GB, const chromosome* chrom, const genlim* gene_lim,atom* atoms,resid* residue, gridpoint* cleftgrid, char* outfile);        // writes GA output during simulation
 int    	write_rrd(FA_Global* FA,GB_Global* GB, const chromosome* chrom, const genlim* gene_lim,atom* atoms,resid* residue,gridpoint* cleftgrid,int* Clus_GAPOP,float* Clus_RMSDT,char outfile[]);   
-int 	write_DensityPeak_rrd(FA_Global* FA, GB_Global* GB, const chromosome* chrom, const genlim* gene_lim, atom* atoms, resid* residue, gridpoint* cleftgrid, ClusterChrom* Chrom, DPcluster* Clust, float* RMSD, char outfile[]);
+int 	write_DensityPeak_rrd(FA_Global* FA, GB_Global* GB, const chromosome* chrom, const genlim* gene_lim, atom* atoms, resid* residue, gridpoint* cleftgrid, ClusterChrom* Chrom, DPcluster* Clust, int num_chrom, int nAtoms, char outfile[]);
 void   	partition_grid(FA_Global* FA,chromosome* chrom,genlim* gene_lim,atom* atoms,resid* residue,gridpoint** cleftgrid,int pop_size, int expansion);        // partition grid size where favorable conformations are found
 void   	slice_grid(FA_Global* FA,genlim* gene_lim,atom* atoms,resid* residue,gridpoint** cleftgrid);                      // slice grid symmetrically in half
 
 // Density Peaks Clustering algorithm function declarations
 void 	QuickSort_Cluster_by_CF(DPcluster* Clust, bool Entropic, int beg, int end);
 void 	swap_clusters(DPcluster* xClust, DPcluster* yClust);
-float 	getDistanceCutoff(float* RMSD, int num_chrom);
+float 	getDistanceCutoff(DPvptree* Tree, long sizeChrom);
 void 	QuickSort_ChromCluster_by_CF(ClusterChrom* Chrom, int num_chrom, int beg, int end);
 void 	QuickSort_ChromCluster_by_higher_Density(ClusterChrom* Chrom, int num_chrom, int beg, int end);
 void 	QuickSort_ChromCluster_by_lower_Density(ClusterChrom* Chrom, int num_chrom, int beg, int end);
-void 	swap_elements(ClusterChrom* Chrom, ClusterChrom* ChromX, ClusterChrom* ChromY, int num_chrom);
+void 	swap_elements(ClusterChrom* ChromX, ClusterChrom* ChromY);
+void 	unlink_DensityPeaks(ClusterChrom* Chrom, int num_chrom, int* DPindex);
+void 	relink_DensityPeaks(ClusterChrom* Chrom, int num_chrom, const int* DPindex, int* slot);
 float 	calculate_stddev(ClusterChrom* Chrom, int num_chrom);
 float 	calculate_mean(ClusterChrom* Chrom, int num_chrom);
 int 	DistanceComparator(const void*, const void*);
+float 	DensityPeak_rmsd(const ClusterChrom* ChromX, const ClusterChrom* ChromY, int nAtoms);
+void 	build_DensityPeak_vptree(DPvptree* Tree, ClusterChrom* Chrom, int num_chrom, int nAtoms);
+void 	free_DensityPeak_vptree(DPvptree* Tree);
+int 	vptree_build_node(DPvptree* Tree, int* idx, pair<float,int>* work, int beg, int end);
+int 	vptree_update_density(DPvptree* Tree, int node);
+int 	vptree_range_count(const DPvptree* Tree, int node, const ClusterChrom* Query, float radius);
+void 	vptree_nearest_higher_density(const DPvptree* Tree, int node, const ClusterChrom* Query, float* minDist, int* nearest);
+long 	vptree_pair_count(const DPvptree* Tree, float radius);
+float 	vptree_pair_quantile(const DPvptree* Tree, long n);
+
+// Bounded chromosome snapshot function declarations
+snapshot* build_snapshot(FA_Global* FA, GB_Global* GB);
+void 	grow_snapshot(snapshot* snap, int size);
+int 	save_snapshot(snapshot* snap, const chromosome* chrom, int num_chrom);
+void 	compact_snapshot(snapshot* snap);
+void 	spill_snapshot(snapshot* snap);
+void 	trim_signatures(snapshot* snap);
+void 	write_snapshot_record(snapshot* snap, const chromosome* chrom);
+void 	read_snapshot_record(snapshot* snap, FILE* infile_ptr, chromosome* chrom);
+int 	close_snapshot(snapshot* snap);
+void 	free_snapshot(snapshot* snap);
+
+// Online (leader) clustering function declarations
+OLclustering* build_Online_clustering(FA_Global* FA, GB_Global* GB, atom* atoms, resid* residue);
+int 	Online_cluster_add(FA_Global* FA, GB_Global* GB, OLclustering* OL, const chromosome* chrom, const genlim* gene_lim, atom* atoms, resid* residue, gridpoint* cleftgrid, int num_chrom);
+void 	free_Online_clustering(OLclustering* OL);
+void 	trim_Online_signatures(OLclustering* OL);
+int 	Online_cluster_grow(OLclustering* OL);
+int 	OnlineClusterComparator(const void*, const void*);
 
 #endif // include guard
@@ -104,7 +104,7 @@ cfstr ic2cf(FA_Global* FA,VC_Global* VC,atom* atoms,resid* residue,
   
 	// do not alter default (ini) protein conf.
 	if(normalmode > -1){
-		alter_mode(atoms,residue,FA->normal_grid[normalmode],FA->res_cnt,FA->normal_modes);
+		alter_mode(FA,atoms,normalmode,0);
 	}
 	
 	/* rebuild cartesian coordinates of optimized residues*/
@@ -0,0 +1,322 @@
+#include "gaboom.h"
+#include "boinc.h"
+
+#ifndef _WIN32
+# include <unistd.h>
+# include <signal.h>
+# include <sys/mman.h>
+# include <sys/wait.h>
+#endif
+
+/*****************************************************************************
+ * Island model (NUMISLND) : one launch forks NUMISLND-1 processes once the
+ * receptor, grid and rotamers are read, so that the islands share them (copy
+ * on write). Each island evolves its own population from its own seed. Every
+ * MIGRINTV generations, an island publishes its MIGRSIZE best chromosomes in
+ * its slot of a shared-memory ring and receives the last migrants published
+ * by the previous island (no barrier : slots are versioned like a seqlock).
+ * At the end, the islands write their chrom_snapshot to the temporary
+ * directory and the master (island 0) merges them into its own before
+ * clustering. Parallel REPLICAS are islands without migration, each process
+ * running its share of the replicas one after the other.
+ *****************************************************************************/
+
+#ifndef _WIN32
+
+struct island_slot{
+	volatile long seq;		// odd while the island writes its migrants
+	int    generation;		// generation of the migrants
+	int    n;			// number of migrants
+};
+
+struct island_migrant{
+	cfstr  cf;
+	double evalue;
+	double app_evalue;
+	// followed by num_genes genes
+};
+
+struct island_result{
+	int    island;
+	long   num_evaluations;
+	long   n;			// chromosomes that follow
+};
+
+static size_t migrant_size(const islandring* ring)
+{
+	return sizeof(island_migrant) + ring->num_genes*sizeof(gene);
+}
+
+static island_slot* get_island_slot(const islandring* ring, int island)
+{
+	return (island_slot*)(ring->slots + (size_t)island*ring->slot_size);
+}
+
+static island_migrant* get_island_migrant(const islandring* ring, char* slot, int j)
+{
+	return (island_migrant*)(slot + sizeof(island_slot) + (size_t)j*migrant_size(ring));
+}
+
+static void get_island_file(FA_Global* FA, int island, char* file)
+{
+	strcpy(file,FA->temp_path);
+	sprintf(&file[strlen(file)],"/island.%d.snap",island);
+}
+
+static void free_island_ring(islandring* ring)
+{
+	munmap(ring->slots,ring->map_size);
+	delete ring;
+}
+
+#endif
+
+/* forks the islands. returns the index of the island run by the calling process
+   (0 for the master, which is also the only process when islands are disabled) */
+int build_islands(FA_Global* FA, GB_Global* GB)
+{
+	GB->island = 0;
+	GB->island_ring = NULL;
+	if(GB->num_islands < 2) return 0;
+
+#ifdef _WIN32
+	fprintf(stderr,"WARNING: NUMISLND and parallel REPLICAS are not available on Windows, using a single process.\n");
+	GB->num_islands = 1;
+	return 0;
+#else
+	int k;
+	islandring* ring = new islandring;
+
+	ring->num_islands = GB->num_islands;
+	ring->num_genes = GB->num_genes;
+	ring->num_migrants = GB->migration_size;
+	ring->slot_size = sizeof(island_slot) + (size_t)ring->num_migrants*migrant_size(ring);
+	ring->slot_size = (ring->slot_size + 63) & ~(size_t)63;
+	ring->last_seq.assign(ring->num_islands,0);
+	ring->map_size = (size_t)ring->num_islands*ring->slot_size;
+
+	ring->slots = (char*)mmap(NULL,ring->map_size,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_ANONYMOUS,-1,0);
+	if(ring->slots == MAP_FAILED){
+		fprintf(stderr,"WARNING: could not map the island migration ring, using a single population.\n");
+		delete ring;
+		GB->num_islands = 1;
+		return 0;
+	}
+	memset(ring->slots,0,ring->map_size);
+
+	// islands inherit the current state of the process
+	fflush(stdout);
+	fflush(stderr);
+	for(k=1;k<ring->num_islands;k++){
+		pid_t pid = fork();
+		if(pid < 0){
+			fprintf(stderr,"WARNING: could only start %d islands.\n", k);
+			ring->num_islands = k;
+			break;
+		}
+		if(pid == 0){
+			ring->pids.clear();
+			GB->island = k;
+			GB->island_ring = ring;
+
+			// the master reports for all islands
+			freopen("/dev/null","w",stdout);
+			GB->print_int = INT_MAX;
+
+			// each island spills its own chrom_snapshot
+			if(GB->snapshot != NULL) sprintf(&GB->snapshot->spillfile[strlen(GB->snapshot->spillfile)],".%d",k);
+			return k;
+		}
+		ring->pids.push_back(pid);
+	}
+
+	// islands that could not be started do not publish migrants
+	GB->num_islands = ring->num_islands;
+	GB->island_ring = ring;
+
+	if(GB->num_replicas > 1){
+		printf("%d replicas run by %d processes\n", GB->num_replicas, GB->num_islands);
+	}else{
+		printf("island model with %d islands (%d migrants every %d generations)\n",
+		       GB->num_islands, GB->migration_size, GB->migration_interval);
+	}
+
+	return 0;
+#endif
+}
+
+
+/* publishes the best chromosomes of the island, then replaces the worst ones by the
+   migrants of the previous island in the ring when they are better and unique.
+   the population must be sorted by CF. returns the number of migrants accepted */
+int migrate_islands(GB_Global* GB, chromosome* chrom, int gen, map<string, int> & duplicates)
+{
+#ifdef _WIN32
+	return 0;
+#else
+	int j,k;
+	int n,accepted=0;
+	int last = GB->num_chrom-1;
+	long seq;
+	islandring* ring = GB->island_ring;
+	island_slot* slot;
+	island_migrant* migrant;
+
+	if(ring == NULL) return 0;
+
+	// publish
+	n = (ring->num_migrants < GB->num_chrom) ? ring->num_migrants : GB->num_chrom;
+	slot = get_island_slot(ring,GB->island);
+	slot->seq++;
+	__sync_synchronize();
+	for(j=0;j<n;j++){
+		migrant = get_island_migrant(ring,(char*)slot,j);
+		migrant->cf = chrom[j].cf;
+		migrant->evalue = chrom[j].evalue;
+		migrant->app_evalue = chrom[j].app_evalue;
+		memcpy((char*)migrant + sizeof(island_migrant),chrom[j].genes,GB->num_genes*sizeof(gene));
+	}
+	slot->generation = gen;
+	slot->n = n;
+	__sync_synchronize();
+	slot->seq++;
+
+	// receive (a copy, valid only if the slot was not written meanwhile)
+	k = (GB->island + ring->num_islands - 1) % ring->num_islands;
+	slot = get_island_slot(ring,k);
+	seq = slot->seq;
+	if(seq == 0 || (seq & 1) || seq == ring->last_seq[k]) return 0;
+
+	std::vector<char> copy(ring->slot_size);
+	__sync_synchronize();
+	memcpy(&copy[0],(const char*)slot,ring->slot_size);
+	__sync_synchronize();
+	if(slot->seq != seq) return 0;
+	ring->last_seq[k] = seq;
+
+	n = ((island_slot*)&copy[0])->n;
+	for(j=0;j<n;j++){
+		migrant = get_island_migrant(ring,&copy[0],j);
+		gene* genes = (gene*)((char*)migrant + sizeof(island_migrant));
+
+		if(migrant->evalue >= chrom[last].evalue) continue;
+
+		string sig = generate_sig(genes,GB->num_genes);
+		if(!GB->duplicates && duplicates.find(sig) != duplicates.end()) continue;
+		duplicates[sig] = 1;
+
+		// replaces the worst chromosome, then moves up to keep the population sorted
+		insert_chrom(GB,chrom,genes,&migrant->cf,migrant->evalue,migrant->app_evalue);
+		accepted++;
+	}
+
+	return accepted;
+#endif
+}
+
+
+/* islands : write their chrom_snapshot and exit.
+   master  : waits for the islands and merges their chrom_snapshot into its own.
+   returns the number of chromosomes merged */
+int join_islands(FA_Global* FA, GB_Global* GB)
+{
+#ifdef _WIN32
+	return 0;
+#else
+	int k,status;
+	int nmerged=0;
+	long i;
+	char file[MAX_PATH__];
+	FILE* outfile_ptr;
+	FILE* infile_ptr;
+	island_result result;
+	chromosome chrom;
+	gene genes[MAX_NUM_GENES];
+	islandring* ring = GB->island_ring;
+	snapshot* snap = GB->snapshot;
+
+	if(ring == NULL) return 0;
+
+	if(GB->island > 0){
+		get_island_file(FA,GB->island,file);
+		outfile_ptr = NULL;
+		if(!OpenFile_B(file,"wb",&outfile_ptr)){
+			fprintf(stderr,"ERROR: Cannot open island file '%s'.\n", file);
+			_exit(6);
+		}
+
+		result.island = GB->island;
+		result.num_evaluations = GB->num_evaluations;
+		result.n = (long)close_snapshot(snap);
+		fwrite(&result,sizeof(result),1,outfile_ptr);
+
+		// records in the spill file format
+		snap->spill_ptr = outfile_ptr;
+		strcpy(snap->spillfile,file);
+		for(i=0;i<result.n;i++) write_snapshot_record(snap,&snap->chrom[i]);
+		CloseFile_B(&snap->spill_ptr,"wb");
+
+		fflush(NULL);
+		_exit(0);
+	}
+
+	chrom.genes = genes;
+	for(k=0;k<(int)ring->pids.size();k++){
+		if(waitpid(ring->pids[k],&status,0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0){
+			fprintf(stderr,"WARNING: island %d terminated unexpectedly, its poses are lost.\n", k+1);
+			continue;
+		}
+
+		get_island_file(FA,k+1,file);
+		infile_ptr = NULL;
+		if(!OpenFile_B(file,"rb",&infile_ptr)){
+			fprintf(stderr,"WARNING: Cannot open island file '%s', its poses are lost.\n", file);
+			continue;
+		}
+
+		if(fread(&result,sizeof(result),1,infile_ptr) != 1){
+			fprintf(stderr,"ERROR: Cannot read island file '%s'.\n", file);
+			Terminate(6);
+		}
+		GB->num_evaluations += result.num_evaluations;
+
+		int nsaved = 0;
+		for(i=0;i<result.n;i++){
+			read_snapshot_record(snap,infile_ptr,&chrom);
+			nsaved += save_snapshot(snap,&chrom,1);
+		}
+		printf("island %d: %ld evaluations, %d unique poses merged\n", result.island, result.num_evaluations, nsaved);
+		nmerged += nsaved;
+
+		CloseFile_B(&infile_ptr,"rb");
+		remove(file);
+	}
+
+	free_island_ring(ring);
+	GB->island_ring = NULL;
+
+	return nmerged;
+#endif
+}
+
+
+/* .abort : the islands exit without writing their poses, the master stops them */
+void abort_islands(GB_Global* GB)
+{
+#ifndef _WIN32
+	int k;
+	islandring* ring = GB->island_ring;
+
+	if(ring == NULL) return;
+
+	if(GB->island > 0) _exit(0);
+
+	for(k=0;k<(int)ring->pids.size();k++){
+		kill(ring->pids[k],SIGTERM);
+		waitpid(ring->pids[k],NULL,0);
+	}
+
+	free_island_ring(ring);
+	GB->island_ring = NULL;
+#endif
+}
@@ -0,0 +1,211 @@
+#include "gaboom.h"
+#include "boinc.h"
+
+// probability of redrawing the moved gene instead of displacing it
+# define MC_RESET_PROB 0.1
+// steps between two adaptations of the step size of a replica
+# define MC_ADAPT_STEPS 100
+
+/*****************************************************************************
+ * Monte Carlo search (METOPT MC) : MCREPLIC Metropolis walkers on a geometric
+ * temperature ladder between the two MCTEMPER temperatures (kept in order :
+ * chrom[0] is the coldest replica). Each step moves one gene of every replica,
+ * either displaced by a normal number of bins (step size adapted towards 20 to
+ * 50 % acceptance) or redrawn at random, and scores it with the same target as
+ * the GA. The ladder is cooled geometrically down to MCANNEAL times its initial
+ * temperatures (simulated annealing) and neighbour replicas are exchanged every
+ * MCSWAPIN steps (parallel tempering). The states of the colder half of the
+ * ladder are saved in chrom_snapshot (or clustered online) at every step, so
+ * that the clustering and writers are the same as with the GA.
+ *****************************************************************************/
+
+// moves one gene of chrom into trial
+static void mc_move(FA_Global* FA, GB_Global* GB, atom* atoms, const genlim* gene_lim, const chromosome* chrom,
+		    chromosome* trial, double rho, boost::variate_generator< RNGType, boost::uniform_int<> > & dice)
+{
+	int j;
+	double d;
+	const genedecoding* dec;
+
+	memcpy(trial->genes,chrom->genes,GB->num_genes*sizeof(gene));
+
+	j = (int)(RandomDouble(dice())*GB->num_genes);
+	dec = &GB->gene_decoding[j];
+
+	// genes mapping into an array (grid points, rotamers) have no neighbouring bins
+	if(gene_lim[j].map || dec->fallback || dec->last == 0 || RandomDouble(dice()) < MC_RESET_PROB){
+		generate_random_individual(FA,GB,atoms,trial->genes,gene_lim,dice,j,j+1);
+		return;
+	}
+
+	// normal number of bins, at least one
+	d = rho*RandomNormal(dice);
+	if(fabs(d) < 1.0) d = (d < 0.0) ? -1.0 : 1.0;
+
+	trial->genes[j].to_ic = snap_gene(dec,trial->genes[j].to_ic + d*gene_lim[j].del);
+	trial->genes[j].to_int32 = encode_gene(dec,trial->genes[j].to_ic);
+}
+
+/***********************************************************************/
+/*        1         2         3         4         5         6          */
+/*234567890123456789012345678901234567890123456789012345678901234567890*/
+/*        1         2         3         4         5         6         7*/
+/***********************************************************************/
+int MC(FA_Global* FA, GB_Global* GB,VC_Global* VC,chromosome** chrom,chromosome** chrom_snapshot,
+       genlim** gene_lim,atom* atoms,resid* residue,gridpoint** cleftgrid,char gainpfile[],
+       int* memchrom, cfstr (*target)(FA_Global*,VC_Global*,atom*,resid*,gridpoint*,int,double*)){
+
+	int r,s;
+	int print=0;
+	int nreplicas,save_num_chrom;
+	int nexchanges=0;
+	int n_chrom_snapshot=0;
+
+	int  state=0;
+	char PAUSEFILE[MAX_PATH__];
+	char ABORTFILE[MAX_PATH__];
+	char STOPFILE[MAX_PATH__];
+
+	double scale,beta,delta;
+	chromosome* trial;
+
+	boost::variate_generator< RNGType, boost::uniform_int<> >
+		dice(RNGType(), boost::uniform_int<>(0, MAX_RANDOM_VALUE));
+
+	*memchrom=0;
+
+	init_optimizer(FA,GB,"MC",gainpfile,PAUSEFILE,ABORTFILE,STOPFILE,NULL,NULL,dice);
+
+	if(GB->mc_replicas < 1 || GB->mc_replicas > MAX_NUM_CHROM || GB->mc_steps < 1 ||
+	   GB->mc_tmin <= 0.0 || GB->mc_tmax < GB->mc_tmin || GB->mc_anneal <= 0.0 || GB->mc_step_size <= 0.0){
+		fprintf(stderr,"ERROR: invalid Monte Carlo parameters (MCREPLIC, MCNSTEPS, MCTEMPER, MCANNEAL or MCSTEPSZ).\n");
+		Terminate(10);
+	}
+	if(FA->opt_grid){
+		fprintf(stderr,"WARNING: OPTIGRID is ignored by the Monte Carlo search.\n");
+		FA->opt_grid = 0;
+	}
+
+	// the replicas take the place of the population (snapshot size, convergence criteria)
+	nreplicas = GB->mc_replicas;
+	GB->num_chrom = nreplicas;
+	GB->max_generations = GB->mc_steps;
+	strcpy(GB->fitness_model,"LINEAR");
+	if(GB->num_print > GB->num_chrom){ GB->num_print = GB->num_chrom; }
+	save_num_chrom = (nreplicas+1)/2;
+
+	long int at = init_gene_lim(FA,GB,gene_lim);
+
+	validate_dups(GB, (*gene_lim), GB->num_genes);
+	build_gene_decoding(GB, (*gene_lim));
+
+	// replicas and the trial state
+	(*memchrom) = nreplicas+1;
+	alloc_chromosomes(GB,chrom,(*memchrom));
+	trial = &(*chrom)[nreplicas];
+
+	// *** chrom_snapshot
+	init_snapshot(FA,GB,atoms,residue);
+
+	std::vector<double> temperature(nreplicas);
+	std::vector<double> rho(nreplicas,GB->mc_step_size);
+	std::vector<long> naccepted(nreplicas,0);
+	std::vector<long> nwindow(nreplicas,0);
+	std::vector<long> nswaps(nreplicas,0);
+	std::vector<long> nswaptries(nreplicas,0);
+
+	for(r=0;r<nreplicas;r++){
+		temperature[r] = (nreplicas > 1) ? GB->mc_tmin*pow(GB->mc_tmax/GB->mc_tmin,(double)r/(double)(nreplicas-1)) : GB->mc_tmin;
+	}
+
+	printf("Monte Carlo search with %d replicas from T=%.3f to T=%.3f, %d steps", nreplicas, GB->mc_tmin, GB->mc_tmax, GB->mc_steps);
+	if(GB->mc_anneal != 1.0) printf(", annealed to %.3f of the ladder", GB->mc_anneal);
+	if(GB->mc_swap_interval > 0 && nreplicas > 1) printf(", exchanges every %d steps", GB->mc_swap_interval);
+	printf("\n");
+	fflush(stdout);
+
+	map<string, int> duplicates;
+
+	time_t mc_start = time(NULL);
+	GB->conv_best = DBL_MAX;
+	GB->conv_stall = 0;
+
+	// the starting states are sorted by CF : the best one is the coldest
+	populate_chromosomes(FA,GB,VC,(*chrom),(*gene_lim),atoms,residue,(*cleftgrid),
+			     GB->pop_init_method,target,GB->pop_init_file,at,0,print,dice,duplicates);
+
+	////////////////////////////////
+	//////    Monte Carlo    ///////
+	////////////////////////////////
+	for(s=0;s<GB->mc_steps;s++)
+	{
+		state=check_state(PAUSEFILE,ABORTFILE,STOPFILE,STATE_INTERVAL);
+
+		if(state == -1){
+			return(state);
+		}else if(state == 1){
+			break;
+		}
+
+#ifdef ENABLE_BOINC
+		boinc_fraction_done((double)(s+1)/(double)GB->mc_steps);
+#endif
+
+		// annealing of the whole ladder
+		scale = (GB->mc_steps > 1) ? pow(GB->mc_anneal,(double)s/(double)(GB->mc_steps-1)) : 1.0;
+
+		for(r=0;r<nreplicas;r++){
+			beta = 1.0/(temperature[r]*scale);
+
+			mc_move(FA,GB,atoms,(*gene_lim),&(*chrom)[r],trial,rho[r],dice);
+
+			trial->cf = eval_chromosome(FA,GB,VC,(*gene_lim),atoms,residue,(*cleftgrid),trial->genes,target);
+			trial->evalue = get_cf_evalue(&trial->cf);
+			trial->app_evalue = get_apparent_cf_evalue(&trial->cf);
+			trial->status = 'n';
+
+			// Metropolis criterion
+			delta = trial->evalue - (*chrom)[r].evalue;
+			if(delta <= 0.0 || RandomDouble(dice()) < exp(-delta*beta)){
+				swap_chrom(&(*chrom)[r],trial);
+				naccepted[r]++;
+				nwindow[r]++;
+			}
+
+			if((s+1) % MC_ADAPT_STEPS == 0){
+				if(nwindow[r] > MC_ADAPT_STEPS/2) rho[r] *= 1.5;
+				else if(nwindow[r] < MC_ADAPT_STEPS/5 && rho[r] > 1.0) rho[r] /= 1.5;
+				nwindow[r] = 0;
+			}
+		}
+
+		// replica exchange between neighbours (alternately from the first and second replica)
+		if(GB->mc_swap_interval > 0 && nreplicas > 1 && (s+1) % GB->mc_swap_interval == 0){
+			for(r=nexchanges%2;r<nreplicas-1;r+=2){
+				delta = (1.0/temperature[r] - 1.0/temperature[r+1])/scale * ((*chrom)[r].evalue - (*chrom)[r+1].evalue);
+				nswaptries[r]++;
+				if(delta >= 0.0 || RandomDouble(dice()) < exp(delta)){
+					swap_chrom(&(*chrom)[r],&(*chrom)[r+1]);
+					nswaps[r]++;
+				}
+			}
+			nexchanges++;
+		}
+
+		n_chrom_snapshot += save_poses(FA,GB,(*chrom),(*gene_lim),atoms,residue,(*cleftgrid),save_num_chrom);
+
+		if(check_convergence(GB,(*chrom),s+1,mc_start)){ s++; break; }
+	}
+
+	for(r=0;r<nreplicas;r++){
+		printf("replica %d: T=%.3f CF=%.3f acceptance=%.1f%% step=%.1f bins", r, temperature[r],
+		       (*chrom)[r].app_evalue, (s > 0) ? 100.0*naccepted[r]/(double)s : 0.0, rho[r]);
+		if(r < nreplicas-1 && nswaptries[r] > 0) printf(" exchanges=%.1f%%", 100.0*nswaps[r]/(double)nswaptries[r]);
+		printf("\n");
+	}
+	printf("%ld evaluations of the scoring function\n", GB->num_evaluations);
+
+	sort_population((*chrom),nreplicas);
+
+	return close_optimizer(FA,GB,(*chrom),(*gene_lim),s,nreplicas,n_chrom_snapshot,chrom_snapshot);
+}
@@ -98,9 +98,12 @@ void read_input(FA_Global* FA,atom** atoms, resid** residue,rot** rotamer,gridpo
 		if(strcmp(field,"DEFTYP") == 0){strcpy(deftyp_forced,&buffer[7]);}
 		if(strcmp(field,"CLRMSD") == 0){sscanf(buffer,"%s %f",a,&FA->cluster_rmsd);}
 		if(strcmp(field,"ROTOUT") == 0){FA->rotout=1;}
+		if(strcmp(field,"RESUME") == 0){FA->resume=1;}
 		if(strcmp(field,"NMAMOD") == 0){sscanf(buffer,"%s %d",a,&FA->normal_modes);}
 		if(strcmp(field,"NMAAMP") == 0){strcpy(normal_file,&buffer[7]);}
 		if(strcmp(field,"NMAEIG") == 0){strcpy(eigen_file,&buffer[7]);}
+		if(strcmp(field,"NMACUT") == 0){sscanf(buffer,"%s %f",field,&FA->nma_cutoff);}
+		if(strcmp(field,"NMACHE") == 0){sscanf(buffer,"%s %d",field,&FA->nma_cache_size);}
 		if(strcmp(field,"RMSDST") == 0){strcpy(rmsd_file,&buffer[7]);}
 		if(strcmp(field,"EXCHET") == 0){FA->exclude_het=1;}
 		if(strcmp(field,"INCHOH") == 0){FA->remove_water=0;}
@@ -124,6 +127,7 @@ void read_input(FA_Global* FA,atom** atoms, resid** residue,rot** rotamer,gridpo
 		if(strcmp(field,"SPACER") == 0){sscanf(buffer,"%s %f",field,&FA->spacer_length);}
 		if(strcmp(field,"DEPSPA") == 0){strcpy(FA->dependencies_path,&buffer[7]);}
 		if(strcmp(field,"STATEP") == 0){strcpy(FA->state_path,&buffer[7]);}
+		if(strcmp(field,"CONTRL") == 0){sscanf(buffer,"%s %7s %d",field,FA->control,&FA->control_interval);}
 		if(strcmp(field,"TEMPOP") == 0){strcpy(FA->temp_path,&buffer[7]);}
 		if(strcmp(field,"NRGSUI") == 0){FA->nrg_suite=1;}
 		if(strcmp(field,"NRGOUT") == 0){sscanf(buffer,"%s %d",field,&FA->nrg_suite_timeout);}
@@ -140,14 +144,15 @@ void read_input(FA_Global* FA,atom** atoms, resid** residue,rot** rotamer,gridpo
 		}
 		if(strcmp(field,"CLUSTA") == 0)
 		{
-			if(FA->temperature > 0) sscanf(buffer, "%s %s", field, FA->clustering_algorithm);
-			else
+			sscanf(buffer, "%s %2s", field, FA->clustering_algorithm);
+			// online clustering (OL) falls back to CF ordering without temperature
+			if(FA->temperature == 0 && strcmp(FA->clustering_algorithm,"OL") != 0)
 			{
 				fprintf(stdout,"Overriding the clustering algorithm to CF as the Temperature given in input parameter does not allow the consideration of conformational entropy.\n");
 				strcpy(FA->clustering_algorithm, "CF");
 			}
 			
-			if(strncmp(FA->clustering_algorithm,"FO",2) != 0 && strncmp(FA->clustering_algorithm,"DP",2) != 0 && strncmp(FA->clustering_algorithm,"CF",2) != 0)
+			if(strncmp(FA->clustering_algorithm,"FO",2) != 0 && strncmp(FA->clustering_algorithm,"DP",2) != 0 && strncmp(FA->clustering_algorithm,"CF",2) != 0 && strncmp(FA->clustering_algorithm,"OL",2) != 0)
 			{
 				fprintf(stderr,"ERROR: Invalid clustering algorithm given in input parameter.\n");
 				Terminate(2);
@@ -295,7 +300,6 @@ void read_input(FA_Global* FA,atom** atoms, resid** residue,rot** rotamer,gridpo
 		printf("read files related to NMA\n");
 		read_normalgrid(FA,normal_file);
 		read_eigen(FA,eigen_file);
-		assign_eigen(FA,*atoms,*residue,FA->res_cnt,FA->normal_modes);
 	}
 
   
@@ -450,6 +454,11 @@ void read_input(FA_Global* FA,atom** atoms, resid** residue,rot** rotamer,gridpo
 	// fill in optres pointer in atoms struct.
 	update_optres(*atoms,*residue,FA->atm_cnt,FA->optres,FA->num_optres);
 	
+	// the binding site moved by the normal modes needs the grid, rotamers and optimized residues
+	if(FA->normal_modes > 0){
+		assign_eigen(FA,*atoms,*residue,*cleftgrid);
+	}
+	
 	if(FA->nrg_suite){
 		if(FA->translational){
 			for(i=1; i<FA->num_grd; i++){
@@ -30,7 +30,6 @@ void read_pdb(FA_Global* FA,atom** atoms,resid** residue, char* pdb_name){
   memset((*residue),0,FA->MIN_NUM_ATOM*sizeof(residue));
   memset(FA->num_atm,0,100000*sizeof(int));
   
-  (*atoms)[0].eigen = NULL;
   (*atoms)[0].cons = NULL;
   (*atoms)[0].optres = NULL;
   (*atoms)[0].par = NULL;
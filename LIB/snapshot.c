@@ -0,0 +1,327 @@
+#include "gaboom.h"
+#include "boinc.h"
+
+/*****************************************************************************
+ * Bounded chromosome snapshot : the poses saved by the GA are deduplicated on
+ * insert (hash of the integer genes) and stored in a contiguous gene arena
+ * that grows up to snap->capacity chromosomes (SNAPSIZE). When the arena is
+ * full, the poses are either spilled to disk as a run sorted by CF (SNAPSPIL)
+ * or compacted in memory, keeping the best half. Runs are merged at the end.
+ * The hashes are forgotten with the poses that leave memory once there are
+ * more than capacity of them : a pose found again is then saved again and
+ * removed with the duplicates of the final sort or merge.
+ *****************************************************************************/
+snapshot* build_snapshot(FA_Global* FA, GB_Global* GB)
+{
+	long max_snapshot = (long)GB->num_chrom * (long)GB->max_generations;
+
+	snapshot* snap = new snapshot;
+
+	snap->num_genes = GB->num_genes;
+	snap->capacity = (GB->snapshot_size > 0 && GB->snapshot_size < max_snapshot) ? GB->snapshot_size : (int)max_snapshot;
+	if(snap->capacity < 2*GB->num_chrom) snap->capacity = 2*GB->num_chrom;
+	snap->allocated = 0;
+	snap->n = 0;
+	snap->nSaved = 0;
+	snap->nDuplicates = 0;
+	snap->nDiscarded = 0;
+	snap->chrom = NULL;
+	snap->arena = NULL;
+	snap->spill = (GB->snapshot_spill != 0);
+	snap->spill_ptr = NULL;
+
+	strcpy(snap->spillfile,FA->temp_path);
+#ifdef _WIN32
+	strcat(snap->spillfile,"\\snapshot.spill");
+#else
+	strcat(snap->spillfile,"/snapshot.spill");
+#endif
+
+	grow_snapshot(snap, (GB->num_chrom > 0) ? 4*GB->num_chrom : 1);
+
+	return snap;
+}
+
+
+// (re)allocates the chromosome array and the gene arena for size chromosomes (genes pointers are preserved)
+void grow_snapshot(snapshot* snap, int size)
+{
+	int i;
+	chromosome* chrom;
+	gene* arena;
+
+	if(size > snap->capacity) size = snap->capacity;
+	if(size <= snap->allocated) return;
+
+	chrom = (chromosome*)malloc(size*sizeof(chromosome));
+	arena = alloc_gene_arena(size,snap->num_genes);
+	if(!chrom || !arena)
+	{
+		fprintf(stderr,"ERROR: memory allocation error for chrom_snapshot (%d chromosomes).\n", size);
+		Terminate(2);
+	}
+
+	if(snap->allocated > 0)
+	{
+		memcpy(arena, snap->arena, (size_t)snap->allocated*snap->num_genes*sizeof(gene));
+		memcpy(chrom, snap->chrom, snap->allocated*sizeof(chromosome));
+		// chromosomes may have been sorted (swapped genes pointers) : keep their offsets in the arena
+		for(i=0;i<snap->allocated;++i) chrom[i].genes = arena + (snap->chrom[i].genes - snap->arena);
+		free(snap->chrom);
+		free_gene_arena(snap->arena);
+	}
+
+	for(i=snap->allocated;i<size;++i)
+	{
+		chrom[i].genes = &arena[(size_t)i*snap->num_genes];
+		chrom[i].app_evalue = 0.0;
+		chrom[i].evalue = 0.0;
+		chrom[i].fitnes = 0.0;
+		chrom[i].status = ' ';
+	}
+
+	snap->chrom = chrom;
+	snap->arena = arena;
+	snap->allocated = size;
+}
+
+
+void free_snapshot(snapshot* snap)
+{
+	if(snap == NULL) return;
+
+	if(snap->spill_ptr != NULL)
+	{
+		CloseFile_B(&snap->spill_ptr,"wb");
+		remove(snap->spillfile);
+	}
+	if(snap->chrom != NULL) free(snap->chrom);
+	free_gene_arena(snap->arena);
+
+	delete snap;
+}
+
+
+// saves the unique chromosomes among the num_chrom given, returns the number saved
+int save_snapshot(snapshot* snap, const chromosome* chrom, int num_chrom)
+{
+	int nSaved = 0;
+
+	for(int i=0; i<num_chrom; i++)
+	{
+		if(!snap->signatures.insert(hash_genes(chrom[i].genes,snap->num_genes)).second)
+		{
+			snap->nDuplicates++;
+			continue;
+		}
+
+		if(snap->n == snap->allocated) grow_snapshot(snap, 2*snap->allocated);
+		if(snap->n == snap->capacity)
+		{
+			if(snap->spill) spill_snapshot(snap);
+			else compact_snapshot(snap);
+		}
+
+		copy_chrom(&snap->chrom[snap->n++],&chrom[i],snap->num_genes);
+		nSaved++;
+	}
+	snap->nSaved += nSaved;
+
+	return nSaved;
+}
+
+
+// sorts and removes the duplicates in memory, then keeps the best half when still too large
+void compact_snapshot(snapshot* snap)
+{
+	int keep = snap->capacity/2;
+
+	QuickSort(snap->chrom,0,snap->n-1,true);
+	snap->n = remove_dups(snap->chrom,snap->n,snap->num_genes);
+
+	if(snap->n > keep)
+	{
+		if(snap->nDiscarded == 0) printf("chrom_snapshot is full (%d chromosomes): discarding the worst poses\n", snap->capacity);
+		snap->nDiscarded += snap->n - keep;
+		snap->n = keep;
+	}
+
+	trim_signatures(snap);
+}
+
+
+// writes the chromosomes in memory as a run sorted by CF at the end of the spill file
+void spill_snapshot(snapshot* snap)
+{
+	if(snap->spill_ptr == NULL)
+	{
+		if(!OpenFile_B(snap->spillfile,"wb",&snap->spill_ptr))
+		{
+			fprintf(stderr,"ERROR: Cannot open spill file '%s'.\n", snap->spillfile);
+			Terminate(6);
+		}
+	}
+
+	QuickSort(snap->chrom,0,snap->n-1,true);
+	snap->n = remove_dups(snap->chrom,snap->n,snap->num_genes);
+
+	snap->runs.push_back(make_pair(ftell(snap->spill_ptr),(long)snap->n));
+	for(int i=0; i<snap->n; i++) write_snapshot_record(snap,&snap->chrom[i]);
+	fflush(snap->spill_ptr);
+
+	snap->n = 0;
+
+	trim_signatures(snap);
+}
+
+
+// keeps only the hashes of the chromosomes in memory when there are more than capacity
+void trim_signatures(snapshot* snap)
+{
+	if((long)snap->signatures.size() <= (long)snap->capacity) return;
+
+	snap->signatures.clear();
+	for(int i=0; i<snap->n; i++) snap->signatures.insert(hash_genes(snap->chrom[i].genes,snap->num_genes));
+}
+
+
+void write_snapshot_record(snapshot* snap, const chromosome* chrom)
+{
+	size_t nwritten = 0;
+
+	nwritten += fwrite(&chrom->cf,sizeof(cfstr),1,snap->spill_ptr);
+	nwritten += fwrite(&chrom->evalue,sizeof(double),1,snap->spill_ptr);
+	nwritten += fwrite(&chrom->app_evalue,sizeof(double),1,snap->spill_ptr);
+	nwritten += fwrite(&chrom->fitnes,sizeof(double),1,snap->spill_ptr);
+	nwritten += fwrite(&chrom->status,sizeof(char),1,snap->spill_ptr);
+	nwritten += fwrite(chrom->genes,sizeof(gene),snap->num_genes,snap->spill_ptr);
+
+	if(nwritten != (size_t)(5+snap->num_genes))
+	{
+		fprintf(stderr,"ERROR: Cannot write to spill file '%s'.\n", snap->spillfile);
+		Terminate(6);
+	}
+}
+
+
+void read_snapshot_record(snapshot* snap, FILE* infile_ptr, chromosome* chrom)
+{
+	size_t nread = 0;
+
+	nread += fread(&chrom->cf,sizeof(cfstr),1,infile_ptr);
+	nread += fread(&chrom->evalue,sizeof(double),1,infile_ptr);
+	nread += fread(&chrom->app_evalue,sizeof(double),1,infile_ptr);
+	nread += fread(&chrom->fitnes,sizeof(double),1,infile_ptr);
+	nread += fread(&chrom->status,sizeof(char),1,infile_ptr);
+	nread += fread(chrom->genes,sizeof(gene),snap->num_genes,infile_ptr);
+
+	if(nread != (size_t)(5+snap->num_genes))
+	{
+		fprintf(stderr,"ERROR: Cannot read from spill file '%s'.\n", snap->spillfile);
+		Terminate(6);
+	}
+}
+
+
+/*****************************************************************************
+ * Sorts the snapshot by CF and removes duplicates. When runs were spilled,
+ * the last run is written and all runs are merged (k-way, lowest CF first)
+ * back into memory, up to snap->capacity chromosomes.
+ * Returns the number of chromosomes in snap->chrom.
+ *****************************************************************************/
+int close_snapshot(snapshot* snap)
+{
+	int i,k,best;
+	int nRuns;
+	int n = 0;
+	bool duplicate;
+	chromosome* heads;
+	gene* head_genes;
+	long* left;
+	FILE** run_ptr;
+
+	if(snap->runs.empty())
+	{
+		printf("sorting chrom_snapshot\n");
+		QuickSort(snap->chrom,0,snap->n-1,true);
+
+		printf("removing duplicates\n");
+		snap->n = remove_dups(snap->chrom,snap->n,snap->num_genes);
+	}
+	else
+	{
+		if(snap->n > 0) spill_snapshot(snap);
+		CloseFile_B(&snap->spill_ptr,"wb");
+		snap->spill_ptr = NULL;
+		grow_snapshot(snap, snap->capacity);
+
+		nRuns = (int)snap->runs.size();
+		printf("merging %d sorted runs of chrom_snapshot\n", nRuns);
+
+		heads = (chromosome*)malloc(nRuns*sizeof(chromosome));
+		head_genes = (gene*)malloc((size_t)nRuns*snap->num_genes*sizeof(gene));
+		left = (long*)malloc(nRuns*sizeof(long));
+		run_ptr = (FILE**)malloc(nRuns*sizeof(FILE*));
+		if(!heads || !head_genes || !left || !run_ptr)
+		{
+			fprintf(stderr,"ERROR: memory allocation error for chrom_snapshot runs.\n");
+			Terminate(2);
+		}
+
+		// one reader per run, positioned on its first record
+		for(k=0;k<nRuns;++k)
+		{
+			run_ptr[k] = NULL;
+			if(!OpenFile_B(snap->spillfile,"rb",&run_ptr[k]))
+			{
+				fprintf(stderr,"ERROR: Cannot open spill file '%s'.\n", snap->spillfile);
+				Terminate(6);
+			}
+			fseek(run_ptr[k],snap->runs[k].first,SEEK_SET);
+			heads[k].genes = &head_genes[(size_t)k*snap->num_genes];
+			left[k] = snap->runs[k].second;
+			if(left[k] > 0) read_snapshot_record(snap,run_ptr[k],&heads[k]);
+		}
+
+		while(1)
+		{
+			best = -1;
+			for(k=0;k<nRuns;++k)
+			{
+				if(left[k] > 0 && (best == -1 || heads[k].evalue < heads[best].evalue)) best = k;
+			}
+			if(best == -1) break;
+
+			// consecutive duplicates (same criterion as remove_dups)
+			duplicate = false;
+			if(n > 0)
+			{
+				for(i=0;i<snap->num_genes;i++) if(fabs(heads[best].genes[i].to_ic - snap->chrom[n-1].genes[i].to_ic) >= 0.1) break;
+				duplicate = (i == snap->num_genes);
+			}
+
+			if(!duplicate)
+			{
+				if(n < snap->capacity) copy_chrom(&snap->chrom[n++],&heads[best],snap->num_genes);
+				else snap->nDiscarded++;
+			}
+
+			if(--left[best] > 0) read_snapshot_record(snap,run_ptr[best],&heads[best]);
+		}
+		snap->n = n;
+
+		for(k=0;k<nRuns;++k) CloseFile_B(&run_ptr[k],"rb");
+		free(heads);
+		free(head_genes);
+		free(left);
+		free(run_ptr);
+
+		remove(snap->spillfile);
+		snap->runs.clear();
+	}
+
+	printf("chrom_snapshot: %ld unique poses saved (%ld duplicates skipped, %ld discarded)\n",
+	       snap->nSaved, snap->nDuplicates, snap->nDiscarded);
+
+	return snap->n;
+}
@@ -0,0 +1,173 @@
+#include "gaboom.h"
+#include "boinc.h"
+
+// most recent chromosomes of chrom_snapshot used as the training set
+# define SURR_MAX_TRAINING 4096
+// fraction of the skipped offspring scored anyway to count the false skips
+# define SURR_AUDIT 0.05
+// displacement of the grid point (in A) weighing as much as the full range of a gene
+# define SURR_GRID_LENGTH 10.0
+
+/*****************************************************************************
+ * Nearest-neighbour surrogate of the CF (SURROGAT) : before an offspring of
+ * reproduce is scored, its CF is predicted from the k closest chromosomes of
+ * chrom_snapshot (inverse-distance weighted mean of their CF). The offspring
+ * is not scored, and does not enter the population, when the prediction minus
+ * the spread of the neighbours is still worse than the worst parent by more
+ * than the margin. The distance between two chromosomes is the euclidean
+ * distance of their genes normalized by the opt_par range (periodic for full
+ * turns), the grid point counting by its coordinates and the other mapped
+ * genes (rotamers) as equal or different. A few skips are scored anyway to
+ * report the false skips with the error of the predictions.
+ *****************************************************************************/
+
+surrogate* build_surrogate(GB_Global* GB)
+{
+	surrogate* sur = new surrogate;
+
+	sur->k = GB->surrogate_k;
+	sur->margin = GB->surrogate_margin;
+	sur->pred = 0.0;
+	sur->threshold = 0.0;
+	sur->pending = 0;
+	sur->npredicted = 0;
+	sur->nskipped = 0;
+	sur->naudited = 0;
+	sur->nfalse = 0;
+	sur->nscored = 0;
+	sur->sum_err = 0.0;
+	sur->sum_abs_err = 0.0;
+	sur->sum_sq_err = 0.0;
+
+	return sur;
+}
+
+void free_surrogate(surrogate* sur)
+{
+	delete sur;
+}
+
+// normalized squared distance between two chromosomes
+static double surrogate_dist2(FA_Global* FA, GB_Global* GB, const genlim* gene_lim, const gridpoint* cleftgrid,
+			      const gene* g1, const gene* g2)
+{
+	double d,d2=0.0;
+
+	for(int j=0;j<GB->num_genes;j++){
+		if(gene_lim[j].map){
+			if(FA->map_par[j].typ == -1 && cleftgrid != NULL){
+				const float* c1 = cleftgrid[(int)g1[j].to_ic].coor;
+				const float* c2 = cleftgrid[(int)g2[j].to_ic].coor;
+				for(int l=0;l<3;l++){
+					d = (c1[l]-c2[l])/SURR_GRID_LENGTH;
+					d2 += d*d;
+				}
+			}else if(g1[j].to_ic != g2[j].to_ic){
+				d2 += 1.0;
+			}
+			continue;
+		}
+
+		double range = gene_lim[j].max - gene_lim[j].min;
+		if(range <= 0.0) continue;
+
+		d = fabs(g1[j].to_ic - g2[j].to_ic)/range;
+		if(range >= 360.0-gene_lim[j].del && d > 0.5) d = 1.0-d;
+		d2 += d*d;
+	}
+
+	return d2;
+}
+
+/* predicts the CF of genes. returns 1 when the offspring should not be scored,
+   0 otherwise (the CF is then expected by surrogate_observe) */
+int surrogate_screen(FA_Global* FA, GB_Global* GB, const genlim* gene_lim, const gridpoint* cleftgrid,
+		     const gene* genes, double threshold, boost::variate_generator< RNGType, boost::uniform_int<> > & dice)
+{
+	surrogate* sur = GB->surrogate;
+	snapshot* snap = GB->snapshot;
+	int i,l,k;
+	int first,nk=0;
+	double d2,w,wsum=0.0,pred=0.0,var=0.0;
+
+	sur->pending = 0;
+	if(snap == NULL || snap->n < 2*sur->k) return 0;
+
+	k = sur->k;
+	std::vector< pair<double,int> > nearest(k);
+
+	// k nearest by insertion (the list is short)
+	first = (snap->n > SURR_MAX_TRAINING) ? snap->n - SURR_MAX_TRAINING : 0;
+	for(i=first;i<snap->n;i++){
+		d2 = surrogate_dist2(FA,GB,gene_lim,cleftgrid,genes,snap->chrom[i].genes);
+		if(nk == k && d2 >= nearest[k-1].first) continue;
+
+		l = (nk < k) ? nk++ : k-1;
+		for(;l>0 && nearest[l-1].first > d2;l--) nearest[l] = nearest[l-1];
+		nearest[l] = make_pair(d2,i);
+	}
+
+	for(l=0;l<nk;l++){
+		w = 1.0/(sqrt(nearest[l].first)+1.0e-6);
+		pred += w*snap->chrom[nearest[l].second].evalue;
+		wsum += w;
+	}
+	pred /= wsum;
+	for(l=0;l<nk;l++){
+		w = 1.0/(sqrt(nearest[l].first)+1.0e-6);
+		d2 = snap->chrom[nearest[l].second].evalue - pred;
+		var += w*d2*d2;
+	}
+	var /= wsum;
+
+	sur->npredicted++;
+	sur->pred = pred;
+	sur->threshold = threshold;
+	sur->pending = 1;
+
+	if(pred - sqrt(var) > threshold + sur->margin){
+		if(RandomDouble(dice()) >= SURR_AUDIT){
+			sur->pending = 0;
+			sur->nskipped++;
+			return 1;
+		}
+		sur->pending = 2;
+	}
+
+	return 0;
+}
+
+// compares the last prediction to the CF of the offspring
+void surrogate_observe(surrogate* sur, double evalue)
+{
+	if(sur == NULL || sur->pending == 0) return;
+
+	double err = sur->pred - evalue;
+	sur->nscored++;
+	sur->sum_err += err;
+	sur->sum_abs_err += fabs(err);
+	sur->sum_sq_err += err*err;
+
+	if(sur->pending == 2){
+		sur->naudited++;
+		if(evalue < sur->threshold) sur->nfalse++;
+	}
+	sur->pending = 0;
+}
+
+void print_surrogate(const surrogate* sur, long num_evaluations)
+{
+	if(sur == NULL) return;
+
+	printf("surrogate (k=%d, margin=%.2f): %ld predictions, %ld offspring not scored (%.1f%% of the scoring calls)\n",
+	       sur->k, sur->margin, sur->npredicted, sur->nskipped,
+	       (num_evaluations+sur->nskipped > 0) ? 100.0*sur->nskipped/(double)(num_evaluations+sur->nskipped) : 0.0);
+	if(sur->nscored > 0){
+		printf("surrogate error on %ld scored offspring: mean=%.3f mean absolute=%.3f rms=%.3f\n",
+		       sur->nscored, sur->sum_err/sur->nscored, sur->sum_abs_err/sur->nscored, sqrt(sur->sum_sq_err/sur->nscored));
+	}
+	if(sur->naudited > 0){
+		printf("surrogate false skips: %ld of %ld audited skips would have entered the population\n",
+		       sur->nfalse, sur->naudited);
+	}
+}
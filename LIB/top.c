@@ -86,11 +86,26 @@ int main(int argc, char **argv){
 
 	FA->vindex = 0;
 	FA->rotout = 0;
+	FA->resume = 0;
 	FA->num_optres = 0;
 	FA->nflexbonds = 0;
 	FA->normal_grid = NULL;
 	FA->supernode = 0;
 	FA->eigenvector = NULL;
+	FA->nma_atoms = NULL;
+	FA->nma_eigen = NULL;
+	FA->nma_coor_ori = NULL;
+	FA->nma_coor = NULL;
+	FA->nma_natoms = 0;
+	FA->nma_nsite = 0;
+	FA->nma_noptres = 0;
+	FA->nma_cutoff = -1.0f;
+	FA->nma_insite = NULL;
+	FA->nma_applied = -1;
+	FA->nma_applied_whole = 0;
+	FA->nma_moved = 0;
+	FA->nma_cache_size = 64;
+	FA->nma_cache = NULL;
 	FA->psFlexDEENode = NULL;
 	FA->FlexDEE_Nodes = 0;
 	FA->dee_clash = 0.5;
@@ -110,8 +125,11 @@ int main(int argc, char **argv){
 
 	FA->nrg_suite=0;
 	FA->nrg_suite_timeout=60;
+	strcpy(FA->control,"POLL");
+	FA->control_interval=0;
 	FA->translational=0;
 	FA->refstructure=0;
+	FA->hungarian_rmsd=NULL;
 	FA->omit_buried=0;
 	FA->is_protein=1;
 	//FA->is_nucleicacid=0;
@@ -128,6 +146,11 @@ int main(int argc, char **argv){
 	FA->acsweight = 1.0;
 	
 	GB->outgen=0;
+	GB->gene_arena=NULL;
+	GB->gene_decoding=NULL;
+	GB->online_cluster=NULL;
+	GB->snapshot=NULL;
+	GB->surrogate=NULL;
 	FA->num_grd=0;
 	FA->exclude_het=0;
 	FA->remove_water=1;
@@ -421,12 +444,19 @@ int main(int argc, char **argv){
 	   }
 	*/
   
-	if(strcmp(FA->metopt,"GA") == 0)
+	if(strcmp(FA->metopt,"GA") == 0 || strcmp(FA->metopt,"MC") == 0 || strcmp(FA->metopt,"DE") == 0 ||
+	   strcmp(FA->metopt,"CM") == 0)
 	{
 		////////////////////////////////
 		////// Genetic Algorithm ///////
+		////// Monte Carlo,      ///////
+		//// Differential Evolution ////
+		////////// or CMA-ES ///////////
 		////////////////////////////////
 
+		// .pause, .abort and .stop (or signals) and updates of the NRGsuite
+		init_control(FA);
+
 		// calculate time 
 		sta_timer=time(NULL);
 		sta=localtime(&sta_timer);
@@ -434,7 +464,18 @@ int main(int argc, char **argv){
 		sta_val[1]=sta->tm_min;
 		sta_val[2]=sta->tm_hour;
 
-		int n_chrom_snapshot=GA(FA,GB,VC,&chrom,&chrom_snapshot,&gene_lim,atoms,residue,&cleftgrid,gainp,&memchrom,ic2cf);
+		int n_chrom_snapshot;
+		if(strcmp(FA->metopt,"MC") == 0)
+			n_chrom_snapshot=MC(FA,GB,VC,&chrom,&chrom_snapshot,&gene_lim,atoms,residue,&cleftgrid,gainp,&memchrom,ic2cf);
+		else if(strcmp(FA->metopt,"DE") == 0)
+			n_chrom_snapshot=DE(FA,GB,VC,&chrom,&chrom_snapshot,&gene_lim,atoms,residue,&cleftgrid,gainp,&memchrom,ic2cf);
+		else if(strcmp(FA->metopt,"CM") == 0)
+			n_chrom_snapshot=CMAES(FA,GB,VC,&chrom,&chrom_snapshot,&gene_lim,atoms,residue,&cleftgrid,gainp,&memchrom,ic2cf);
+		else
+			n_chrom_snapshot=GA(FA,GB,VC,&chrom,&chrom_snapshot,&gene_lim,atoms,residue,&cleftgrid,gainp,&memchrom,ic2cf);
+
+		if(n_chrom_snapshot > 0) flush_update_file(FA);
+		if(FA->normal_modes > 0) print_nma_cache(FA);
     
 		if(n_chrom_snapshot > 0){
 
@@ -480,6 +521,11 @@ int main(int argc, char **argv){
 				printf("using the Fast OPTICS (FO) density based clustering algorithm.\n");
 				FastOPTICS_cluster(FA,GB,VC,chrom_snapshot,gene_lim,atoms,residue,cleftgrid,n_chrom_snapshot,end_strfile,tmp_end_strfile,dockinp,gainp);
 			}
+			else if( strcmp(FA->clustering_algorithm,"OL") == 0 )
+			{
+				printf("using the Online leader (OL) clustering algorithm.\n");
+				Online_cluster(FA,GB,VC,GB->online_cluster,gene_lim,atoms,residue,cleftgrid,end_strfile,tmp_end_strfile,dockinp,gainp);
+			}
 			else if( strcmp(FA->clustering_algorithm,"DP") == 0 )
 			{
 				printf("using the Density Peak (DP) based clustering algorithm.\n");
@@ -531,19 +577,15 @@ int main(int argc, char **argv){
 	if(gene_lim != NULL) free(gene_lim);
 	
 	// Chromosomes
-	if(chrom != NULL){
-		for(i=0;i<memchrom;++i){
-			if(chrom[i].genes != NULL) free(chrom[i].genes);
-		}
-		free(chrom);
-	}
+	if(chrom != NULL) free(chrom);
+	free_gene_arena(GB->gene_arena);
+	free_gene_decoding(GB);
 	
-	if(chrom_snapshot != NULL){
-		for(i=0;i<(GB->num_chrom*GB->max_generations);++i){
-			if(chrom_snapshot[i].genes != NULL) free(chrom_snapshot[i].genes);
-		}
-		free(chrom_snapshot);
-	}
+	// chrom_snapshot (points in GB->snapshot)
+	if(GB->snapshot != NULL) free_snapshot(GB->snapshot);
+	if(GB->surrogate != NULL) free_surrogate(GB->surrogate);
+	
+	if(GB->online_cluster != NULL) free_Online_clustering(GB->online_cluster);
 	
 	// Vcontacts
 	if(VC->Calc != NULL) {
@@ -564,13 +606,6 @@ int main(int argc, char **argv){
 
 			if(atoms[i].cons != NULL) { free(atoms[i].cons); }
 			if(atoms[i].coor_ref != NULL) { free(atoms[i].coor_ref); }
-
-			if(atoms[i].eigen != NULL){
-				for(j=0;j<FA->normal_modes;j++)
-					if(atoms[i].eigen[j] != NULL)
-						free(atoms[i].eigen[j]);
-				free(atoms[i].eigen);
-			}
 		}
 
 		free(atoms);
@@ -626,6 +661,7 @@ int main(int argc, char **argv){
 	}
 
 	// eigen vectors
+	free_eigen(FA);
 	if(FA->eigenvector != NULL){
 		for(i=0;i<3*FA->MIN_NUM_ATOM;i++)
 			if(FA->eigenvector[i] != NULL) 
@@ -650,6 +686,9 @@ int main(int argc, char **argv){
 	if(FA->min_opt_par != NULL) free(FA->min_opt_par);
 	if(FA->max_opt_par != NULL) free(FA->max_opt_par);
 
+	// Symmetry-corrected RMSD workspace
+	if(FA->hungarian_rmsd != NULL) free_Hungarian(FA->hungarian_rmsd);
+
 	/*
 	// RMSD
 	for(i=0;i<FA->num_het;i++){
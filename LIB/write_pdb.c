@@ -12,6 +12,9 @@ int write_MODEL_pdb(bool isFirst, bool isLast, int nModel, FA_Global* FA,atom *a
 	char field[7];
 	int rot;
 
+	// the scoring deformed only the binding site by the normal modes
+	complete_mode(FA,atoms);
+
 	FILE *outfile_ptr = NULL;
 	int outfile_code = 0;
 	if(isFirst) outfile_code = OpenFile_B(outfile,"w",&outfile_ptr);
@@ -96,6 +99,9 @@ int write_pdb(FA_Global* FA,atom *atoms, resid* residue,char outfile[], char rem
 	char field[7];
 	int rot;
 	
+	// the scoring deformed only the binding site by the normal modes
+	complete_mode(FA,atoms);
+
 	//printf("will write pdb!\n");
 	FILE *outfile_ptr = NULL;
 	if(!OpenFile_B(outfile,"w",&outfile_ptr)){
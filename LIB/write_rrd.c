@@ -46,10 +46,14 @@ int write_rrd(FA_Global* FA,GB_Global* GB,const chromosome* chrom, const genlim*
 	return(0);
 }
 
-int write_DensityPeak_rrd(FA_Global* FA, GB_Global* GB, const chromosome* chrom, const genlim* gene_lim, atom* atoms, resid* residue, gridpoint* cleftgrid, ClusterChrom* Chrom, DPcluster* Clust, float* RMSD, char outfile[])
+int write_DensityPeak_rrd(FA_Global* FA, GB_Global* GB, const chromosome* chrom, const genlim* gene_lim, atom* atoms, resid* residue, gridpoint* cleftgrid, ClusterChrom* Chrom, DPcluster* Clust, int num_chrom, int nAtoms, char outfile[])
 {
 	FILE *outfile_ptr;
 	int i,j,k,l;
+	int nClusters = 0;
+	int* slot;
+	ClusterChrom** Center;
+	ClusterChrom* pChrom;
 	char sufix[10];
 	char tmp_end_strfile[MAX_PATH__];
 	float rmsd = 0.0f;
@@ -61,6 +65,22 @@ int write_DensityPeak_rrd(FA_Global* FA, GB_Global* GB, const chromosome* chrom,
 	strcpy(tmp_end_strfile, outfile);
 	strcat(tmp_end_strfile, sufix);
 
+	// slot[index] is the position in Chrom of the original chromosome index and Center[Cluster] the center of each cluster
+	for(k=0; k<num_chrom; ++k) if(Chrom[k].Cluster > nClusters) nClusters = Chrom[k].Cluster;
+	slot = (int*) malloc(num_chrom * sizeof(int));
+	Center = (ClusterChrom**) malloc((nClusters+1) * sizeof(ClusterChrom*));
+	if(slot == NULL || Center == NULL)
+	{
+		fprintf(stderr,"ERROR: memory allocation error for ClusterChrom positions in write_DensityPeak_rrd.\n");
+		Terminate(2);
+	}
+	for(k=0; k<=nClusters; ++k) Center[k] = NULL;
+	for(k=0; k<num_chrom; ++k)
+	{
+		slot[Chrom[k].index] = k;
+		if(Chrom[k].isCenter && Chrom[k].Cluster > 0) Center[Chrom[k].Cluster] = &Chrom[k];
+	}
+
 	outfile_ptr = NULL;
 	if(!OpenFile_B(tmp_end_strfile,"w",&outfile_ptr)) 
 	{
@@ -68,7 +88,7 @@ int write_DensityPeak_rrd(FA_Global* FA, GB_Global* GB, const chromosome* chrom,
 	}
 	else
 	{
-		for(j=0; j<GB->num_chrom;++j)
+		for(j=0; j<GB->num_chrom && j<num_chrom;++j)
 		{ 
 			for(i=0;i<GB->num_genes;++i)
 			{
@@ -81,19 +101,18 @@ int write_DensityPeak_rrd(FA_Global* FA, GB_Global* GB, const chromosome* chrom,
 			// Calculating symmetry-corrected RMSD (with the help of the Hungarian) saved into 'rmsd_corrected'
 			Hungarian = true;
 			rmsd_corrected = calc_rmsd(FA,atoms,residue,cleftgrid,FA->npar,FA->opt_par, Hungarian);
-			for(k=j+1;k<GB->num_chrom;++k)
-			{
-				if(Chrom[k].Cluster == Chrom[j].Cluster && Chrom[k].isCenter == true)
-				{
-					ClusRMSD = RMSD[K(Chrom[k].index, Chrom[j].index, GB->num_chrom)];
-				}
-			}
-			fprintf(outfile_ptr, "%3d %3d %8.5f %8.5f %8.5f %8.5f [", j, Chrom[j].Cluster, ClusRMSD, rmsd, rmsd_corrected, chrom[j].evalue);
+			// RMSD to the center of its cluster
+			pChrom = &Chrom[slot[j]];
+			ClusRMSD = 0.0f;
+			if(pChrom->Cluster > 0 && Center[pChrom->Cluster] != NULL) ClusRMSD = DensityPeak_rmsd(Center[pChrom->Cluster], pChrom, nAtoms);
+			fprintf(outfile_ptr, "%3d %3d %8.5f %8.5f %8.5f %8.5f [", j, pChrom->Cluster, ClusRMSD, rmsd, rmsd_corrected, chrom[j].evalue);
 			for(l=0; l<FA->npar; ++l) fprintf(outfile_ptr,"%8.5f ",FA->opt_par[l]);
 			fprintf(outfile_ptr, "]\n" );
 		}
 	}
 
 	CloseFile_B(&outfile_ptr,"w");
+	free(slot);
+	free(Center);
 	return(0);
 }
\ No newline at end of file